@@ -33,6 +33,7 @@
 #include "WalletAddress.h"
 #include "supernode/requestdefines.h"
 #include "rta/supernode.h"
+#include "supernode/services.h"
 #include "lib/graft/graft_exception.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_protocol/blobdatatype.h"
@@ -74,7 +75,7 @@ graft::Status WalletAddress::getWalletAddressHandler(const graft::Router::vars_t
         return graft::Status::Error;
     }
 
-    graft::SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, graft::SupernodePtr());
+    const graft::SupernodePtr& supernode = ctx.services().get<graft::services::Supernode>();
     if (!supernode) {
         graft::supernode::request::GetWalletAddressErrorResponse err;
         err.error = string("supernode was not setup correctly");
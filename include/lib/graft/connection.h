@@ -4,6 +4,8 @@
 #include "lib/graft/task.h"
 #include "lib/graft/blacklist.h"
 
+struct http_message;
+
 namespace graft {
 
 namespace details
@@ -80,6 +82,8 @@ public:
 
     void ev_handler(mg_connection* upstream, int ev, void *ev_data);
 private:
+    void cancelTimer(mg_connection* upstream);
+    void onTimeout();
     void setError(Status status, const std::string& error = std::string())
     {
         m_status = status;
@@ -92,6 +96,7 @@ private:
     uint64_t m_connectioId = 0;
     double m_timeout;
     mg_connection* m_upstream = nullptr;
+    TimingWheel::Handle m_timer;
     Status m_status = Status::None;
     std::string m_error;
 };
@@ -101,7 +106,8 @@ class ConnectionBase;
 class Looper final : public TaskManager
 {
 public:
-    Looper(const ConfigOpts& copts, ConnectionBase& connectionBase);
+    //a secondary looper shares the global context and the thread pool of the primary one
+    Looper(const ConfigOpts& copts, ConnectionBase& connectionBase, Looper* primary = nullptr);
     virtual ~Looper();
 
     void serve();
@@ -112,12 +118,19 @@ public:
     bool stopped() const { return m_stop; }
 
     virtual mg_mgr* getMgMgr() override { return m_mgr.get(); }
+    ConnectionBase& getConnectionBase() { return m_connectionBase; }
+
+    static Looper* from(mg_mgr* mgr);
 protected:
+
     std::unique_ptr<mg_mgr> m_mgr;
 private:
     ////static functions
     static void cb_event(mg_mgr* mgr, uint64_t cnt);
 
+    ConnectionBase& m_connectionBase;
+    bool m_epoll = false;
+
     std::atomic_bool m_ready {false};
     std::atomic_bool m_stop {false};
     std::atomic_bool m_forceStop {false};
@@ -129,7 +142,9 @@ public:
     using Proto = std::string;
 
     virtual void bind(Looper& looper) = 0;
-    virtual void respond(ClientTask* ct, const std::string& s);
+    //true if the manager can listen on the same address in each IO thread
+    virtual bool shardable() const { return false; }
+    virtual void respond(ClientTask* ct, std::string&& s);
 
     ConnectionManager(const Proto& proto) : m_proto(proto) { }
     ConnectionManager(const ConnectionManager&) = delete;
@@ -150,6 +165,8 @@ public:
 protected:
     static ConnectionManager* from_accepted(mg_connection* cn);
     static void ev_handler_empty(mg_connection *client, int ev, void *ev_data);
+    //returns response code according to the last status of the task and counts it
+    static int responseCode(ClientTask* ct);
 #define _M(x) std::make_pair(#x, METHOD_##x)
     constexpr static std::pair<const char *, int> m_methods[] = {
         _M(GET), _M(POST), _M(PUT), _M(DELETE), _M(HEAD) //, _M(CONNECT)
@@ -174,13 +191,23 @@ public:
     void createLooper(ConfigOpts& configOpts);
     void initConnectionManagers();
     void bindConnectionManagers();
+    //runs secondary loopers in their own threads and the primary looper in the current thread
+    void serve();
 
-    bool ready() const { return m_looperReady && m_looper->ready(); }
-    void stop(bool force = false) { assert(m_looper); m_looper->stop(force); }
+    bool ready() const;
+    void stop(bool force = false);
 
     BlackList& getBlackList() { return *m_blackList; }
     SysInfoCounter& getSysInfoCounter() { assert(m_sysInfo); return *m_sysInfo; }
     Looper& getLooper() { assert(m_looper); return *m_looper; }
+    size_t getLoopersCount() const { return 1 + m_loopers.size(); }
+    template<typename F>
+    void forEachLooper(F f)
+    {
+        assert(m_looper);
+        f(*m_looper);
+        for(auto& looper : m_loopers) f(*looper);
+    }
     ConfigOpts& getCopts() { assert(m_looper); return m_looper->getCopts(); }
     ConnectionManager* getConMgr(const ConnectionManager::Proto& proto);
 
@@ -193,6 +220,8 @@ private:
     std::unique_ptr<SysInfoCounter> m_sysInfo;
     std::atomic_bool m_looperReady{false};
     std::unique_ptr<Looper> m_looper;
+    //secondary loopers, io_threads - 1 of them
+    std::vector<std::unique_ptr<Looper>> m_loopers;
     std::map<ConnectionManager::Proto, std::unique_ptr<ConnectionManager>> m_conManagers;
 };
 
@@ -217,11 +246,43 @@ public:
     HttpConnectionManager() : ConnectionManager("HTTP") { }
 
     void bind(Looper& looper) override;
+    bool shardable() const override { return true; }
+    void respond(ClientTask* ct, std::string&& s) override;
 
 private:
+    struct Request
+    {
+        bool routed;
+        bool keepAlive;
+        Router::JobParams params;
+        //the response to a request that is not routed
+        int errorCode = 500;
+        const char* errorMessage = "invalid parameter";
+    };
+
+    //It is user_data of accepted client connection. Requests of the connection are processed one by one,
+    //requests that come before the response to the previous one are queued to be answered in order.
+    struct ClientState
+    {
+        ClientState(HttpConnectionManager* cm) : manager(cm) { }
+
+        HttpConnectionManager* manager;
+        ClientTask* task = nullptr;
+        int requests = 0;
+        bool closing = false;
+        bool processing = false;
+        TimingWheel::Handle timer; //closes the connection if the next request does not come in time
+        std::deque<Request> pipeline;
+    };
+
     static void ev_handler_http(mg_connection *client, int ev, void *ev_data);
+    static void onRequest(mg_connection *client, http_message *hm);
+    static void processPipeline(mg_connection *client);
+    static void setIdleTimer(mg_connection *client);
+    static void send(mg_connection *client, int code, std::string&& s, const char* contentType, bool keepAlive);
     static int translateMethod(const char *method, std::size_t len);
     static HttpConnectionManager* from_accepted(mg_connection* cn);
+    static ClientState* state(mg_connection* client);
 };
 
 class CoapConnectionManager final : public ConnectionManager
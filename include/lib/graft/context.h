@@ -11,12 +11,20 @@
 #include <thread>
 #include <mutex>
 #include <map>
+#include <memory_resource>
+#include <new>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <typeinfo>
 #include <vector>
 #include <chrono>
 #include <any>
 
 #include "lib/graft/graft_utility.hpp"
 #include "lib/graft/graft_constants.h"
+#include "lib/graft/service_registry.h"
 
 namespace graft { class ConfigOpts; }
 namespace graft::request::system_info { class Counter; }
@@ -24,24 +32,28 @@ namespace graft::request::system_info { class Counter; }
 namespace graft
 {
 class HandlerAPI;
+class FanOut;
 
 class GlobalContextMap : public TSHashtable<std::string, std::any>
 {
 public:
     GlobalContextMap(HandlerAPI* handlerAPI = nullptr) : m_handlerAPI(handlerAPI) { }
+
+    ServiceRegistry& services() { return m_services; }
 protected:
     HandlerAPI* m_handlerAPI;
+    ServiceRegistry m_services;
 };
 
 class GlobalContextMapFriend : protected GlobalContextMap
 {
 public:
     GlobalContextMapFriend() = delete;
-    static void cleanup(GlobalContextMap& gcm)
+    static size_t cleanup(GlobalContextMap& gcm)
     {
         GlobalContextMapFriend& gcmf = static_cast<GlobalContextMapFriend&>(gcm);
         TSHashtable<std::string, std::any>& ht = gcmf;
-        ht.cleanup();
+        return ht.cleanup();
     }
     static HandlerAPI* handlerAPI(GlobalContextMap& gcm)
     {
@@ -57,78 +69,276 @@ class Context
 public:
     class Local
     {
+    public:
+        static constexpr size_t ArenaSize = 1024;
+
+        //key with the precomputed hash, string literals and constexpr keys are hashed at compile time
+        struct Key
+        {
+            constexpr Key(const char* str) : Key(std::string_view(str)) { }
+            Key(const std::string& str) : Key(std::string_view(str)) { }
+            constexpr Key(std::string_view str) : name(str), hash(hashOf(str)) { }
+
+            static constexpr uint32_t hashOf(std::string_view str)
+            {//FNV-1a
+                uint32_t h = 2166136261u;
+                for(char c : str)
+                {
+                    h ^= static_cast<unsigned char>(c);
+                    h *= 16777619u;
+                }
+                return h;
+            }
+
+            std::string_view name;
+            uint32_t hash;
+        };
+
     private:
-        using ContextMap = std::map<std::string, std::any>;
-        ContextMap m_map;
+        struct TypeOps
+        {
+            const std::type_info& type;
+            void (*destroy)(void*);
+            size_t size;
+            size_t align;
+        };
+
+        template<typename T>
+        static const TypeOps* opsOf()
+        {
+            static const TypeOps ops{ typeid(T),
+                        std::is_trivially_destructible<T>::value ? nullptr : +[](void* p){ static_cast<T*>(p)->~T(); },
+                        sizeof(T), alignof(T) };
+            return &ops;
+        }
+
+        //The blocks are carved from the inline buffer and then from the heap by the monotonic resource, in power of two
+        //size classes. A freed block goes to the free list of its class and is reused, so replaced values, removed
+        //entries and old tables do not accumulate in long living contexts. Big and over-aligned blocks go to the heap.
+        class Arena
+        {
+        public:
+            Arena(void* buffer, size_t size) : m_resource(buffer, size) { }
+
+            void* allocate(size_t size, size_t align)
+            {
+                size_t cls = classOf(size, align);
+                if(cls == Classes) return std::pmr::new_delete_resource()->allocate(size, align);
+                if(FreeNode* n = m_free[cls])
+                {
+                    m_free[cls] = n->next;
+                    return n;
+                }
+                return m_resource.allocate(MinBlock << cls, alignof(std::max_align_t));
+            }
+
+            void deallocate(void* p, size_t size, size_t align)
+            {
+                size_t cls = classOf(size, align);
+                if(cls == Classes) return std::pmr::new_delete_resource()->deallocate(p, size, align);
+                m_free[cls] = new(p) FreeNode{m_free[cls]};
+            }
+
+        private:
+            struct FreeNode
+            {
+                FreeNode* next;
+            };
+
+            static constexpr size_t MinBlock = 16;
+            static constexpr size_t Classes = 8;
+
+            //Classes means the heap
+            static size_t classOf(size_t size, size_t align)
+            {
+                if(alignof(std::max_align_t) < align) return Classes;
+                size_t cls = 0;
+                while(cls < Classes && (MinBlock << cls) < size) ++cls;
+                return cls;
+            }
+
+            std::pmr::monotonic_buffer_resource m_resource;
+            FreeNode* m_free[Classes] = {};
+        };
+
+        //the slot is empty if key is null, removed if ops is null, the key of a removed slot is freed
+        struct Slot
+        {
+            uint32_t hash;
+            uint32_t keyLen;
+            const char* key;
+            const TypeOps* ops;
+            void* value;
+        };
+
+        static constexpr size_t InitialSlots = 8;
+
+        //the keys, the values and the table are allocated from the arena, it is released at once with the task
+        alignas(std::max_align_t) char m_buffer[ArenaSize];
+        Arena m_arena{m_buffer, sizeof(m_buffer)};
+
+        //open addressing with linear probing
+        Slot* m_slots = nullptr;
+        size_t m_mask = 0;
+        size_t m_size = 0;
+        //live and removed slots
+        size_t m_used = 0;
+
+        Slot* find(const Key& key) const
+        {
+            if(!m_slots) return nullptr;
+            for(size_t i = key.hash & m_mask; ; i = (i + 1) & m_mask)
+            {
+                Slot& s = m_slots[i];
+                if(!s.key) return nullptr;
+                if(s.ops && s.hash == key.hash && s.keyLen == key.name.size()
+                        && std::char_traits<char>::compare(s.key, key.name.data(), s.keyLen) == 0)
+                    return &s;
+            }
+        }
+
+        Slot& insert(const Key& key)
+        {
+            if(!m_slots || (m_used + 1) * 4 > (m_mask + 1) * 3)
+            {//the table is rebuilt without removed slots
+                rehash(!m_slots ? InitialSlots : (m_size + 1) * 2 > m_mask + 1 ? (m_mask + 1) * 2 : m_mask + 1);
+            }
+            size_t i = key.hash & m_mask;
+            while(m_slots[i].key) i = (i + 1) & m_mask;
+            char* str = static_cast<char*>(m_arena.allocate(key.name.size() + 1, 1));
+            std::char_traits<char>::copy(str, key.name.data(), key.name.size());
+            str[key.name.size()] = '\0';
+            m_slots[i] = Slot{ key.hash, static_cast<uint32_t>(key.name.size()), str, nullptr, nullptr };
+            ++m_size;
+            ++m_used;
+            return m_slots[i];
+        }
+
+        void rehash(size_t count)
+        {
+            Slot* slots = static_cast<Slot*>(m_arena.allocate(count * sizeof(Slot), alignof(Slot)));
+            std::uninitialized_fill_n(slots, count, Slot{});
+            size_t mask = count - 1;
+            for(size_t i = 0; m_slots && i <= m_mask; ++i)
+            {
+                const Slot& s = m_slots[i];
+                if(!s.key || !s.ops) continue;
+                size_t j = s.hash & mask;
+                while(slots[j].key) j = (j + 1) & mask;
+                slots[j] = s;
+            }
+            if(m_slots) m_arena.deallocate(m_slots, (m_mask + 1) * sizeof(Slot), alignof(Slot));
+            m_slots = slots;
+            m_mask = mask;
+            m_used = m_size;
+        }
+
+        //destroys and frees the value of the slot, the key is kept
+        void destroy(Slot& s)
+        {
+            if(s.ops->destroy) s.ops->destroy(s.value);
+            m_arena.deallocate(s.value, s.ops->size, s.ops->align);
+        }
+
+        void freeKey(Slot& s)
+        {
+            m_arena.deallocate(const_cast<char*>(s.key), s.keyLen + 1, 1);
+        }
+
+        template<typename T>
+        static T* valueOf(const Slot* s)
+        {
+            if(!s || (s->ops != opsOf<std::remove_cv_t<T>>() && s->ops->type != typeid(T))) throw std::bad_any_cast();
+            return static_cast<T*>(s->value);
+        }
 
         class Proxy
         {
         public:
-            Proxy(ContextMap& map, const std::string& key)
-                : m_map(map), m_key(key) { }
+            Proxy(Local& local, const Key& key)
+                : m_local(local), m_key(key) { }
 
             template<typename T>
             Proxy& operator =(T&& v)
             {
                 static_assert(std::is_nothrow_move_constructible<T>::value,
                               "not move constructible");
+                using V = std::decay_t<T>;
 
-                std::any tmp(std::forward<T>(v));
-                auto it = m_map.find(m_key);
-                if(it == m_map.end())
+                Slot* s = m_local.find(m_key);
+                if constexpr(std::is_assignable<V&, T&&>::value)
                 {
-                    m_map.emplace(m_key, std::move(tmp));
-                }
-                else
-                {
-                    it->second = std::move(tmp);
+                    if(s && (s->ops == opsOf<V>() || s->ops->type == typeid(V)))
+                    {
+                        *static_cast<V*>(s->value) = std::forward<T>(v);
+                        return *this;
+                    }
                 }
+                void* p = m_local.m_arena.allocate(sizeof(V), alignof(V));
+                new(p) V(std::forward<T>(v));
+                if(s) m_local.destroy(*s);
+                else s = &m_local.insert(m_key);
+                s->ops = opsOf<V>();
+                s->value = p;
                 return *this;
             }
 
             template<typename T>
             operator T& () const
             {
-                return std::any_cast<T&>(m_map[m_key]);
+                return *valueOf<T>(m_local.find(m_key));
             }
 
         private:
-            ContextMap& m_map;
-            const std::string& m_key;
+            Local& m_local;
+            Key m_key;
         };
 
     public:
         Local() = default;
-        ~Local() = default;
+        ~Local()
+        {
+            //the blocks from the heap are freed explicitly, the rest goes with the arena
+            for(size_t i = 0; m_slots && i <= m_mask; ++i)
+            {
+                if(!m_slots[i].key || !m_slots[i].ops) continue;
+                destroy(m_slots[i]);
+                freeKey(m_slots[i]);
+            }
+            if(m_slots) m_arena.deallocate(m_slots, (m_mask + 1) * sizeof(Slot), alignof(Slot));
+        }
         Local(const Local&) = delete;
         Local(Local&&) = delete;
 
         template<typename T>
-        T const& operator[](const std::string& key) const
+        T const& operator[](const Key& key) const
         {
-            auto it = m_map.find(key);
-            return std::any_cast<T&>(it->second);
+            return *valueOf<T>(find(key));
         }
 
         template<typename T>
-        T operator[](const std::string& key) const
+        T operator[](const Key& key) const
         {
-            auto it = m_map.find(key);
-            return std::any_cast<T>(it->second);
+            return *valueOf<T>(find(key));
         }
 
-        Proxy operator[](const std::string& key)
+        Proxy operator[](const Key& key)
         {
-            return Proxy(m_map, key);
+            return Proxy(*this, key);
         }
 
-        bool hasKey(const std::string& key)
+        bool hasKey(const Key& key)
         {
-            return (m_map.find(key) != m_map.end());
+            return find(key) != nullptr;
         }
-        void remove(const std::string& key)
+        void remove(const Key& key)
         {
-            m_map.erase(key);
+            Slot* s = find(key);
+            if(!s) return;
+            destroy(*s);
+            freeKey(*s);
+            s->ops = nullptr;
+            --m_size;
         }
         void setError(const char* str, Status status = Status::InternalError)
         {
@@ -240,11 +450,25 @@ public:
         template<typename T>
         T get(const std::string& key, T defval) const
         {
-            return std::any_cast<T>(
-                m_map.valueFor(
-                    key, std::any(std::forward<T>(defval))
-                )
-            );
+            m_map.read(key, [&defval](const std::any& a) { defval = std::any_cast<const T&>(a); });
+            return defval;
+        }
+
+        //immutable values shared by the readers, setShared and getShared should be used for the same key
+        template<typename T>
+        void setShared(const std::string& key, std::shared_ptr<T> val, std::chrono::seconds ttl = std::chrono::seconds(0), GlobalContextMap::OnExpired onExpired = nullptr)
+        {
+            std::shared_ptr<const T> cval(std::move(val));
+            m_map.addOrUpdate(key, std::any(std::move(cval)), ttl, onExpired);
+        }
+
+        //returns nullptr if there is no such key, the value is not copied
+        template<typename T>
+        std::shared_ptr<const T> getShared(const std::string& key) const
+        {
+            std::shared_ptr<const T> res;
+            m_map.read(key, [&res](const std::any& a) { res = std::any_cast<const std::shared_ptr<const T>&>(a); });
+            return res;
         }
 
         template<typename T>
@@ -339,16 +563,22 @@ public:
     {
     public:
         GlobalFriend() = delete;
-        static void cleanup(Global& global, bool all = false)
+        //returns the number of expired entries
+        static size_t cleanup(Global& global)
         {
             GlobalFriend& gf = static_cast<GlobalFriend&>(global);
-            gf.m_map.cleanup(all);
+            return gf.m_map.cleanup();
         }
         static HandlerAPI* handlerAPI(Global& global)
         {
             GlobalFriend& gf = static_cast<GlobalFriend&>(global);
             return GlobalContextMapFriend::handlerAPI(gf.m_map);
         }
+        static ServiceRegistry& services(Global& global)
+        {
+            GlobalFriend& gf = static_cast<GlobalFriend&>(global);
+            return gf.m_map.services();
+        }
     };
 
     using uuid_t = boost::uuids::uuid;
@@ -375,10 +605,16 @@ public:
     uuid_t getNextTaskId() const { return m_nextUuid; }
 
     HandlerAPI* handlerAPI() { return GlobalFriend::handlerAPI(global); }
+    ServiceRegistry& services() { return GlobalFriend::services(global); }
+
+    //the upstream requests sent concurrently when the handler returns Forward, see fan_out.h
+    FanOut& fanOut();
+    bool hasFanOut() const { return bool(m_fanOut); }
 
 private:
     bool m_setXCallbackHeader = false;
     mutable uuid_t m_uuid;
     uuid_t m_nextUuid;
+    std::shared_ptr<FanOut> m_fanOut;
 };
 }//namespace graft
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "lib/graft/inout.h"
+#include "lib/graft/graft_constants.h"
+#include "lib/graft/timer.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace graft
+{
+
+class FanOutTask;
+
+//Upstream requests of a task sent concurrently. The handler adds the requests and returns Forward;
+//it is called again with Forward status once, when all the requests are answered, when the required number of
+//them are answered successfully or when the timeout expires. The answers are in the order of the requests.
+//It is accessed by ctx.fanOut().
+class FanOut
+{
+public:
+    FanOut() = default;
+    FanOut(const FanOut&) = delete;
+    FanOut& operator = (const FanOut&) = delete;
+
+    //the first request after the answers of the previous fan-out are received starts a new fan-out
+    void add(Output output)
+    {
+        if(!m_pending)
+        {
+            m_round = std::make_shared<Round>();
+            m_pending = true;
+        }
+        m_round->items.emplace_back(Item{std::move(output)});
+    }
+    //the number of successful answers the handler waits for, 0 means all the answers
+    void setNeed(size_t need) { if(m_pending) m_round->need = need; }
+    //0 means that only the timeouts of the upstream requests are applied
+    void setTimeout(std::chrono::milliseconds timeout) { if(m_pending) m_round->timeout = timeout; }
+
+    size_t size() const { return m_round ? m_round->items.size() : 0; }
+    //Ok, Error or None if the request is not answered yet
+    Status status(size_t i) const { return m_round->items.at(i).status; }
+    const Input& input(size_t i) const { return m_round->items.at(i).input; }
+    const std::string& error(size_t i) const { return m_round->items.at(i).error; }
+    //the number of successful answers
+    size_t answered() const { return m_round ? m_round->ok : 0; }
+
+private:
+    friend class TaskManager;
+    friend class FanOutTask;
+
+    struct Item
+    {
+        Output output;
+        Input input;
+        Status status = Status::None;
+        std::string error;
+    };
+
+    //the answers that come after the join are dropped, a new fan-out gets a new round
+    struct Round
+    {
+        std::vector<Item> items;
+        size_t need = 0;
+        std::chrono::milliseconds timeout{0};
+        size_t done = 0;
+        size_t ok = 0;
+        bool joined = false;
+        TimingWheel::Handle timer;
+
+        bool complete() const { return done == items.size() || (need != 0 && ok >= need); }
+    };
+
+    std::shared_ptr<Round> m_round;
+    //the requests are added and not sent yet
+    bool m_pending = false;
+};
+
+}//namespace graft
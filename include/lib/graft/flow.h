@@ -0,0 +1,74 @@
+#pragma once
+
+#include "lib/graft/router.h"
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace graft
+{
+
+//The base of the frame of a Flow, the locals kept between the steps are the members of the derived frame.
+class FlowFrame
+{
+public:
+    //the next call of the flow runs the current step again, e.g. after the next request upstream
+    void repeat() { m_next = m_step; }
+    //the next call of the flow runs the step with the index
+    void jump(size_t step) { m_next = step; }
+    size_t step() const { return m_step; }
+
+private:
+    template<typename> friend class Flow;
+    size_t m_step = 0;
+    size_t m_next = 0;
+};
+
+//Flow is a handler of a multi-hop request written as a sequence of steps, it is an alternative to the handlers
+//that switch on ctx.local.getLastStatus() or on a state kept in ctx.local. It is a Router::Handler, so it can be
+//any action of Handler3.
+//A step returning Forward, Postpone or Again suspends the flow; the next call of the handler (with the answer of the
+//upstream, after the task is resumed or after the partial response) continues from the next step.
+//Other statuses finish the flow.
+//The frame is created on the first call and kept in the local context of the task under a single key.
+template<typename Frame>
+class Flow
+{
+    static_assert(std::is_base_of<FlowFrame, Frame>::value, "the frame of a flow should be derived from FlowFrame");
+public:
+    using Step = std::function<Status (Frame& frame, const Router::vars_t& vars, const Input& input, Context& ctx, Output& output)>;
+
+    Flow() : m_steps(std::make_shared<std::vector<Step>>()) { }
+
+    Flow& then(Step step)
+    {
+        m_steps->emplace_back(std::move(step));
+        return *this;
+    }
+
+    Status operator ()(const Router::vars_t& vars, const Input& input, Context& ctx, Output& output) const
+    {
+        static const Context::Local::Key key(typeid(Frame).name());
+        if(!ctx.local.hasKey(key)) ctx.local[key] = Frame();
+        Frame& frame = ctx.local[key];
+
+        if(frame.m_step >= m_steps->size())
+        {
+            ctx.local.setError("the flow is called after its last step");
+            return Status::InternalError;
+        }
+        frame.m_next = frame.m_step + 1;
+        Status status = (*m_steps)[frame.m_step](frame, vars, input, ctx, output);
+        frame.m_step = frame.m_next;
+        return status;
+    }
+
+private:
+    //the steps are shared by the copies of the handler
+    std::shared_ptr<std::vector<Step>> m_steps;
+};
+
+}//namespace graft
@@ -17,7 +17,17 @@ namespace graft
 
 #define EXP_TO_ENUM(x) x,
 #define EXP_TO_STR(x) #x,
+#define EXP_TO_ONE(x) +1
 
 enum class Status : int { GRAFT_STATUS_LIST(EXP_TO_ENUM) };
 
+//the priority classes of the routes, each one has its own lane in the queues of the thread pool, of the upstream
+//connections and of the tasks ready to resume; the lanes are served by weighted round-robin
+#define GRAFT_PRIORITY_LIST(EXP) \
+    EXP(High) \
+    EXP(Normal) \
+    EXP(Bulk)
+
+enum class Priority : int { GRAFT_PRIORITY_LIST(EXP_TO_ENUM) };
+
 }//namespace graft
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <thread>
 #include <memory>
@@ -247,117 +249,181 @@ namespace graft
     class TSHashtable
     {
     private:
-        class BucketType
+        using BucketValue = std::pair<Key, Value>;
+        using node = typename TSList<BucketValue>::node;
+        using NodePtrPrivate = std::shared_ptr<node>;
+
+        //A stripe is an open addressing table with linear probing under its own lock, it grows independently.
+        //A lookup compares the stored hashes and locks the mutex of the found node only.
+        //The entries with ttl are in the min-heap of deadlines of the stripe. An access moves the expiration time of
+        //the node but not its deadline, the stale deadline is rescheduled when it is reached.
+        class alignas(64) Stripe
         {
-        private:
-            using BucketValue = std::pair<Key, Value>;
-            using BucketData = TSList<BucketValue>;
-            using BucketPtr = std::shared_ptr<BucketValue>;
-
-            BucketData m_data;
+        public:
+            struct Slot
+            {
+                size_t hash = 0;
+                NodePtrPrivate ptr;
+            };
 
-            BucketPtr findEntryFor(Key const& key)
+            struct Deadline
             {
-                return m_data.findFirstOf(
-                    [&](BucketValue const& item)
-                    {return item.first == key;}
-                );
-            }
-        public:
-            using node = typename BucketData::node;
-            using OnExpired = typename BucketData::OnExpired;
-            using FuncNode = typename BucketData::FuncNode;
+                ch::seconds expires;
+                size_t hash;
+                std::weak_ptr<node> ptr;
 
-            mutable std::shared_mutex blk;
+                bool operator <(const Deadline& other) const { return other.expires < expires; }
+            };
 
-            void forEachNode(FuncNode f)
-            {
-                m_data.forEachNode(f);
-            }
+            mutable std::shared_mutex blk;
+            std::vector<Slot> slots;
+            size_t count = 0;
+            std::vector<Deadline> deadlines;
+            //the earliest deadline, it is read without the lock
+            std::atomic<ch::seconds::rep> nextDeadline{ch::seconds::max().count()};
 
-            Value valueFor(Key const& key, Value const& default_value)
+            NodePtrPrivate find(size_t hash, Key const& key) const
             {
-                BucketPtr const found_entry = findEntryFor(key);
-                return (found_entry == nullptr) ?
-                    default_value : found_entry->second;
+                if(slots.empty()) return NodePtrPrivate();
+                return slots[probe(hash, key)].ptr;
             }
 
-            void addOrUpdate(Key const& key, Value const& value, ch::seconds ttl = ch::seconds(0), OnExpired onExpired = nullptr)
+            void insert(size_t hash, NodePtrPrivate ptr)
             {
-                BucketPtr const found_entry = findEntryFor(key);
-                if (found_entry == nullptr)
-                    m_data.pushFront(BucketValue(key,value), ttl, onExpired);
-                else
-                    found_entry->second = value;
+                if((count + 1) * 4 > slots.size() * 3)
+                {
+                    rehash(slots.empty() ? 16 : slots.size() * 2);
+                }
+                size_t i = probe(hash, ptr->data->first);
+                slots[i] = Slot{hash, std::move(ptr)};
+                ++count;
             }
 
-            void remove(Key const& key)
+            //only the given node is erased if it is set
+            bool erase(size_t hash, Key const& key, const node* only = nullptr)
             {
-                m_data.removeIf(
-                    [&](BucketValue const& item)
-                    {return item.first == key;}
-                );
+                if(slots.empty()) return false;
+                size_t i = probe(hash, key);
+                if(!slots[i].ptr || (only && slots[i].ptr.get() != only)) return false;
+                //backward shift deletion, the entries after the hole that can be found through it are moved
+                const size_t mask = slots.size() - 1;
+                for(size_t j = (i + 1) & mask; slots[j].ptr; j = (j + 1) & mask)
+                {
+                    size_t home = slots[j].hash & mask;
+                    if(((j - home) & mask) >= ((j - i) & mask))
+                    {
+                        slots[i] = std::move(slots[j]);
+                        i = j;
+                    }
+                }
+                slots[i] = Slot();
+                --count;
+                return true;
             }
 
-            bool hasKey(Key const& key)
+            void rehash(size_t size)
             {
-                BucketPtr const found_entry = findEntryFor(key);
-                return (found_entry != nullptr);
+                std::vector<Slot> old(size);
+                old.swap(slots);
+                const size_t mask = size - 1;
+                for(auto& s : old)
+                {
+                    if(!s.ptr) continue;
+                    size_t i = s.hash & mask;
+                    while(slots[i].ptr) i = (i + 1) & mask;
+                    slots[i] = std::move(s);
+                }
             }
 
-            bool applyFor(Key const& key, std::function<bool(Value&)> f)
+            void schedule(ch::seconds expires, size_t hash, const NodePtrPrivate& ptr)
             {
-                return m_data.findAndApplyFirstOf(
-                    [&](BucketValue const& item)
-                        {return item.first == key;},
-                    [&](BucketValue& item)
-                        {return f(item.second);}
-                );
+                deadlines.push_back(Deadline{expires, hash, ptr});
+                std::push_heap(deadlines.begin(), deadlines.end());
+                nextDeadline.store(deadlines.front().expires.count(), std::memory_order_relaxed);
             }
 
-            void cleanup(std::vector<std::function<void()>>& res)
+        private:
+            //the slot with the key or the empty slot where it should be
+            size_t probe(size_t hash, Key const& key) const
             {
-//                m_data.unsafe_cleanup(res);
-                m_data.safe_cleanup(res);
+                const size_t mask = slots.size() - 1;
+                for(size_t i = hash & mask; ; i = (i + 1) & mask)
+                {
+                    const Slot& s = slots[i];
+                    if(!s.ptr || (s.hash == hash && s.ptr->data->first == key)) return i;
+                }
             }
         };
 
-        std::vector<std::unique_ptr<BucketType>> m_buckets;
+        std::unique_ptr<Stripe[]> m_stripes;
+        size_t m_stripeCount;
         Hash m_hasher;
-        typename std::vector<std::unique_ptr<BucketType>>::iterator m_bit;
 
-        BucketType& getBucket(Key const& key) const
+        //the stripe is selected by the remainder of the hash, the slot by the rest of it
+        Stripe& getStripe(Key const& key, size_t& hash) const
         {
-            const std::size_t bucket_index = m_hasher(key) % m_buckets.size();
-            return *m_buckets[bucket_index];
+            size_t h = m_hasher(key);
+            hash = h / m_stripeCount;
+            return m_stripes[h % m_stripeCount];
         }
 
-        BucketType& getNextBucket()
+        NodePtrPrivate findNode(Key const& key) const
         {
-            BucketType& b = *(*m_bit);
-            if(++m_bit == m_buckets.end()) m_bit = m_buckets.begin();
-            return b;
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            std::shared_lock<std::shared_mutex> lock(s.blk);
+            return s.find(hash, key);
         }
 
-        void cleanup(BucketType& b)
+        size_t cleanup(Stripe& s, ch::seconds now_sec)
         {
             std::vector<std::function<void()>> res;
+            size_t expired = 0;
             {
-                std::unique_lock<std::shared_mutex> lock(b.blk);
-                b.cleanup(res);
+                std::unique_lock<std::shared_mutex> lock(s.blk);
+                while(!s.deadlines.empty() && s.deadlines.front().expires <= now_sec)
+                {
+                    std::pop_heap(s.deadlines.begin(), s.deadlines.end());
+                    typename Stripe::Deadline d = std::move(s.deadlines.back());
+                    s.deadlines.pop_back();
+
+                    //the node is removed or replaced already
+                    NodePtrPrivate ptr = d.ptr.lock();
+                    if(!ptr) continue;
+
+                    node& n = *ptr;
+                    std::lock_guard<std::mutex> lk(n.m);
+                    if(!n.data) continue;
+                    if(!n.expired(now_sec))
+                    {
+                        if(n.expires != ch::seconds::max()) s.schedule(n.expires, d.hash, ptr);
+                        continue;
+                    }
+                    if(!s.erase(d.hash, n.data->first, &n)) continue;
+                    ++expired;
+                    if(n.onExpired)
+                    {
+                        auto makeCall = [](std::shared_ptr<BucketValue>&& ptr, OnExpired&& onExp )->std::function<void()>
+                        {
+                            return [ptr,onExp]()->void { onExp(*ptr); };
+                        };
+                        res.push_back(makeCall(std::move(n.data), std::move(n.onExpired)));
+                    }
+                }
+                s.nextDeadline.store(s.deadlines.empty() ? ch::seconds::max().count() : s.deadlines.front().expires.count(),
+                                     std::memory_order_relaxed);
             }
             for(auto& f : res)
             {
                 f();
             }
+            return expired;
         }
 
     public:
         class Group
         {
         private:
-            using node = typename BucketType::node;
-            using NodePtrPrivate = std::shared_ptr<node>;
             using NodeWPtr = std::weak_ptr<node>;
             using ForEachFuncPrivate = std::function<bool(const Key& key, Value& val)>;
 
@@ -418,24 +484,10 @@ namespace graft
                     m_map.erase(it);
                 }
 
-                BucketType& b = m_table.getBucket(key);
-                std::shared_lock<std::shared_mutex> lock(b.blk);
-
-                bool res = false;
-                auto f = [this, &key, &res](NodePtr& ptr)->bool
-                {
-                    if(ptr->data->first == key)
-                    {
-                        res = true;
-                        NodeWPtr wptr = ptr;
-                        m_map.emplace(key, wptr);
-                        return false;
-                    }
-                    return true;
-                };
-                b.forEachNode(f);
-
-                return res;
+                NodePtr ptr = m_table.findNode(key);
+                if(!ptr) return false;
+                m_map.emplace(key, NodeWPtr(ptr));
+                return true;
             }
 
             bool remove(const Key& key)
@@ -491,15 +543,11 @@ namespace graft
         std::map<GroupName,std::shared_ptr<Group>> m_groups;
 
     public:
-        using OnExpired = typename BucketType::OnExpired;
+        using OnExpired = typename TSList<BucketValue>::OnExpired;
 
-        TSHashtable(unsigned num_buckets = 64, const Hash& h = Hash())
-            : m_buckets(num_buckets), m_hasher(h)
+        TSHashtable(unsigned num_stripes = 64, const Hash& h = Hash())
+            : m_stripes(new Stripe[num_stripes]), m_stripeCount(num_stripes), m_hasher(h)
         {
-            for (int i = 0; i < num_buckets; ++i)
-                m_buckets[i] = std::make_unique<BucketType>();
-
-            m_bit = m_buckets.begin();
         }
 
         TSHashtable(const TSHashtable& other) = delete;
@@ -507,47 +555,129 @@ namespace graft
 
         Value valueFor(Key const& key, Value const& default_value = Value()) const
         {
-            BucketType& b = getBucket(key);
-            std::shared_lock<std::shared_mutex> lock(b.blk);
-            return b.valueFor(key, default_value);
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            std::shared_lock<std::shared_mutex> lock(s.blk);
+            NodePtrPrivate ptr = s.find(hash, key);
+            if(!ptr) return default_value;
+            std::lock_guard<std::mutex> lk(ptr->m);
+            ptr->update_time();
+            return ptr->data->second;
+        }
+
+        //calls f(const Value&) under the lock of the entry, the value is not copied
+        //returns false if there is no such key
+        template<typename F>
+        bool read(Key const& key, F f) const
+        {
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            std::shared_lock<std::shared_mutex> lock(s.blk);
+            NodePtrPrivate ptr = s.find(hash, key);
+            if(!ptr) return false;
+            std::lock_guard<std::mutex> lk(ptr->m);
+            ptr->update_time();
+            f(static_cast<const Value&>(ptr->data->second));
+            return true;
         }
 
         void addOrUpdate(const Key& key, const Value& value, ch::seconds ttl = ch::seconds(0), OnExpired onExpired = nullptr)
         {
-            getBucket(key).addOrUpdate(key, value, ttl, onExpired);
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            auto update = [&value](node& n)
+            {
+                std::lock_guard<std::mutex> lk(n.m);
+                n.update_time();
+                n.data->second = value;
+            };
+            {
+                std::shared_lock<std::shared_mutex> lock(s.blk);
+                NodePtrPrivate ptr = s.find(hash, key);
+                if(ptr) return update(*ptr);
+            }
+            std::unique_lock<std::shared_mutex> lock(s.blk);
+            NodePtrPrivate ptr = s.find(hash, key);
+            if(ptr) return update(*ptr);
+            ptr = std::make_shared<node>(BucketValue(key, value), ttl, onExpired);
+            if(ttl != ch::seconds(0)) s.schedule(ptr->expires, hash, ptr);
+            s.insert(hash, std::move(ptr));
+        }
+
+        //calls f(Value&) under the lock of the entry, the entry with the default value is added if there is no such key
+        template<typename F>
+        void addOrApply(const Key& key, F f, ch::seconds ttl = ch::seconds(0), OnExpired onExpired = nullptr)
+        {
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            auto update = [&f](node& n)
+            {
+                std::lock_guard<std::mutex> lk(n.m);
+                n.update_time();
+                f(n.data->second);
+            };
+            {
+                std::shared_lock<std::shared_mutex> lock(s.blk);
+                NodePtrPrivate ptr = s.find(hash, key);
+                if(ptr) return update(*ptr);
+            }
+            std::unique_lock<std::shared_mutex> lock(s.blk);
+            NodePtrPrivate ptr = s.find(hash, key);
+            if(ptr) return update(*ptr);
+            ptr = std::make_shared<node>(BucketValue(key, Value()), ttl, onExpired);
+            //the entry is not visible to other threads yet
+            f(ptr->data->second);
+            if(ttl != ch::seconds(0)) s.schedule(ptr->expires, hash, ptr);
+            s.insert(hash, std::move(ptr));
         }
 
         void remove(const Key& key)
         {
-            BucketType& b = getBucket(key);
-            std::shared_lock<std::shared_mutex> lock(b.blk);
-            b.remove(key);
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            std::unique_lock<std::shared_mutex> lock(s.blk);
+            s.erase(hash, key);
         }
 
         bool hasKey(Key const& key) const
         {
-            BucketType& b = getBucket(key);
-            std::shared_lock<std::shared_mutex> lock(b.blk);
-            return b.hasKey(key);
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            std::shared_lock<std::shared_mutex> lock(s.blk);
+            NodePtrPrivate ptr = s.find(hash, key);
+            if(!ptr) return false;
+            std::lock_guard<std::mutex> lk(ptr->m);
+            ptr->update_time();
+            return true;
         }
 
         bool apply(Key const& key, std::function<bool(Value&)> f)
         {
-            BucketType& b = getBucket(key);
-            std::shared_lock<std::shared_mutex> lock(b.blk);
-            return b.applyFor(key, f);
+            size_t hash;
+            Stripe& s = getStripe(key, hash);
+            std::shared_lock<std::shared_mutex> lock(s.blk);
+            NodePtrPrivate ptr = s.find(hash, key);
+            if(!ptr) return false;
+            std::lock_guard<std::mutex> lk(ptr->m);
+            ptr->update_time();
+            return f(ptr->data->second);
         }
 
-        void cleanup(bool all = false)
+        //removes the entries with expired ttl, the work is proportional to the number of reached deadlines
+        //returns the number of expired entries
+        size_t cleanup()
         {
-            BucketType* b = &getNextBucket();
-            for(BucketType* n = b;;)
+            ch::seconds now_sec = ch::time_point_cast<ch::seconds>(
+                            ch::steady_clock::now()
+                        ).time_since_epoch();
+            size_t expired = 0;
+            for(size_t i = 0; i < m_stripeCount; ++i)
             {
-                cleanup(*n);
-                if(!all) break;
-                n = &getNextBucket();
-                if(n == b) break;
+                Stripe& s = m_stripes[i];
+                if(now_sec.count() < s.nextDeadline.load(std::memory_order_relaxed)) continue;
+                expired += cleanup(s, now_sec);
             }
+            return expired;
         }
     };
 }
@@ -7,17 +7,25 @@ namespace graft
 
 namespace request::system_info { class Counter; }
 struct ConfigOpts;
+class ServiceRegistry;
 
 class HandlerAPI
 {
 public:
+    //err is empty if the upstream has answered
+    using UpstreamCallback = std::function<void (const Input& input, const std::string& err)>;
+
     virtual void sendUpstreamBlocking(Output& output, Input& input, std::string& err) = 0;
+    //returns immediately, the callback is called in the thread pool when the upstream answers or fails;
+    //it is never dropped, if the thread pool is full it waits until a job is done
+    virtual void sendUpstreamAsync(const Output& output, UpstreamCallback callback) = 0;
     virtual bool addPeriodicTask(const Router::Handler& h_worker,
                                  std::chrono::milliseconds interval_ms,
                                  std::chrono::milliseconds initial_interval_ms = std::chrono::milliseconds::max(),
                                  double random_factor = 0) = 0;
     virtual request::system_info::Counter& runtimeSysInfo() = 0;
     virtual const ConfigOpts& configOpts() const = 0;
+    virtual ServiceRegistry& services() = 0;
 };
 
 }//namespace graft
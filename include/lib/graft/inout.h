@@ -10,6 +10,10 @@
 
 #include <utility>
 #include <string>
+#include <string_view>
+#include <ostream>
+#include <memory>
+#include <type_traits>
 #include <vector>
 #include <tuple>
 #include <unordered_map>
@@ -97,9 +101,9 @@ namespace graft
             {
                 return t.toJson().GetString();
             }
-            static void deserialize(const std::string& s, T& t)
+            static void deserialize(std::string_view s, T& t)
             {
-                t = T::fromJson(s);
+                t = T::fromJson(s.data(), s.size());
             }
         };
 
@@ -110,9 +114,9 @@ namespace graft
             {
                 return utils::base64_encode(t.toJson().GetString());
             }
-            static void deserialize(const std::string& s, T& t)
+            static void deserialize(std::string_view s, T& t)
             {
-                t = T::fromJson(utils::base64_decode(s));
+                t = T::fromJson(utils::base64_decode(std::string(s)));
             }
         };
 
@@ -129,7 +133,7 @@ namespace graft
         InOutHttpBase& operator = (InOutHttpBase&& ) = default;
         ~InOutHttpBase() = default;
 
-        InOutHttpBase(const http_message& hm, const std::string& host_) { operator =(hm); host = host_; }
+        InOutHttpBase(const http_message& hm, const std::string& host_) { assign(hm); host = host_; }
     public:
         InOutHttpBase& operator = (const InOutHttpBase& ) = default;
 
@@ -138,8 +142,7 @@ namespace graft
 
         //sometimes it is required to know client's host in a handler from input
         std::string host;
-        //These fields are from mongoose http_message
-        std::string body;
+        //These fields are from mongoose http_message, the body is a member of the derived classes
         std::string method;
         std::string uri;
         std::string proto;
@@ -163,8 +166,9 @@ namespace graft
         std::vector<std::pair<std::string, std::string>> headers;
         std::string extra_headers;
     private:
-        InOutHttpBase& operator = (const http_message& hm);
-        void set_str_field(const http_message& hm, const mg_str& str_fld, std::string& fld);
+        void assign(const http_message& hm);
+    protected:
+        static void set_str_field(const http_message& hm, const mg_str& str_fld, std::string& fld);
     };
 
     class OutHttp final : public InOutHttpBase
@@ -199,6 +203,12 @@ namespace graft
             return body;
         }
 
+        void reset()
+        {
+            InOutHttpBase::reset();
+            body.clear();
+        }
+
         /*!
          * \brief makeUri - please DO NOT use it. It is for internal usage.
          * Set uri, proto, host, port, path members if you need.
@@ -209,11 +219,76 @@ namespace graft
          */
         std::string makeUri(const std::string& default_uri) const;
 
+        std::string body;
         std::string port;
         std::string path;
         static std::unordered_map<std::string, std::tuple<std::string,int,bool,double>> uri_substitutions;
     };
 
+    /*!
+     * \brief InBody - the body of a received message.
+     * It refers to the shared bytes of the message until it is read as std::string or changed,
+     * then it is copied once into its own string. view() never copies.
+     * It can be used as std::string const& and assigned from std::string, like the body of Output.
+     */
+    class InBody
+    {
+    public:
+        InBody() = default;
+        explicit InBody(std::string s) : m_str(std::move(s)) { }
+
+        InBody& operator = (std::string s)
+        {
+            m_str = std::move(s);
+            m_message.reset(); m_view = std::string_view();
+            return *this;
+        }
+
+        void assign(const char* first, const char* last) { *this = std::string(first, last); }
+
+        void clear() { *this = std::string(); }
+
+        std::string_view view() const { return (m_message)? m_view : std::string_view(m_str); }
+
+        const std::string& str() const
+        {
+            if(m_message)
+            {
+                m_str.assign(m_view.data(), m_view.size());
+                m_message.reset(); m_view = std::string_view();
+            }
+            return m_str;
+        }
+
+        operator const std::string& () const { return str(); }
+        const char* c_str() const { return str().c_str(); }
+        const char* data() const { return str().data(); }
+        bool empty() const { return view().empty(); }
+        size_t size() const { return view().size(); }
+        size_t length() const { return view().size(); }
+
+        friend bool operator == (const InBody& l, std::string_view r) { return l.view() == r; }
+        friend bool operator == (std::string_view l, const InBody& r) { return l == r.view(); }
+        friend bool operator == (const InBody& l, const InBody& r) { return l.view() == r.view(); }
+        friend bool operator != (const InBody& l, std::string_view r) { return !(l == r); }
+        friend bool operator != (std::string_view l, const InBody& r) { return !(l == r); }
+        friend bool operator != (const InBody& l, const InBody& r) { return !(l == r); }
+        friend std::ostream& operator << (std::ostream& os, const InBody& b) { return os << b.view(); }
+
+    private:
+        friend class InHttp;
+        void share(std::shared_ptr<const char> message, std::string_view view)
+        {
+            m_str.clear();
+            m_message = std::move(message); m_view = view;
+        }
+
+        //str() makes the copy on the first access, so an InBody should not be read by several threads at once
+        mutable std::string m_str;
+        mutable std::shared_ptr<const char> m_message;
+        mutable std::string_view m_view;
+    };
+
     class InHttp final : public InOutHttpBase
     {
     public:
@@ -223,8 +298,20 @@ namespace graft
         InHttp& operator = (const InHttp&) = default;
         InHttp& operator = (InHttp&&) = default;
         ~InHttp() = default;
-        InHttp(const http_message& hm, const std::string& host_) : InOutHttpBase(hm, host_)
-        { }
+        InHttp(const http_message& hm, const std::string& host_);
+
+        /*!
+         * \brief InHttp - takes the received message without copying of its body.
+         * \param message - holds the bytes of hm.message, it can be the same memory that hm refers to.
+         * The body is shared by copies of the Input, body_view(), data() and get functions read it without copying.
+         * The body field is copied from the message on the first access as std::string. Other fields are filled as usual.
+         */
+        InHttp(const http_message& hm, const std::string& host_, std::shared_ptr<const char> message);
+
+        std::string_view body_view() const
+        {
+            return body.view();
+        }
 
         /*!
          * \brief get - parses object from JSON. Throws ParseError exception in case parse error
@@ -235,7 +322,7 @@ namespace graft
         {
             T result;
             try {
-                serializer::JSON<T>::deserialize(body, result);
+                serializer::JSON<T>::deserialize(body_view(), result);
             } catch (const rapidjson::ParseResult &pr) {
                 throw serializer::JsonParseError(pr);
             }
@@ -262,7 +349,7 @@ namespace graft
         T get() const
         {
             T t;
-            S::deserialize(body, t);
+            deserialize<S>(t);
             return t;
         }
 
@@ -271,7 +358,7 @@ namespace graft
         T getT() const
         {
             T t;
-            S<T>::deserialize(body, t);
+            deserialize<S<T>>(t);
             return t;
         }
 
@@ -290,7 +377,7 @@ namespace graft
 
         void load(const char *buf, size_t size)
         {
-            InOutHttpBase::reset();
+            reset();
             body.assign(buf, buf + size);
         }
 
@@ -302,20 +389,33 @@ namespace graft
         void assign(const OutHttp& out)
         {
             static_cast<InOutHttpBase&>(*this) = static_cast<const InOutHttpBase&>(out);
+            body = out.body;
         }
 
         void reset()
         {
             InOutHttpBase::reset();
+            body.clear();
         }
 
         std::string data() const
         {
-            return body;
+            return std::string(body_view());
         }
 
     public:
+        InBody body;
         uint16_t port = 0;
+    private:
+        template<typename S, typename T>
+        void deserialize(T& t) const
+        {
+            //custom serializers can take const std::string&
+            if constexpr (std::is_invocable_v<decltype(&S::deserialize), std::string_view, T&>)
+                S::deserialize(body_view(), t);
+            else
+                S::deserialize(std::string(body_view()), t);
+        }
     };
 
     using Input = InHttp;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "lib/graft/graft_constants.h"
+#include "lib/graft/thread_pool/lanes.hpp"
+
+#include <array>
+#include <deque>
+#include <utility>
+
+namespace graft
+{
+
+static_assert(0 GRAFT_PRIORITY_LIST(EXP_TO_ONE) == tp::LaneCount, "each priority should have a lane");
+
+inline size_t toLane(Priority priority) { return static_cast<size_t>(priority); }
+
+//A queue of the IO thread with a FIFO lane per priority. The lanes are popped by weighted round-robin,
+//the same way the workers of the thread pool take their jobs.
+template<typename T>
+class LaneQueue
+{
+public:
+    explicit LaneQueue(const tp::LaneWeights& weights = tp::defaultLaneWeights()) : m_scheduler(weights) { }
+
+    void push(T value, Priority priority)
+    {
+        m_lanes[toLane(priority)].push_back(std::move(value));
+        ++m_size;
+    }
+
+    bool pop(T& value)
+    {
+        if(m_size == 0) return false;
+        return m_scheduler.pick([this, &value](size_t lane)
+        {
+            auto& queue = m_lanes[lane];
+            if(queue.empty()) return false;
+            value = std::move(queue.front());
+            queue.pop_front();
+            --m_size;
+            return true;
+        });
+    }
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+    size_t size(Priority priority) const { return m_lanes[toLane(priority)].size(); }
+
+private:
+    std::array<std::deque<T>, tp::LaneCount> m_lanes;
+    tp::LaneScheduler m_scheduler;
+    size_t m_size = 0;
+};
+
+}//namespace graft
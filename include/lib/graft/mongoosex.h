@@ -3,6 +3,8 @@
 #include "mongoose.h"
 
 #include <string>
+#include <memory>
+#include <sys/uio.h>
 
 //Following functions are adapted from similar mongoose functions. They allow sending of null chars,
 //for this they take const std::string& as some parameters instead of const char*.
@@ -16,4 +18,47 @@ mg_connection *mg_connect_http_x(
     MG_CB(mg_event_handler_t event_handler, void *user_data), const char *url,
     const char *extra_headers, const std::string& post_data);
 
+//Similar to mg_bind but the listening socket is created with SO_REUSEPORT, so that
+//several managers (one per IO thread) can listen on the same address.
+//Only TCP addresses in the form [tcp://][ip:]port are supported.
+mg_connection *mg_bind_reuseport_x(
+    mg_mgr *mgr, const char *address,
+    MG_CB(mg_event_handler_t event_handler, void *user_data));
+
+//Returns memory that holds hm.message bytes. If the receive buffer of the connection contains the message only
+//the buffer is taken from the connection without copying, otherwise the message is copied.
+std::shared_ptr<const char> mg_take_message_x(mg_connection *nc, const http_message& hm);
+
+//Similar to several mg_send calls. If nothing is queued in the send buffer of the TCP connection the data
+//is written to the socket in one sendmsg call, only the part the socket has not accepted is copied to the send buffer.
+void mg_send_iov_x(mg_connection *nc, const iovec *iov, int iovcnt);
+
+//Sends head and body one after another, the strings are taken by the connection. With the epoll interface the part
+//the socket has not accepted is not copied, the strings are kept by the connection and freed as they are written.
+//The output queued by mg_send meanwhile is written before them. With other interfaces it is the same as mg_send_iov_x.
+void mg_send_x(mg_connection *nc, std::string&& head, std::string&& body);
+
+//Sets the flags of the connection, MG_F_CLOSE_IMMEDIATELY or MG_F_SEND_AND_CLOSE. The epoll interface visits
+//only the connections that have something to do, the flags set outside of the event handler of the connection
+//should be set by this call.
+void mg_set_flags_x(mg_connection *nc, unsigned long flags);
+
+//Similar to mg_set_timer. The epoll interface keeps the timers in a heap, the timers set outside of the event handler
+//of the connection should be set by this call.
+double mg_set_timer_x(mg_connection *nc, double timestamp);
+
+#ifdef GN_ENABLE_EPOLL
+
+using epoll_notify_cb_t = void (*)(mg_mgr *mgr, uint64_t cnt);
+
+//Replaces select based readiness checking of the main interface of the manager by edge-triggered epoll.
+//Socket IO itself is done by the default mongoose interface. The epoll interface keeps its data of a connection
+//in mgr_data of the connection.
+//The manager should not have connections yet. mg_notify does not work for the manager after the call,
+//mg_notify_epoll_x should be used instead, it leads to call of cb from mg_mgr_poll.
+void mg_mgr_use_epoll_x(mg_mgr *mgr, epoll_notify_cb_t cb);
+void mg_notify_epoll_x(mg_mgr *mgr);
+
+#endif //GN_ENABLE_EPOLL
+
 } //namespace mg
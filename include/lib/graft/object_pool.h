@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace graft
+{
+    //Pool of blocks for the objects that are created and destroyed for each request by an IO thread:
+    //tasks with their shared_ptr control blocks, upstream senders and thread pool jobs.
+    //The IO thread that is the owner of the pool allocates blocks from free lists of size classes, the blocks are
+    //carved from big chunks that are kept until the pool is deleted. Other threads and big sizes go to the heap.
+    //A block can be freed by any thread, blocks freed by other threads are returned to the free lists lazily.
+    class SlabPool
+    {
+    public:
+        static SlabPool* create();
+        //the pool is deleted when all of its blocks are freed
+        void close();
+
+        //the current thread becomes the owner of the pool, nullptr to detach
+        static void setCurrent(SlabPool* pool);
+        static SlabPool* current();
+
+        //allocates from the pool of the current thread or from the heap
+        static void* allocate(size_t size);
+        static void deallocate(void* p) noexcept;
+
+        static constexpr size_t Alignment = 16;
+        static constexpr size_t ClassSize = 64;
+        static constexpr size_t Classes = 64;
+        static constexpr size_t MaxSize = ClassSize * Classes;
+        static constexpr size_t ChunkSize = 64 * 1024;
+
+    private:
+        struct alignas(Alignment) Header
+        {
+            SlabPool* owner;
+            uint32_t cls;
+        };
+        struct FreeNode
+        {
+            FreeNode* next;
+        };
+
+        SlabPool() = default;
+        ~SlabPool();
+        SlabPool(const SlabPool&) = delete;
+        SlabPool& operator = (const SlabPool&) = delete;
+
+        Header* take(uint32_t cls);
+        void put(Header* h) noexcept;
+        void putRemote(Header* h) noexcept;
+        void release() noexcept;
+
+        FreeNode* m_free[Classes] = {};
+        std::vector<std::unique_ptr<char[]>> m_chunks;
+        char* m_chunkPos = nullptr;
+        char* m_chunkEnd = nullptr;
+        //blocks in use and one more for the owner until close()
+        std::atomic<size_t> m_refs{1};
+        std::atomic<FreeNode*> m_remote{nullptr};
+    };
+
+    //std compatible allocator, it is used for shared_ptr control blocks
+    template<typename T>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+
+        PoolAllocator() = default;
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U>&) noexcept { }
+
+        T* allocate(size_t n) { return static_cast<T*>(SlabPool::allocate(n * sizeof(T))); }
+        void deallocate(T* p, size_t) noexcept { SlabPool::deallocate(p); }
+
+        template<typename U>
+        bool operator == (const PoolAllocator<U>&) const noexcept { return true; }
+        template<typename U>
+        bool operator != (const PoolAllocator<U>&) const noexcept { return false; }
+    };
+
+    template<typename T>
+    struct PoolDeleter
+    {
+        PoolDeleter() = default;
+        template<typename U>
+        PoolDeleter(const PoolDeleter<U>&) noexcept { }
+
+        void operator()(T* p) const noexcept
+        {
+            p->~T();
+            SlabPool::deallocate(p);
+        }
+    };
+
+    template<typename T, typename ...ARGS>
+    T* poolNew(ARGS&&... args)
+    {
+        static_assert(alignof(T) <= SlabPool::Alignment, "over-aligned type");
+        void* mem = SlabPool::allocate(sizeof(T));
+        try
+        {
+            return new(mem) T(std::forward<ARGS>(args)...);
+        }
+        catch(...)
+        {
+            SlabPool::deallocate(mem);
+            throw;
+        }
+    }
+}
@@ -3,6 +3,7 @@
 
 #include "lib/graft/inout.h"
 #include "lib/graft/context.h"
+#include "lib/graft/graft_constants.h"
 #include "r3.h"
 
 #include <forward_list>
@@ -13,14 +14,95 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cassert>
 
 namespace graft {
 
+//Variables of a matched route, ordered by keys like std::multimap. Keys and values are kept in a single buffer,
+//the entries for up to InlineVars variables are kept in the object itself.
+//The views returned are valid while the object is alive and not changed.
+class RouteVars
+{
+public:
+    using value_type = std::pair<std::string_view, std::string_view>;
+
+    class const_iterator
+    {
+    public:
+        const_iterator(const RouteVars* vars, size_t idx) : m_vars(vars), m_idx(idx) { }
+
+        //the pair is kept in the iterator
+        const value_type& operator*() const { m_val = m_vars->at(m_idx); return m_val; }
+        const value_type* operator->() const { return &**this; }
+        const_iterator& operator++() { ++m_idx; return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; ++m_idx; return it; }
+        bool operator==(const const_iterator& it) const { return m_idx == it.m_idx; }
+        bool operator!=(const const_iterator& it) const { return m_idx != it.m_idx; }
+    private:
+        const RouteVars* m_vars;
+        size_t m_idx;
+        mutable value_type m_val;
+    };
+    using iterator = const_iterator;
+
+    RouteVars() = default;
+    RouteVars(const RouteVars& v) { *this = v; }
+    RouteVars(RouteVars&& v) noexcept { *this = std::move(v); }
+    RouteVars& operator = (const RouteVars& v);
+    RouteVars& operator = (RouteVars&& v) noexcept;
+
+    void emplace(std::string_view key, std::string_view value);
+    void clear() { m_buf.clear(); m_more.clear(); m_size = 0; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const_iterator lower_bound(std::string_view key) const { return const_iterator(this, lowerIndex(key)); }
+    const_iterator upper_bound(std::string_view key) const { return const_iterator(this, upperIndex(key)); }
+    std::pair<const_iterator, const_iterator> equal_range(std::string_view key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+    const_iterator find(std::string_view key) const;
+    size_t count(std::string_view key) const;
+
+    static constexpr size_t InlineVars = 4;
+private:
+    struct Entry
+    {
+        uint32_t key;
+        uint32_t keyLen;
+        uint32_t value;
+        uint32_t valueLen;
+    };
+
+    size_t lowerIndex(std::string_view k) const;
+    size_t upperIndex(std::string_view k) const;
+    Entry* entries() { return (m_size <= InlineVars)? m_inline : m_more.data(); }
+    const Entry* entries() const { return (m_size <= InlineVars)? m_inline : m_more.data(); }
+    std::string_view key(size_t i) const { const Entry& e = entries()[i]; return std::string_view(m_buf.data() + e.key, e.keyLen); }
+    value_type at(size_t i) const
+    {
+        const Entry& e = entries()[i];
+        return value_type(std::string_view(m_buf.data() + e.key, e.keyLen), std::string_view(m_buf.data() + e.value, e.valueLen));
+    }
+
+    std::string m_buf;
+    Entry m_inline[InlineVars];
+    std::vector<Entry> m_more;
+    size_t m_size = 0;
+};
+
 template<typename In, typename Out>
 class RouterT
 {
 public:
-    using vars_t = std::multimap<std::string, std::string>;
+    using vars_t = RouteVars;
     using Handler = std::function<Status (const vars_t&, const In&, Context&, Out& ) >;
 
     struct Handler3
@@ -42,20 +124,34 @@ public:
 
         Handler3(const Handler& worker_action) : worker_action(worker_action) { }
         Handler3(Handler&& worker_action) : worker_action(std::move(worker_action)) { }
+
+        //the handlers of the tasks that have no route
+        static const Handler3& none()
+        {
+            static const Handler3 h;
+            return h;
+        }
     public:
         Handler pre_action;
         Handler worker_action;
         Handler post_action;
         std::string name;
+        //the lane of the tasks of the route, it is set by addRoute
+        Priority priority = Priority::Normal;
     };
 
+    //the handlers are not copied for each request, h3 points to the ones of the route or of the periodic task;
+    //routes are immutable after Root::arm() and live as long as the Root
     struct JobParams
     {
         Input input;
         vars_t vars;
-        Handler3 h3;
+        const Handler3* h3 = &Handler3::none();
     };
 
+private:
+    struct Route;
+public:
     class Root
     {
     public:
@@ -63,16 +159,37 @@ public:
         ~Root() { r3_tree_free(m_node); }
 
         bool arm();
-        bool match(const std::string& target, int method, JobParams& params);
-        void addRouter(RouterT& r) { m_routers.push_front(std::move(r)); }
+        bool match(const std::string& target, int method, JobParams& params) const;
+        void addRouter(RouterT& r)
+        {
+            assert(!m_compiled);
+            m_routers.push_front(std::move(r));
+        }
 
         std::string dbgDumpRouters() const;
         void dbgDumpR3Tree(int level = 0) const;
         std::string dbgCheckConflictRoutes() const;
     private:
+        //the routes without variables with the same endpoint
+        struct StaticEntry
+        {
+            std::string endpoint;
+            std::vector<const Route*> routes;
+        };
+
+        void buildStatic();
+        const Route* matchStatic(const std::string& target, int method) const;
+        static const Route* pickStatic(const std::vector<const Route*>& routes, int method);
+        const Route* matchR3(const std::string& target, int method) const;
+        static uint64_t hash(const char* s, size_t len, uint64_t seed);
+
         bool m_compiled = false;
         R3Node *m_node;
         std::forward_list<RouterT> m_routers;
+        //perfect hash table of static endpoints, there are no collisions for m_seed;
+        //it keeps only the endpoints r3 resolves to the same routes, so it does not change the precedence
+        std::vector<StaticEntry> m_static;
+        uint64_t m_seed = 0;
     };
 
     RouterT(const std::string& prefix = std::string()) : m_endpointPrefix(prefix) { }
@@ -83,17 +200,21 @@ public:
 
     ~RouterT() = default;
 
-    void addRoute(const std::string& endpoint, int methods, const Handler3& ph3)
+    //the requests of a route with a higher priority overtake the ones of the routes with lower priorities
+    //in the queues of the server
+    void addRoute(const std::string& endpoint, int methods, const Handler3& ph3, Priority priority = Priority::Normal)
     {
         Route r{m_endpointPrefix + endpoint, methods, ph3};
+        r.h3.priority = priority;
         m_routes.push_front(r);
     }
 
     // Please read the comment about exceptions and noexcept specifier
     // near 'void terminate()' function in main.cpp
-    void addRoute(const std::string& endpoint, int methods, const Handler3&& ph3)
+    void addRoute(const std::string& endpoint, int methods, const Handler3&& ph3, Priority priority = Priority::Normal)
     {
         m_routes.push_front({m_endpointPrefix + endpoint, methods, std::move(ph3)});
+        m_routes.front().h3.priority = priority;
     }
 
 public:
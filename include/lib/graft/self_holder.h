@@ -1,5 +1,7 @@
 #pragma once
 
+#include "lib/graft/object_pool.h"
+
 #include <memory>
 
 namespace graft {
@@ -12,15 +14,30 @@ public:
 
     Ptr getSelf() { return m_self; }
 
+    //the object and the control block of m_self are allocated from the pool of the IO thread
     template<typename T=C, typename ...ARGS>
     static const Ptr Create(ARGS&&... args)
     {
-        return (new T(std::forward<ARGS>(args)...))->m_self;
+        static_assert(alignof(T) <= SlabPool::Alignment, "over-aligned type");
+        void* mem = SlabPool::allocate(sizeof(T));
+        C* self;
+        try
+        {
+            //constructors of tasks are private, SelfHolder is their friend
+            self = new(mem) T(std::forward<ARGS>(args)...);
+        }
+        catch(...)
+        {
+            SlabPool::deallocate(mem);
+            throw;
+        }
+        self->m_self = Ptr(self, PoolDeleter<C>(), PoolAllocator<C>());
+        return self->m_self;
     }
 protected:
     void releaseItself() { m_self.reset(); }
 
-    SelfHolder() : m_self(static_cast<C*>(this)) { }
+    SelfHolder() = default;
 private:
     Ptr m_self;
 };
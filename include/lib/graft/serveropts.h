@@ -41,14 +41,32 @@ struct ConfigOpts
     IPFilterOpts ipfilter;
     CommonOpts common;
 
+    //the options with defaults are kept after the others, so the positional initialization of the rest works
+    //maximal number of requests served over one keep-alive client connection, 0 disables keep-alive
+    int http_keep_alive_max_requests = 100;
+    //maximal number of threads started for the workers in blocking regions, -1 means workers_count, 0 disables it
+    int workers_compensation_max = -1;
+    //maximal number of connections to cryptonode_rpc_address per IO thread, 0 means no limit;
+    //when all of them are busy, the requests wait in the lanes of their route priorities,
+    //without a limit the lanes are not used and a flood of bulk requests delays the others in cryptonode
+    int cryptonode_max_connections = 16;
+    //number of IO threads (event loops) that share the HTTP listening address
+    int io_threads = 1;
+    //"select" (default mongoose polling) or "epoll"
+    std::string io_backend = "select";
+
     void check_asserts() const
     {
         assert(!http_address.empty());
         assert(!coap_address.empty());
         assert(0 < http_connection_timeout);
+        assert(0 <= http_keep_alive_max_requests);
         assert(0 < upstream_request_timeout);
         assert(0 < workers_expelling_interval_ms);
+        assert(0 <= cryptonode_max_connections);
         assert(0 < timer_poll_interval_ms);
+        assert(0 < io_threads);
+        assert(io_backend == "select" || io_backend == "epoll");
         assert(0 < lru_timeout_ms);
         assert(ipfilter.requests_per_sec == 0 || 0 < ipfilter.window_size_sec);
     }
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graft
+{
+    //Compile time key of a service, T is the type of the service and Index is its slot in the registry.
+    //The indexes of the keys are unique within the process.
+    template<typename T, size_t Index>
+    struct ServiceKey
+    {
+        using type = T;
+        static constexpr size_t index = Index;
+    };
+
+    //The registry of the long lived objects shared by the handlers (the supernode list, the configuration, etc.).
+    //The services are registered at startup, a lookup is a load of a pointer without locks.
+    //A replaced service is kept until the registry is deleted, so the references given to the readers stay valid.
+    class ServiceRegistry
+    {
+    public:
+        static constexpr size_t MaxServices = 16;
+
+        ServiceRegistry() = default;
+        ServiceRegistry(const ServiceRegistry&) = delete;
+        ServiceRegistry& operator = (const ServiceRegistry&) = delete;
+
+        template<typename K>
+        void set(typename K::type value)
+        {
+            static_assert(K::index < MaxServices, "the index of the service key is too big");
+            using T = typename K::type;
+            std::shared_ptr<T> holder = std::make_shared<T>(std::move(value));
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_holders.emplace_back(holder);
+            m_slots[K::index].store(holder.get(), std::memory_order_release);
+        }
+
+        //returns nullptr if the service is not registered
+        template<typename K>
+        const typename K::type* find() const
+        {
+            static_assert(K::index < MaxServices, "the index of the service key is too big");
+            return static_cast<const typename K::type*>(m_slots[K::index].load(std::memory_order_acquire));
+        }
+
+        //returns the default value of the type (a null pointer, an empty string) if the service is not registered
+        template<typename K>
+        const typename K::type& get() const
+        {
+            using T = typename K::type;
+            if(const T* p = find<K>()) return *p;
+            static const T none{};
+            return none;
+        }
+
+    private:
+        std::array<std::atomic<const void*>, MaxServices> m_slots{};
+        std::mutex m_mutex;
+        std::vector<std::shared_ptr<void>> m_holders;
+    };
+
+    namespace services
+    {
+        using Testnet = ServiceKey<bool, 0>;
+        using CryptonodeRpcAddress = ServiceKey<std::string, 1>;
+
+        //the first index of the keys defined by the applications
+        static constexpr size_t AppIndex = 2;
+    }//namespace services
+
+}//namespace graft
@@ -3,6 +3,9 @@
 
 #include "lib/graft/task.h"
 
+#include <cstdint>
+#include <initializer_list>
+
 namespace graft
 {
 
@@ -25,43 +28,67 @@ public:
     enum State { GRAFT_STATE_LIST(EXP_TO_ENUM) };
 
     using St = graft::Status;
-    using Statuses = std::initializer_list<graft::Status>;
-    using Guard = std::function<bool (BaseTaskPtr bt)>;
-    using Action = std::function<void (BaseTaskPtr bt)>;
+    using Guard = bool (*)(const BaseTask& bt);
+    using Action = void (*)(BaseTask& bt);
 
-    StateMachine(State initial_state = EXECUTE)
-    {
-        state(initial_state);
-        init_table();
-    }
+    StateMachine() = delete;
+
+    //the caller keeps the task alive, an action can finalize it
+    static void dispatch(BaseTask& bt, State initial_state);
+
+private:
+    static constexpr size_t StateCount = 0 GRAFT_STATE_LIST(EXP_TO_ONE);
+    static constexpr size_t StatusCount = 0 GRAFT_STATUS_LIST(EXP_TO_ONE);
+
+    using StatusMask = uint32_t;
+    static_assert(StatusCount <= sizeof(StatusMask) * 8, "too many statuses for the mask");
 
-    void dispatch(BaseTaskPtr bt, State initial_state)
+    static constexpr StatusMask ANY = ~StatusMask(0);
+    static constexpr StatusMask mask(std::initializer_list<St> ss)
     {
-        state(initial_state);
-        while(state() != EXIT)
-        {
-            process(bt);
-        }
+        StatusMask res = 0;
+        for(St s : ss) res |= StatusMask(1) << static_cast<int>(s);
+        return res;
     }
 
-private:
-    void init_table();
-    State state() const { return m_state; }
-    State state(State state) { return m_state = state; }
-    St status(BaseTaskPtr bt) const { return bt->getLastStatus(); }
+    struct Row
+    {
+        State start;
+        StatusMask statuses;
+        State end;
+        Guard guard;
+        Action action;
+    };
+
+    //the rows of the table that match a state and a status, in the order of the table;
+    //the first one with a passing guard is taken
+    static constexpr size_t MaxCandidates = 2;
+    struct Cell
+    {
+        uint8_t count;
+        uint8_t rows[MaxCandidates];
+    };
 
-    void process(BaseTaskPtr bt);
+    struct Matrix
+    {
+        Cell cells[StateCount][StatusCount];
+    };
 
     using H3 = Router::Handler3;
 
-    const Guard has(Router::Handler H3::* act);
-    const Guard hasnt(Router::Handler H3::* act);
+    template<Router::Handler H3::* act>
+    static bool has(const BaseTask& bt) { return bt.getHandler3().*act != nullptr; }
+    template<Router::Handler H3::* act>
+    static bool hasnt(const BaseTask& bt) { return bt.getHandler3().*act == nullptr; }
 
-    State m_state;
-    enum columns          { smStateStart,   smStatuses, smStateEnd, smGuard,    smAction};
-    using row = std::tuple< State,          Statuses,   State,      Guard,      Action  >;
-    std::vector<row> m_table;
+    template<size_t N>
+    static constexpr Matrix makeMatrix(const Row (&table)[N]);
+
+    static void runResponse(BaseTask& bt);
+    static void runErrorResponse(BaseTask& bt);
+    static void runDrop(BaseTask& bt);
+
+    static State process(BaseTask& bt, State state, const Row* table, const Matrix& matrix);
 };
 
 }//namespace graft
-
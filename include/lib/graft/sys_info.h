@@ -39,6 +39,8 @@ class Counter
     void count_upstrm_http_req_bytes_raw(u32 inc_delta)   { m_upstrm_http_req_bytes_raw_cnt += inc_delta; }
     void count_upstrm_http_resp_bytes_raw(u32 inc_delta)  { m_upstrm_http_resp_bytes_raw_cnt += inc_delta; }
 
+    void count_global_ctx_expired(u32 inc_delta);
+
     // interface for consumer
     u64 http_request_total_cnt(void)          const { return m_http_req_total_cnt; }
     u64 http_request_routed_cnt(void)         const { return m_http_req_routed_cnt; }
@@ -59,13 +61,25 @@ class Counter
     u64 upstrm_http_req_bytes_raw_cnt(void)   const { return m_upstrm_http_req_bytes_raw_cnt; }
     u64 upstrm_http_resp_bytes_raw_cnt(void)  const { return m_upstrm_http_resp_bytes_raw_cnt; }
 
+    u64 global_ctx_expired_cnt(void)          const { return m_global_ctx_expired_cnt; }
+    // average over the last complete window of ExpiredRateWindowSec seconds
+    u32 global_ctx_expired_per_sec(void) const;
+
     u32 system_uptime_sec(void) const
     {
       return std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::system_clock::now() - m_system_start_time).count();
     }
 
+    static constexpr u32 ExpiredRateWindowSec = 10;
+
   private:
+    static u64 steady_sec(void)
+    {
+      return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     std::atomic<u64>  m_http_req_total_cnt;
     std::atomic<u64>  m_http_req_routed_cnt;
     std::atomic<u64>  m_http_req_unrouted_cnt;
@@ -85,6 +99,11 @@ class Counter
     std::atomic<u64>  m_upstrm_http_req_bytes_raw_cnt;
     std::atomic<u64>  m_upstrm_http_resp_bytes_raw_cnt;
 
+    std::atomic<u64>  m_global_ctx_expired_cnt;
+    std::atomic<u64>  m_expired_window_start;
+    std::atomic<u64>  m_expired_window_cnt;
+    std::atomic<u32>  m_expired_per_sec;
+
     const SysClockTimePoint m_system_start_time;
 };
 
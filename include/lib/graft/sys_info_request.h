@@ -58,6 +58,15 @@ GRAFT_DEFINE_IO_STRUCT_INITED(Running,
     (u64, upstrm_http_req_bytes_raw, 0),
     (u64, upstrm_http_resp_bytes_raw, 0),
 
+    (u64, global_ctx_expired, 0),
+    (u32, global_ctx_expired_per_sec, 0),
+
+    (u64, workers_active, 0),
+    (u64, workers_expelled, 0),
+    (u64, workers_blocked, 0),
+    (u64, workers_compensating, 0),
+    (u64, workers_compensated, 0),
+
     (u32, uptime_sec, 0)
 );
 
@@ -4,6 +4,8 @@
 #include "lib/graft/inout.h"
 #include "lib/graft/handler_api.h"
 #include "lib/graft/context.h"
+#include "lib/graft/fan_out.h"
+#include "lib/graft/lane_queue.h"
 #include "lib/graft/log.h"
 #include "lib/graft/self_holder.h"
 #include "lib/graft/serveropts.h"
@@ -13,12 +15,13 @@
 #include "misc_log_ex.h"
 #include <future>
 #include <deque>
+#include <mutex>
 
 #define LOG_PRINT_CLN(level,client,x) LOG_PRINT_L##level("[" << client_addr(client) << "] " << x)
 
 #define LOG_PRINT_RQS_BT(level,bt,x) \
 { \
-    ClientTask* cr = dynamic_cast<ClientTask*>(bt.get()); \
+    ClientTask* cr = dynamic_cast<ClientTask*>(&*(bt)); \
     if(cr) \
     { \
         LOG_PRINT_CLN(level,cr->m_client,x); \
@@ -47,7 +50,7 @@ class BaseTask;
 using BaseTaskPtr = std::shared_ptr<BaseTask>;
 
 class GJPtr;
-using TPResQueue = tp::MPMCBoundedQueue< GJPtr >;
+using TPResQueue = ResultChannels< GJPtr >;
 using GJ = GraftJob<BaseTaskPtr, TPResQueue, TaskManager>;
 
 //////////////
@@ -57,7 +60,7 @@ using GJ = GraftJob<BaseTaskPtr, TPResQueue, TaskManager>;
 ///
 class GJPtr final
 {
-    std::unique_ptr<GJ> m_ptr = nullptr;
+    std::unique_ptr<GJ, PoolDeleter<GJ>> m_ptr = nullptr;
 public:
     GJPtr(GJPtr&& rhs)
     {
@@ -76,7 +79,7 @@ public:
     ~GJPtr() = default;
 
     template<typename ...ARGS>
-    GJPtr(ARGS&&... args) : m_ptr( new GJ( std::forward<ARGS>(args)...) )
+    GJPtr(ARGS&&... args) : m_ptr( poolNew<GJ>( std::forward<ARGS>(args)...) )
     {
     }
 
@@ -116,18 +119,24 @@ public:
     const Router::vars_t& getVars() const { return m_params.vars; }
     Input& getInput() { return m_params.input; }
     Output& getOutput() { return m_output; }
-    const Router::Handler3& getHandler3() const { return m_params.h3; }
+    const Router::Handler3& getHandler3() const { return *m_params.h3; }
+    //the priority of the route, it selects the lanes of the task in the queues
+    virtual Priority getPriority() const { return m_params.h3->priority; }
     Context& getCtx() { return m_ctx; }
+    //the timer of the periodic run or of the postponed task expiration
+    TimingWheel::Handle& getTimer() { return m_timer; }
 
     const char* getStrStatus();
     static const char* getStrStatus(Status s);
 protected:
     BaseTask(TaskManager& manager, const Router::JobParams& prms);
+    BaseTask(TaskManager& manager, Router::JobParams&& prms);
 
     TaskManager& m_manager;
     Router::JobParams m_params;
     Output m_output;
     Context m_ctx;
+    TimingWheel::Handle m_timer;
 };
 
 class UpstreamTask : public BaseTask
@@ -140,13 +149,60 @@ public:
 private:
     friend class SelfHolder<BaseTask>;
     UpstreamTask(TaskManager& manager, PromiseItem&& pi)
-        : BaseTask(manager, Router::JobParams({Input(), Router::vars_t(),
-                Router::Handler3(nullptr, nullptr, nullptr)}))
+        : BaseTask(manager, Router::JobParams())
         , m_pi(std::move(pi))
     {
     }
 };
 
+//an upstream request of a fan-out, the answer is put to the fan-out of the parent task
+class FanOutTask : public BaseTask
+{
+public:
+    virtual void finalize() override;
+    virtual Priority getPriority() const override { return m_parent->getPriority(); }
+
+    BaseTaskPtr m_parent;
+    std::shared_ptr<FanOut::Round> m_round;
+    size_t m_index;
+private:
+    friend class SelfHolder<BaseTask>;
+    FanOutTask(TaskManager& manager, const BaseTaskPtr& parent, const std::shared_ptr<FanOut::Round>& round, size_t index)
+        : BaseTask(manager, Router::JobParams())
+        , m_parent(parent)
+        , m_round(round)
+        , m_index(index)
+    {
+        m_output = std::move(round->items[index].output);
+    }
+};
+
+//an upstream request of sendUpstreamAsync, the callback is the worker_action of the task
+class AsyncUpstreamTask : public BaseTask
+{
+public:
+    virtual void finalize() override;
+    //the error of the upstream, it is passed to the callback
+    std::string m_error;
+private:
+    friend class SelfHolder<BaseTask>;
+    AsyncUpstreamTask(TaskManager& manager, const Output& output, HandlerAPI::UpstreamCallback&& callback)
+        : BaseTask(manager, Router::JobParams({Input(), Router::vars_t(), &m_h3}))
+        , m_callback(std::move(callback))
+    {
+        m_output = output;
+        m_h3.worker_action = [this](const Router::vars_t&, const Input& input, Context&, Output&)->Status
+        {
+            m_callback(input, m_error);
+            return Status::Ok;
+        };
+    }
+
+    HandlerAPI::UpstreamCallback m_callback;
+    //the task has no route, it keeps its handlers
+    Router::Handler3 m_h3;
+};
+
 class PeriodicTask : public BaseTask
 {
     friend class SelfHolder<BaseTask>;
@@ -155,7 +211,8 @@ class PeriodicTask : public BaseTask
             std::chrono::milliseconds timeout_ms,
             std::chrono::milliseconds initial_timeout_ms,
             double random_factor = 0
-    ) : BaseTask(manager, Router::JobParams({Input(), Router::vars_t(), h3}))
+    ) : BaseTask(manager, Router::JobParams({Input(), Router::vars_t(), &m_h3}))
+      , m_h3(h3)
       , m_timeout_ms(timeout_ms), m_initial_timeout_ms(initial_timeout_ms)
       , m_random_factor(random_factor)
     {
@@ -167,6 +224,8 @@ class PeriodicTask : public BaseTask
     {
     }
 
+    //the task has no route, it keeps its handlers
+    Router::Handler3 m_h3;
     std::chrono::milliseconds m_timeout_ms;
     std::chrono::milliseconds m_initial_timeout_ms;
     double m_random_factor;
@@ -180,23 +239,25 @@ public:
 class ClientTask : public BaseTask
 {
     friend class SelfHolder<BaseTask>;
-    ClientTask(ConnectionManager* connectionManager, mg_connection *client, Router::JobParams& prms);
+    ClientTask(ConnectionManager* connectionManager, mg_connection *client, Router::JobParams&& prms);
 public:
     virtual void finalize() override;
 
     mg_connection *m_client;
     ConnectionManager* m_connectionManager;
+    //the client connection is kept open after the response
+    bool m_keepAlive = false;
 };
 
 
-class StateMachine;
-class ExpiringList;
+class PostponeDirectory;
 class UpstreamManager;
 
 class TaskManager : private HandlerAPI
 {
 public:
-    TaskManager(const ConfigOpts& copts, SysInfoCounter& sysInfoCounter);
+    //a secondary TaskManager shares the global context and the thread pool of the primary one
+    TaskManager(const ConfigOpts& copts, SysInfoCounter& sysInfoCounter, TaskManager* primary = nullptr);
     virtual ~TaskManager();
     TaskManager(const TaskManager&) = delete;
     TaskManager& operator = (const TaskManager&) = delete;
@@ -209,9 +270,9 @@ public:
 
     ////getters
     virtual mg_mgr* getMgMgr()  = 0;
-    GlobalContextMap& getGcm() { return m_gcm; }
+    GlobalContextMap& getGcm() { return *m_gcm; }
     ConfigOpts& getCopts() { return m_copts; }
-    TimerList<BaseTaskPtr>& getTimerList() { return m_timerList; }
+    TimingWheel& getTimers() { return m_timers; }
     ThreadPoolX& getThreadPool() { return *m_threadPool; }
 
     ////events
@@ -224,12 +285,14 @@ public:
 
     //HandlerAPI implementation
     virtual void sendUpstreamBlocking(Output& output, Input& input, std::string& err) override;
+    virtual void sendUpstreamAsync(const Output& output, UpstreamCallback callback) override;
     virtual bool addPeriodicTask(const Router::Handler& h_worker,
                                  std::chrono::milliseconds interval_ms,
                                  std::chrono::milliseconds initial_interval_ms = std::chrono::milliseconds::max(),
                                  double random_factor = 0 ) override;
     virtual request::system_info::Counter& runtimeSysInfo() override;
     virtual const ConfigOpts& configOpts() const override;
+    virtual ServiceRegistry& services() override;
 
     //
     void runWorkerActionFromTheThreadPool(BaseTaskPtr bt);
@@ -238,6 +301,9 @@ public:
 
     void cb_event(uint64_t cnt);
 
+    //can be called from any thread, the task with the uuid is resumed if it is postponed by this TaskManager
+    void resumePostponedTask(const Context::uuid_t& uuid, const Input& input);
+
     void getThreadPoolInfo(uint64_t& activeWorkers, uint64_t& expelledWorkers) const;
 protected:
     bool canStop();
@@ -245,29 +311,44 @@ protected:
     void expelWorkers();
     void setIOThread(bool current);
     void checkUpstreamBlockingIO();
+    void checkUpstreamAsyncIO();
     void checkPeriodicTaskIO();
+    void checkForeignResumeIO();
+    bool isPrimary() const { return !m_primary; }
+    //time in ms until the earliest timer, not greater than timer_poll_interval_ms
+    int pollTimeout() const;
 
     ConfigOpts m_copts;
 private:
     void Execute(BaseTaskPtr bt);
     void processForward(BaseTaskPtr bt);
+    void sendFanOut(BaseTaskPtr bt);
+    void joinFanOut(const BaseTaskPtr& bt, const std::shared_ptr<FanOut::Round>& round);
     void processOk(BaseTaskPtr bt);
-    void respondAndDie(BaseTaskPtr bt, const std::string& s, bool die = true);
+    void respondAndDie(BaseTaskPtr bt, std::string s, bool die = true);
+    std::string takeResponse(BaseTaskPtr bt);
     void postponeTask(BaseTaskPtr bt);
+    void expirePostponed(const Context::uuid_t& uuid);
+    //the task is resumed by the TaskManager that has postponed it
+    bool resumePostponed(const Context::uuid_t& uuid, const Input& input);
+    bool resumeOwnPostponed(const Context::uuid_t& uuid, const Input& input);
     void upstreamDoneProcess(UpstreamSender& uss);
 
-    void checkThreadPoolOverflow(BaseTaskPtr bt);
-    void runPreAction(BaseTaskPtr bt);
-    void runWorkerAction(BaseTaskPtr bt);
-    void runPostAction(BaseTaskPtr bt);
+    void checkThreadPoolOverflow(BaseTask& bt);
+    void runPreAction(BaseTask& bt);
+    void runWorkerAction(BaseTask& bt);
+    void runPostAction(BaseTask& bt);
 
     void initThreadPool(int threadCount = std::thread::hardware_concurrency(), int workersQueueSize = 32, int expellingIntervalMs = 2000);
-    bool tryProcessReadyJob();
+    void processReadyJob(GJPtr& gj);
 
     static inline size_t next_pow2(size_t val);
 
     SysInfoCounter& m_sysInfoCounter;
-    GlobalContextMap m_gcm;
+    TaskManager* m_primary;
+    std::shared_ptr<GlobalContextMap> m_gcm;
+    //tasks, upstream senders and jobs created by the IO thread, it is deleted when all of them are freed
+    SlabPool* m_pool;
 
     uint64_t m_cntBaseTask = 0;
     uint64_t m_cntBaseTaskDone = 0;
@@ -276,16 +357,26 @@ private:
     uint64_t m_cntJobDone = 0;
 
     uint64_t m_threadPoolInputSize = 0;
-    std::unique_ptr<ThreadPoolX> m_threadPool;
+    std::shared_ptr<ThreadPoolX> m_threadPool;
     std::unique_ptr<TPResQueue> m_resQueue;
-    TimerList<BaseTaskPtr> m_timerList;
+    TimingWheel m_timers;
 
     std::map<Context::uuid_t, BaseTaskPtr> m_postponedTasks;
-    std::deque<BaseTaskPtr> m_readyToResume;
-    std::priority_queue<std::pair<std::chrono::time_point<std::chrono::steady_clock>,Context::uuid_t>> m_expireTaskQueue;
-    std::unique_ptr<ExpiringList> m_futurePostponeUuids;
+    LaneQueue<BaseTaskPtr> m_readyToResume;
+    //the callbacks of sendUpstreamAsync that have met the thread pool overflow, one is posted per done job
+    LaneQueue<BaseTaskPtr> m_waitingForPool;
+    //it is shared with the primary TaskManager
+    std::shared_ptr<PostponeDirectory> m_postponeDirectory;
     std::unique_ptr<UpstreamManager> m_upstreamManager;
 
+    std::mutex m_foreignResumeMutex;
+    std::deque<std::pair<Context::uuid_t, Input>> m_foreignResume;
+
+    //the requests of sendUpstreamAsync from the threads other than the IO one, the queue is not bounded
+    //as the requests do not block the callers
+    std::mutex m_upstreamAsyncMutex;
+    std::deque<std::pair<Output, UpstreamCallback>> m_upstreamAsync;
+
     using PromiseItem = UpstreamTask::PromiseItem;
     using PromiseQueue = tp::MPMCBoundedQueue<PromiseItem>;
 
@@ -294,10 +385,10 @@ private:
 
     std::unique_ptr<PromiseQueue> m_promiseQueue;
     std::unique_ptr<PeriodicTaskQueue> m_periodicTaskQueue;
-    static thread_local bool io_thread;
+    //the TaskManager whose IO loop runs on the current thread
+    static thread_local TaskManager* io_manager;
 
     friend class StateMachine;
-    std::unique_ptr<StateMachine> m_stateMachine;
 };
 
 }//namespace graft
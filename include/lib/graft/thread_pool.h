@@ -1,9 +1,87 @@
 #pragma once
 
 #include "lib/graft/thread_pool/thread_pool.hpp"
+#include "lib/graft/thread_pool/spsc_bounded_queue.hpp"
 
 namespace graft {
 
+////////
+///
+/// results of jobs going from the thread pool workers to an IO thread
+/// each worker has its own SPSC ring, the IO thread drains them round-robin
+///
+template <typename T>
+class ResultChannels
+{
+public:
+    //each ring should be able to hold all jobs in flight, any worker can run all of them
+    ResultChannels(size_t channels, size_t size)
+    {
+        m_channels.reserve(channels);
+        for(size_t i = 0; i < channels; ++i)
+        {
+            m_channels.emplace_back(std::make_unique<Channel>(size));
+        }
+    }
+
+    ResultChannels(const ResultChannels&) = delete;
+    ResultChannels& operator = (const ResultChannels&) = delete;
+
+    //called from a worker, returns true if the consumer should be notified,
+    //that is once per batch of results the consumer has not started to drain
+    bool push(T&& value)
+    {
+        Channel& ch = *m_channels[tp::currentWorkerId() % m_channels.size()];
+        {
+            //the lock is not contended unless an expelled worker and its replacement
+            //finish jobs at once, or the thread is not a worker of the pool
+            while(ch.busy.exchange(true, std::memory_order_acquire)) tp::cpuRelax();
+            bool ok = ch.ring.push(std::move(value));
+            ch.busy.store(false, std::memory_order_release);
+            assert(ok); (void)ok;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return !m_notified.exchange(true, std::memory_order_seq_cst);
+    }
+
+    //called from the consumer, f is called for each result, returns the number of results
+    template <typename F>
+    size_t drain(F&& f)
+    {
+        //the results pushed after the reset will be notified again
+        m_notified.store(false, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        size_t cnt = 0;
+        size_t n = m_channels.size();
+        for(bool found = true; found; )
+        {
+            found = false;
+            for(size_t i = 0; i < n; ++i, m_next = (m_next + 1) % n)
+            {
+                T value;
+                if(!m_channels[m_next]->ring.pop(value)) continue;
+                found = true;
+                ++cnt;
+                f(value);
+            }
+        }
+        return cnt;
+    }
+
+private:
+    struct Channel
+    {
+        explicit Channel(size_t size) : ring(size) { }
+        tp::SPSCBoundedQueue<T> ring;
+        std::atomic<bool> busy{false};
+    };
+
+    std::vector<std::unique_ptr<Channel>> m_channels;
+    std::atomic<bool> m_notified{false};
+    size_t m_next = 0;
+};
+
 ////////
 ///
 /// prototype of a job
@@ -44,8 +122,8 @@ public:
         m_bt->getManager().runWorkerActionFromTheThreadPool(m_bt);
 
         Watcher* save_m_watcher = m_watcher; //save m_watcher before move itself into resulting queue
-        m_rq->push(std::move(*this)); //similar to "delete this;"
-        save_m_watcher->notifyJobReady();
+        bool notify = m_rq->push(std::move(*this)); //similar to "delete this;"
+        if(notify) save_m_watcher->notifyJobReady();
     }
 
     BT_ptr& getTask() { return m_bt; }
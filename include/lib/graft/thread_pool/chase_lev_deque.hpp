@@ -0,0 +1,248 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace tp
+{
+
+/**
+ * @brief The ChaseLevDeque class implements bounded work-stealing deque.
+ * The owner thread pushes and pops at the bottom, other threads steal from
+ * the top. Elements are read by stealers concurrently with the owner writes,
+ * so T should be trivially copyable, it is the index of a task cell usually,
+ * see TaskDeque.
+ * Based on "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * by N. M. Le, A. Pop, A. Cohen, F. Z. Nardelli.
+ */
+template <typename T>
+class ChaseLevDeque
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Should be of trivially copyable type");
+
+public:
+    /**
+     * @brief ChaseLevDeque Constructor.
+     * @param size Power of 2 number - deque capacity.
+     * @throws std::invalid_argument if size is bad.
+     */
+    explicit ChaseLevDeque(size_t size);
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    /**
+     * @brief push Push data to the bottom. Called by the owner only.
+     * @return false if the deque is full.
+     */
+    bool push(T data);
+
+    /**
+     * @brief pop Pop data from the bottom. Called by the owner only.
+     * @return true on success.
+     */
+    bool pop(T& data);
+
+    /**
+     * @brief steal Take data from the top. Can be called by any thread.
+     * @return true on success, false if the deque is empty or another thread
+     * has taken the element.
+     */
+    bool steal(T& data);
+
+    /**
+     * @brief size Approximate number of elements.
+     */
+    size_t size() const;
+
+    size_t capacity() const { return m_mask + 1; }
+
+    /**
+     * @brief bottom The position of the next push. Called by the owner only.
+     */
+    int64_t bottom() const { return m_bottom.load(std::memory_order_relaxed); }
+
+private:
+    typedef char Cacheline[64];
+
+    std::unique_ptr<std::atomic<T>[]> m_buffer;
+    size_t m_mask;
+    Cacheline pad0;
+    std::atomic<int64_t> m_top{0};
+    Cacheline pad1;
+    std::atomic<int64_t> m_bottom{0};
+    Cacheline pad2;
+};
+
+
+/// Implementation
+
+template <typename T>
+inline ChaseLevDeque<T>::ChaseLevDeque(size_t size)
+    : m_buffer(new std::atomic<T>[size]), m_mask(size - 1)
+{
+    bool size_is_power_of_2 = (size >= 2) && ((size & (size - 1)) == 0);
+    if(!size_is_power_of_2)
+    {
+        throw std::invalid_argument("buffer size should be a power of 2");
+    }
+}
+
+template <typename T>
+inline bool ChaseLevDeque<T>::push(T data)
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    if(b - t > static_cast<int64_t>(m_mask)) return false;
+
+    m_buffer[b & m_mask].store(data, std::memory_order_relaxed);
+    //publishes the element and the task it points to for stealers
+    m_bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline bool ChaseLevDeque<T>::pop(T& data)
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+
+    if(b < t)
+    {//empty
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    data = m_buffer[b & m_mask].load(std::memory_order_relaxed);
+    if(t < b) return true;
+
+    //the last element, race with stealers
+    bool ok = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+    return ok;
+}
+
+template <typename T>
+inline bool ChaseLevDeque<T>::steal(T& data)
+{
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+    if(b <= t) return false;
+
+    data = m_buffer[t & m_mask].load(std::memory_order_relaxed);
+    return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline size_t ChaseLevDeque<T>::size() const
+{
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    return (t < b)? b - t : 0;
+}
+
+
+/**
+ * @brief The TaskDeque class is a work-stealing deque of tasks that keeps
+ * them in a fixed ring of cells, so no memory is allocated per task. The cell
+ * of an element is chosen by its position in the ChaseLevDeque that holds the
+ * cell indices. A stealer moves the task out after it has taken the index and
+ * then frees the cell; the owner does not reuse a cell that is not freed yet.
+ */
+template <typename Task>
+class TaskDeque
+{
+public:
+    /**
+     * @brief TaskDeque Constructor.
+     * @param size Power of 2 number - deque capacity.
+     * @throws std::invalid_argument if size is bad.
+     */
+    explicit TaskDeque(size_t size) : m_indices(size), m_cells(new Cell[size]) { }
+
+    TaskDeque(const TaskDeque&) = delete;
+    TaskDeque& operator=(const TaskDeque&) = delete;
+
+    /**
+     * @brief canPush Check if push() succeeds. Called by the owner only.
+     */
+    bool canPush() const
+    {
+        return m_indices.size() < capacity() && !cellAt(m_indices.bottom()).busy.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief push Move the task to the bottom. Called by the owner only.
+     * @return false if the deque is full.
+     */
+    bool push(Task&& task)
+    {
+        if (!canPush()) return false;
+        uint32_t idx = m_indices.bottom() & (capacity() - 1);
+        Cell& cell = m_cells[idx];
+        cell.task = std::move(task);
+        cell.busy.store(true, std::memory_order_relaxed);
+        //publishes the task for stealers
+        bool ok = m_indices.push(idx);
+        assert(ok);
+        return ok;
+    }
+
+    /**
+     * @brief pop Move the task out from the bottom. Called by the owner only.
+     * @return true on success.
+     */
+    bool pop(Task& task)
+    {
+        uint32_t idx;
+        if (!m_indices.pop(idx)) return false;
+        Cell& cell = m_cells[idx];
+        task = std::move(cell.task);
+        cell.busy.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief steal Move the task out from the top. Can be called by any thread.
+     * @return true on success.
+     */
+    bool steal(Task& task)
+    {
+        uint32_t idx;
+        if (!m_indices.steal(idx)) return false;
+        Cell& cell = m_cells[idx];
+        task = std::move(cell.task);
+        //the owner can reuse the cell
+        cell.busy.store(false, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief size Approximate number of elements.
+     */
+    size_t size() const { return m_indices.size(); }
+
+    size_t capacity() const { return m_indices.capacity(); }
+
+private:
+    struct Cell
+    {
+        Task task;
+        //set from the push until the task is moved out
+        std::atomic<bool> busy{false};
+    };
+
+    const Cell& cellAt(int64_t pos) const { return m_cells[pos & (capacity() - 1)]; }
+
+    ChaseLevDeque<uint32_t> m_indices;
+    std::unique_ptr<Cell[]> m_cells;
+};
+
+}
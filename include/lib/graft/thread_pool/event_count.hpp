@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace tp
+{
+
+/**
+ * @brief cpuRelax Hint to the processor that the thread is spinning.
+ */
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * @brief The EventCount class lets a thread sleep until a condition it checks
+ * without locks becomes true, and lets another thread wake it after making the
+ * condition true, without lost wakeups.
+ * A waiter calls prepareWait(), checks the condition again and then calls
+ * either cancelWait() if it is true or wait() otherwise. A notifier makes the
+ * condition true and calls notify(), that costs an atomic load only if nobody
+ * waits.
+ * On Linux it is based on futex, otherwise on a condition variable.
+ */
+class EventCount
+{
+public:
+    using Key = uint32_t;
+
+    EventCount() = default;
+    EventCount(const EventCount&) = delete;
+    EventCount& operator=(const EventCount&) = delete;
+
+    Key prepareWait() noexcept
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancelWait() noexcept
+    {
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void wait(Key key) noexcept
+    {
+        while (m_epoch.load(std::memory_order_seq_cst) == key)
+        {
+            sleep(key);
+        }
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief notify Wake one waiter.
+     * @return 'true' if there was a waiter.
+     */
+    bool notify() noexcept
+    {
+        return notifyImpl(1);
+    }
+
+    void notifyAll() noexcept
+    {
+        notifyImpl(INT32_MAX);
+    }
+
+private:
+    bool notifyImpl(int count) noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_seq_cst) == 0) return false;
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        wake(count);
+        return true;
+    }
+
+#ifdef __linux__
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+    void sleep(Key key) noexcept
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+    }
+
+    void wake(int count) noexcept
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+#else
+    void sleep(Key key) noexcept
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        m_cv.wait(lk, [this, key]{ return m_epoch.load() != key; });
+    }
+
+    void wake(int count) noexcept
+    {
+        //the lock orders the epoch change with the check of the sleeping thread
+        { std::lock_guard<std::mutex> lk(m_mutex); }
+        if (count == 1) m_cv.notify_one();
+        else m_cv.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+#endif
+
+    std::atomic<uint32_t> m_epoch{0};
+    std::atomic<uint32_t> m_waiters{0};
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace tp
+{
+
+/**
+ * @brief The lanes of the queues of the pool, in the order of priority.
+ */
+enum Lane : size_t
+{
+    HighLane,
+    NormalLane,
+    BulkLane,
+};
+
+constexpr size_t LaneCount = 3;
+
+/**
+ * @brief LaneWeights The shares of the lanes when all of them have tasks.
+ */
+using LaneWeights = std::array<uint32_t, LaneCount>;
+
+inline constexpr LaneWeights defaultLaneWeights()
+{
+    return LaneWeights{{8, 3, 1}};
+}
+
+/**
+ * @brief The LaneScheduler class chooses the lane to take the next task from
+ * by smooth weighted round-robin, so the lanes are interleaved in the
+ * proportion of their weights and no lane with a non-zero weight starves.
+ * If the chosen lane is empty the others are tried in the order of priority.
+ * It is not thread safe, each consumer has its own one.
+ */
+class LaneScheduler
+{
+public:
+    explicit LaneScheduler(const LaneWeights& weights = defaultLaneWeights()) : m_weights(weights)
+    {
+        for (uint32_t w : m_weights) m_total += w;
+    }
+
+    /**
+     * @brief next Return the lane of the next turn.
+     */
+    size_t next()
+    {
+        if (!m_total) return HighLane;
+        size_t best = 0;
+        for (size_t i = 0; i < LaneCount; ++i)
+        {
+            m_current[i] += m_weights[i];
+            if (m_current[best] < m_current[i]) best = i;
+        }
+        m_current[best] -= m_total;
+        return best;
+    }
+
+    /**
+     * @brief pick Call take(lane) for the lane of the next turn and then for
+     * the rest of the lanes until it returns 'true'.
+     * @return 'true' if a task is taken.
+     */
+    template <typename Take>
+    bool pick(Take&& take)
+    {
+        size_t turn = next();
+        if (take(turn)) return true;
+        for (size_t i = 0; i < LaneCount; ++i)
+        {
+            if (i != turn && take(i)) return true;
+        }
+        return false;
+    }
+
+private:
+    LaneWeights m_weights;
+    int64_t m_total = 0;
+    std::array<int64_t, LaneCount> m_current{};
+};
+
+}
@@ -90,6 +90,12 @@ public:
      */
     bool pop(T& data);
 
+    /**
+     * @brief size Approximate number of elements in queue.
+     * It is exact only if there are no concurrent pushes and pops.
+     */
+    size_t size() const;
+
 private:
     struct Cell
     {
@@ -239,4 +245,12 @@ inline bool MPMCBoundedQueue<T>::pop(T& data)
     return true;
 }
 
+template <typename T>
+inline size_t MPMCBoundedQueue<T>::size() const
+{
+    size_t dequeue_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    size_t enqueue_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    return (enqueue_pos > dequeue_pos)? enqueue_pos - dequeue_pos : 0;
+}
+
 }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace tp
+{
+
+/**
+ * @brief The SPSCBoundedQueue class implements bounded
+ * single-producer/single-consumer lock-free ring.
+ * Each side keeps a cached copy of the index of the other side, so the
+ * shared index is read only when the ring looks full or empty.
+ */
+template <typename T>
+class SPSCBoundedQueue
+{
+    static_assert(
+        std::is_move_constructible<T>::value, "Should be of movable type");
+
+public:
+    /**
+     * @brief SPSCBoundedQueue Constructor.
+     * @param size Power of 2 number - queue length.
+     * @throws std::invalid_argument if size is bad.
+     */
+    explicit SPSCBoundedQueue(size_t size);
+
+    SPSCBoundedQueue(const SPSCBoundedQueue&) = delete;
+    SPSCBoundedQueue& operator=(const SPSCBoundedQueue&) = delete;
+
+    /**
+     * @brief push Push data to queue. Called by the producer only.
+     * @param data Data to be pushed.
+     * @return true on success, false if the queue is full.
+     */
+    template <typename U>
+    bool push(U&& data);
+
+    /**
+     * @brief pop Pop data from queue. Called by the consumer only.
+     * @param data Place to store popped data.
+     * @return true on success, false if the queue is empty.
+     */
+    bool pop(T& data);
+
+private:
+    typedef char Cacheline[64];
+
+    std::unique_ptr<T[]> m_buffer;
+    const size_t m_mask;
+    Cacheline pad0;
+    //written by the producer
+    std::atomic<size_t> m_tail{0};
+    size_t m_headCache = 0;
+    Cacheline pad1;
+    //written by the consumer
+    std::atomic<size_t> m_head{0};
+    size_t m_tailCache = 0;
+    Cacheline pad2;
+};
+
+
+/// Implementation
+
+template <typename T>
+inline SPSCBoundedQueue<T>::SPSCBoundedQueue(size_t size)
+    : m_buffer(new T[size]), m_mask(size - 1)
+{
+    bool size_is_power_of_2 = (size >= 2) && ((size & (size - 1)) == 0);
+    if(!size_is_power_of_2)
+    {
+        throw std::invalid_argument("buffer size should be a power of 2");
+    }
+}
+
+template <typename T>
+template <typename U>
+inline bool SPSCBoundedQueue<T>::push(U&& data)
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if(tail - m_headCache > m_mask)
+    {
+        m_headCache = m_head.load(std::memory_order_acquire);
+        if(tail - m_headCache > m_mask) return false;
+    }
+    m_buffer[tail & m_mask] = std::forward<U>(data);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline bool SPSCBoundedQueue<T>::pop(T& data)
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if(head == m_tailCache)
+    {
+        m_tailCache = m_tail.load(std::memory_order_acquire);
+        if(head == m_tailCache) return false;
+    }
+    data = std::move(m_buffer[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+}
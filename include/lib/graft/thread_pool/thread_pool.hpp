@@ -58,11 +58,12 @@ public:
      * @brief post Try post job to thread pool.
      * @param handler Handler to be called from thread pool worker. It has
      * to be callable as 'handler()'.
+     * @param lane The lane of the job, one of tp::Lane.
      * @return 'true' on success, false otherwise.
      * @note All exceptions thrown by handler will be suppressed.
      */
     template <typename Handler>
-    bool tryPost(Handler&& handler);
+    bool tryPost(Handler&& handler, size_t lane = NormalLane);
 
     /**
      * @brief post Post job to thread pool.
@@ -71,11 +72,12 @@ public:
      * @param to_any_queue If true, attempts to post into each worker queue
      * until success. Throws the exception otherwise. If false only one
      * attempt will be made.
+     * @param lane The lane of the job, one of tp::Lane.
      * @throw std::overflow_error if worker's queue is full.
      * @note All exceptions thrown by handler will be suppressed.
      */
     template <typename Handler>
-    void post(Handler&& handler, bool to_any_queue = false);
+    void post(Handler&& handler, bool to_any_queue = false, size_t lane = NormalLane);
 
     int dump_info()
     {
@@ -89,22 +91,61 @@ public:
         return cnt;
     }
 
-    //it is for a single thread
+    //it is for a single thread, the workers in blocking regions are not expelled
     void expelWorkers();
 
     static uint64_t getActiveWorkersCount();
     static uint64_t getExpelledWorkersCount();
+    //the threads in blocking regions now
+    static uint64_t getBlockedWorkersCount();
+    //the compensation workers running now and started in total
+    static uint64_t getCompensatingWorkersCount();
+    static uint64_t getCompensatedCount();
+    //the retired compensation workers of the pool parked to be reused
+    uint64_t getSpareWorkersCount() const;
 
 private:
     size_t getWorkerIdx();
 
     using Worker = WorkerT<Task, Queue>;
     using TimePoint = typename Worker::TimePoint;
-    using QueuesVec = std::vector<Queue<Task>>;
+    using SlotsVec = typename Worker::SlotsVec;
     using WorkersVec = std::vector<std::shared_ptr<Worker>>;
 
-    std::unique_ptr<std::vector<Queue<Task>>> m_queues;
+    /**
+     * @brief The Compensator class runs a compensation worker on the slot of
+     * a worker in a blocking region when the slot has queued tasks, while the
+     * number of them is below the limit. A parked spare is woken for it, a new
+     * thread is started only if there is no spare. The compensation workers
+     * retire by themselves when there are more of them on the slot than
+     * blocked threads, and park as spares.
+     */
+    class Compensator : public BlockingObserver
+    {
+    public:
+        Compensator(SlotsVec& slots, PoolState& pool, size_t maxCount) : m_slots(slots), m_pool(pool), m_maxCount(maxCount) { }
+
+        virtual void blockingBegin(size_t id) override;
+        virtual void blockingEnd(size_t id) override;
+
+        /**
+         * @brief compensate Run a compensation worker on the slot if it has
+         * more blocked threads than compensation workers.
+         */
+        void compensate(size_t id);
+
+        size_t count() const { return m_count; }
+    private:
+        SlotsVec& m_slots;
+        PoolState& m_pool;
+        const size_t m_maxCount;
+        std::atomic<size_t> m_count{0};
+    };
+
+    std::unique_ptr<SlotsVec> m_slots;
+    std::unique_ptr<PoolState> m_pool;
     std::unique_ptr<std::vector<std::shared_ptr<Worker>>> m_workers;
+    std::unique_ptr<Compensator> m_compensator;
 
     std::atomic<size_t> m_next_worker = 0;
 };
@@ -119,35 +160,93 @@ inline ThreadPoolImpl<Task, Queue>::ThreadPoolImpl(
     using Milliseconds = typename Worker::Milliseconds;
     Worker::defaultPeriodMs = Milliseconds(options.expellingIntervalMs());
 
-    m_queues = std::make_unique<QueuesVec>();
-    m_queues->reserve(options.threadCount());
+    m_slots = std::make_unique<SlotsVec>();
+    m_slots->reserve(options.threadCount());
+    //a few retired compensation workers are kept to be reused
+    m_pool = std::make_unique<PoolState>(options.laneWeights(), std::min<size_t>(options.maxCompensationThreads(), 2));
     m_workers = std::make_unique<WorkersVec>();
     m_workers->reserve(options.threadCount());
 
-    QueuesVec& queues = *m_queues;
+    SlotsVec& slots = *m_slots;
     WorkersVec& workers = *m_workers;
+    m_compensator = std::make_unique<Compensator>(slots, *m_pool, options.maxCompensationThreads());
 
     for(size_t i = 0; i < options.threadCount(); ++i)
     {
-        queues.emplace_back(Queue<Task>(options.queueSize()));
+        slots.emplace_back(std::make_unique<WorkerSlot<Task, Queue>>(options.queueSize()));
         workers.emplace_back(std::make_shared<Worker>());
     }
 
     for(size_t i = 0; i < workers.size(); ++i)
     {
-        size_t i1 = (i + 1) % workers.size();
         std::shared_ptr wrkr(workers[i]);
-        workers[i]->start(i, queues[i], queues[i1], std::move(wrkr));
+        workers[i]->start(i, slots, *m_pool, std::move(wrkr), m_compensator.get());
     }
 }
 
+template <typename Task, template<typename> class Queue>
+inline void ThreadPoolImpl<Task, Queue>::Compensator::blockingBegin(size_t id)
+{
+    ++Worker::blockedCount;
+    auto& slot = *m_slots[id];
+    slot.blocked.fetch_add(1, std::memory_order_seq_cst);
+    //pairs with the check in tryPost, a task posted later starts the compensation there
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(slot.hasTasks()) compensate(id);
+}
+
+template <typename Task, template<typename> class Queue>
+inline void ThreadPoolImpl<Task, Queue>::Compensator::compensate(size_t id)
+{
+    auto& slot = *m_slots[id];
+    size_t cnt = m_count.load();
+    do
+    {
+        if(m_maxCount <= cnt) return;
+    } while(!m_count.compare_exchange_weak(cnt, cnt + 1));
+
+    uint32_t c = slot.compensating.load(std::memory_order_seq_cst);
+    do
+    {
+        if(slot.blocked.load(std::memory_order_seq_cst) <= c)
+        {
+            --m_count;
+            return;
+        }
+    } while(!slot.compensating.compare_exchange_weak(c, c + 1, std::memory_order_seq_cst));
+    ++Worker::compensatingCount;
+
+    ++Worker::activeCount;
+    if(m_pool.wakeSpare(id)) return;
+    //the new worker is counted by start()
+    --Worker::activeCount;
+    ++Worker::compensatedCount;
+
+    std::shared_ptr<Worker> cworker = std::make_shared<Worker>();
+    cworker->m_compensations = &m_count;
+    std::shared_ptr wrkr(cworker);
+    cworker->start(id, m_slots, m_pool, std::move(wrkr), this);
+    //the worker keeps itself until it retires
+    cworker->m_thread.detach();
+}
+
+template <typename Task, template<typename> class Queue>
+inline void ThreadPoolImpl<Task, Queue>::Compensator::blockingEnd(size_t id)
+{
+    --Worker::blockedCount;
+    auto& slot = *m_slots[id];
+    slot.blocked.fetch_sub(1, std::memory_order_seq_cst);
+    //a parked compensation worker should retire
+    if(slot.blocked.load() < slot.compensating.load()) slot.events.notifyAll();
+}
+
 //this function should be called by a single thread per ThreadPool only
 template <typename Task, template<typename> class Queue>
 inline void ThreadPoolImpl<Task, Queue>::expelWorkers()
 {
     TimePoint now = Worker::getTimePoint();
 
-    QueuesVec& queues = *m_queues;
+    SlotsVec& slots = *m_slots;
     WorkersVec& workers = *m_workers;
 
     for(size_t i = 0; i < workers.size(); ++i)
@@ -159,8 +258,7 @@ inline void ThreadPoolImpl<Task, Queue>::expelWorkers()
 
         std::shared_ptr<Worker> nworker = std::make_shared<Worker>();
         workers[i] = nworker;
-        size_t i1 = (i + 1) % workers.size();
-        workers[i]->start(i, queues[i], queues[i1], std::move(nworker));
+        workers[i]->start(i, slots, *m_pool, std::move(nworker), m_compensator.get());
 
         ++Worker::expelledCount;
     }
@@ -178,6 +276,30 @@ inline uint64_t ThreadPoolImpl<Task, Queue>::getExpelledWorkersCount()
     return Worker::expelledCount;
 }
 
+template <typename Task, template<typename> class Queue>
+inline uint64_t ThreadPoolImpl<Task, Queue>::getBlockedWorkersCount()
+{
+    return Worker::blockedCount;
+}
+
+template <typename Task, template<typename> class Queue>
+inline uint64_t ThreadPoolImpl<Task, Queue>::getCompensatingWorkersCount()
+{
+    return Worker::compensatingCount;
+}
+
+template <typename Task, template<typename> class Queue>
+inline uint64_t ThreadPoolImpl<Task, Queue>::getCompensatedCount()
+{
+    return Worker::compensatedCount;
+}
+
+template <typename Task, template<typename> class Queue>
+inline uint64_t ThreadPoolImpl<Task, Queue>::getSpareWorkersCount() const
+{
+    return m_pool->spareCount();
+}
+
 template <typename Task, template<typename> class Queue>
 inline ThreadPoolImpl<Task, Queue>::ThreadPoolImpl(ThreadPoolImpl<Task, Queue>&& rhs) noexcept
 {
@@ -194,12 +316,19 @@ inline ThreadPoolImpl<Task, Queue>::~ThreadPoolImpl()
     {
         worker_ptr->stop();
     }
+    //the compensation workers retire when no thread is blocked
+    for (auto& slot : *m_slots)
+    {
+        slot->events.notifyAll();
+    }
 
     while(Worker::activeCount)
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
     assert((Worker::activeCount == 0));
+    //the retired compensation workers are registered as spares before they stop being active
+    m_pool->stopSpares();
 }
 
 template <typename Task, template<typename> class Queue>
@@ -208,8 +337,10 @@ ThreadPoolImpl<Task, Queue>::operator=(ThreadPoolImpl<Task, Queue>&& rhs) noexce
 {
     if (this != &rhs)
     {
-        m_queues = std::move(rhs.m_queues);
+        m_slots = std::move(rhs.m_slots);
+        m_pool = std::move(rhs.m_pool);
         m_workers = std::move(rhs.m_workers);
+        m_compensator = std::move(rhs.m_compensator);
         m_next_worker = rhs.m_next_worker.load();
     }
     return *this;
@@ -217,19 +348,30 @@ ThreadPoolImpl<Task, Queue>::operator=(ThreadPoolImpl<Task, Queue>&& rhs) noexce
 
 template <typename Task, template<typename> class Queue>
 template <typename Handler>
-inline bool ThreadPoolImpl<Task, Queue>::tryPost(Handler&& handler)
+inline bool ThreadPoolImpl<Task, Queue>::tryPost(Handler&& handler, size_t lane)
 {
-    return (*m_queues)[getWorkerIdx()].push(std::forward<Handler>(handler));
+    assert(lane < LaneCount);
+    size_t idx = getWorkerIdx();
+    auto& slot = *(*m_slots)[idx];
+    if(!slot.queues[lane].push(std::forward<Handler>(handler))) return false;
+    //if the owner of the queue is busy, any parked worker can steal the task
+    notifyAny(*m_pool, *m_slots, idx);
+    //if the owner is in a blocking region, a compensation worker runs the task; notifyAny has made a fence
+    if(slot.compensating.load(std::memory_order_seq_cst) < slot.blocked.load(std::memory_order_seq_cst) && slot.hasTasks())
+    {
+        m_compensator->compensate(idx);
+    }
+    return true;
 }
 
 template <typename Task, template<typename> class Queue>
 template <typename Handler>
-inline void ThreadPoolImpl<Task, Queue>::post(Handler&& handler, bool to_any_queue)
+inline void ThreadPoolImpl<Task, Queue>::post(Handler&& handler, bool to_any_queue, size_t lane)
 {
     int try_count = (to_any_queue)? m_workers->size() : 1;
     for(int i = 0; i < try_count; ++i)
     {
-        bool ok = tryPost(std::forward<Handler>(handler));
+        bool ok = tryPost(std::forward<Handler>(handler), lane);
         if(ok) return;
     }
     throw std::runtime_error("thread pool queue is full");
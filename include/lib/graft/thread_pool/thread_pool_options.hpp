@@ -1,5 +1,7 @@
 #pragma once
 
+#include "lib/graft/thread_pool/lanes.hpp"
+
 #include <algorithm>
 #include <thread>
 
@@ -51,10 +53,34 @@ public:
      */
     size_t expellingIntervalMs() const { return m_workers_expelling_interval_ms; }
 
+    /**
+     * @brief setMaxCompensationThreads Set maximal number of threads started for the workers in blocking regions.
+     * @param count Number of threads, 0 disables the compensation.
+     */
+    void setMaxCompensationThreads(size_t count) { m_max_compensation_threads = count; }
+
+    /**
+     * @brief maxCompensationThreads Return maximal number of compensation threads, it is the thread count by default.
+     */
+    size_t maxCompensationThreads() const;
+
+    /**
+     * @brief setLaneWeights Set the shares of the high, normal and bulk lanes taken by a worker when all of them have jobs.
+     * @param weights Weights of the lanes, a lane with 0 weight runs only when the others are empty.
+     */
+    void setLaneWeights(const LaneWeights& weights) { m_lane_weights = weights; }
+
+    /**
+     * @brief laneWeights Return the weights of the lanes.
+     */
+    const LaneWeights& laneWeights() const { return m_lane_weights; }
+
 private:
     size_t m_thread_count;
     size_t m_queue_size;
     size_t m_workers_expelling_interval_ms;
+    size_t m_max_compensation_threads;
+    LaneWeights m_lane_weights;
 };
 
 /// Implementation
@@ -63,6 +89,8 @@ inline ThreadPoolOptions::ThreadPoolOptions()
     : m_thread_count(std::max<size_t>(2u, std::thread::hardware_concurrency()))
     , m_queue_size(1024u)
     , m_workers_expelling_interval_ms(1000u)
+    , m_max_compensation_threads(-1u)
+    , m_lane_weights(defaultLaneWeights())
 {
 }
 
@@ -86,4 +114,9 @@ inline size_t ThreadPoolOptions::queueSize() const
     return m_queue_size;
 }
 
+inline size_t ThreadPoolOptions::maxCompensationThreads() const
+{
+    return (m_max_compensation_threads == size_t(-1u))? m_thread_count : m_max_compensation_threads;
+}
+
 }
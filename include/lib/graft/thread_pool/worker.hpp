@@ -1,17 +1,249 @@
 #pragma once
 
+#include "lib/graft/thread_pool/chase_lev_deque.hpp"
+#include "lib/graft/thread_pool/event_count.hpp"
+#include "lib/graft/thread_pool/lanes.hpp"
+
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <cassert>
 
 namespace tp
 {
 
 /**
- * @brief The WorkerT class owns task queue and executing thread.
- * In thread it tries to pop task from queue. If queue is empty then it tries
- * to steal task from the sibling worker. If steal was unsuccessful then spins
- * with one millisecond delay.
+ * @brief The WorkerSlot struct holds the queues of a worker. It outlives the
+ * worker, an expelled worker is replaced by a new one with the same slot.
+ */
+template <typename Task, template<typename> class Queue>
+struct WorkerSlot
+{
+    explicit WorkerSlot(size_t queue_size)
+        : queues{Queue<Task>(queue_size), Queue<Task>(queue_size), Queue<Task>(queue_size)}
+        , deque(queue_size)
+    { }
+
+    WorkerSlot(const WorkerSlot&) = delete;
+    WorkerSlot& operator=(const WorkerSlot&) = delete;
+
+    //it is destroyed when no worker runs
+    ~WorkerSlot() = default;
+
+    bool hasTasks() const
+    {
+        if (deque.size()) return true;
+        for (const Queue<Task>& queue : queues)
+        {
+            if (queue.size()) return true;
+        }
+        return false;
+    }
+
+    static_assert(LaneCount == 3, "a queue should be constructed for each lane");
+    //tasks posted to the worker, a queue per lane
+    Queue<Task> queues[LaneCount];
+    //tasks of the normal lane stolen by the worker in batches, only the worker that has set dequeOwned pushes and
+    //pops it; an expelled worker can still own it until its current task is done
+    TaskDeque<Task> deque;
+    std::atomic<bool> dequeOwned{false};
+    //the worker parks on it
+    EventCount events;
+    //the threads of the slot in blocking regions and the compensation workers running for them
+    std::atomic<uint32_t> blocked{0};
+    std::atomic<uint32_t> compensating{0};
+};
+
+template <typename Task, template<typename> class Queue>
+using WorkerSlotsVec = std::vector<std::unique_ptr<WorkerSlot<Task, Queue>>>;
+
+/**
+ * @brief The PoolState struct holds the state of a pool shared by its workers.
+ */
+struct PoolState
+{
+    explicit PoolState(const LaneWeights& weights = defaultLaneWeights(), size_t spareLimit = 0)
+        : laneWeights(weights), maxSpares(spareLimit)
+    { }
+
+    /**
+     * @brief enterSpare Register a retiring compensation worker as a spare,
+     * while there are less spares than the limit and the pool runs.
+     * @return 'true' if the worker should wait in waitSpare().
+     */
+    bool enterSpare()
+    {
+        std::lock_guard<std::mutex> lk(spareMutex);
+        if (stopping || maxSpares <= spares) return false;
+        ++spares;
+        return true;
+    }
+
+    /**
+     * @brief waitSpare Park a spare until wakeSpare() gives it a slot.
+     * @return The slot to compensate, -1u if the pool stops.
+     */
+    size_t waitSpare()
+    {
+        std::unique_lock<std::mutex> lk(spareMutex);
+        spareCv.wait(lk, [this]{ return stopping || !spareSlots.empty(); });
+        --spares;
+        if (spareSlots.empty())
+        {
+            //stopSpares() waits for it
+            spareCv.notify_all();
+            return -1u;
+        }
+        size_t id = spareSlots.back();
+        spareSlots.pop_back();
+        return id;
+    }
+
+    /**
+     * @brief wakeSpare Give the slot to a parked spare.
+     * @return 'false' if there is no spare.
+     */
+    bool wakeSpare(size_t id)
+    {
+        std::lock_guard<std::mutex> lk(spareMutex);
+        if (spares <= spareSlots.size()) return false;
+        spareSlots.push_back(id);
+        spareCv.notify_all();
+        return true;
+    }
+
+    size_t spareCount()
+    {
+        std::lock_guard<std::mutex> lk(spareMutex);
+        return spares - spareSlots.size();
+    }
+
+    /**
+     * @brief stopSpares Let the spares exit and wait for them.
+     */
+    void stopSpares()
+    {
+        std::unique_lock<std::mutex> lk(spareMutex);
+        stopping = true;
+        spareCv.notify_all();
+        spareCv.wait(lk, [this]{ return spares == 0; });
+    }
+
+    //the weights of the lane schedulers of the workers
+    const LaneWeights laneWeights;
+    //the workers that park or are going to park, the slots are not visited when it is zero
+    std::atomic<uint32_t> parked{0};
+
+    //retired compensation workers wait for a blocked slot instead of exiting, the number of them is limited
+    const size_t maxSpares;
+    size_t spares = 0;
+    //the slots given to the spares
+    std::vector<size_t> spareSlots;
+    bool stopping = false;
+    std::mutex spareMutex;
+    std::condition_variable spareCv;
+};
+
+/**
+ * @brief notifyAny Wake the worker of the slot 'first' or, if it is not
+ * parked, any other parked worker. It costs an atomic load if no worker of
+ * the pool parks.
+ * @return 'true' if a worker has been woken.
+ */
+template <typename Task, template<typename> class Queue>
+inline bool notifyAny(PoolState& pool, WorkerSlotsVec<Task, Queue>& slots, size_t first)
+{
+    //pairs with the increment of parked before a worker checks its queues for the last time
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (pool.parked.load(std::memory_order_seq_cst) == 0) return false;
+    size_t n = slots.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (slots[(first + i) % n]->events.notify()) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief The BlockingObserver class is notified when a worker enters and
+ * leaves a blocking region, the pool implements it.
+ */
+class BlockingObserver
+{
+public:
+    virtual void blockingBegin(size_t id) = 0;
+    virtual void blockingEnd(size_t id) = 0;
+protected:
+    ~BlockingObserver() = default;
+};
+
+namespace detail
+{
+    inline size_t* thread_id()
+    {
+        static thread_local size_t tss_id = -1u;
+        return &tss_id;
+    }
+
+    //it is set for the threads of the workers only
+    struct BlockingState
+    {
+        BlockingObserver* observer = nullptr;
+        std::atomic<std::chrono::high_resolution_clock::time_point>* timePoint = nullptr;
+        std::chrono::milliseconds period{0};
+        size_t depth = 0;
+    };
+
+    inline BlockingState& blocking_state()
+    {
+        static thread_local BlockingState state;
+        return state;
+    }
+}
+
+/**
+ * @brief The BlockingRegion class marks a part of a job that waits for IO or
+ * for another thread, e.g. for an upstream answer. While the region lasts, the
+ * worker is not expelled and the pool can start a compensation worker on its
+ * slot, which retires when the region ends. Nested regions count as one. It
+ * does nothing in a thread that is not a worker.
+ */
+class BlockingRegion
+{
+public:
+    BlockingRegion()
+    {
+        detail::BlockingState& state = detail::blocking_state();
+        if (!state.observer || state.depth++) return;
+        state.timePoint->store(std::chrono::high_resolution_clock::time_point::max());
+        state.observer->blockingBegin(*detail::thread_id());
+    }
+
+    ~BlockingRegion()
+    {
+        detail::BlockingState& state = detail::blocking_state();
+        if (!state.observer || --state.depth) return;
+        state.observer->blockingEnd(*detail::thread_id());
+        //the rest of the job gets the whole period
+        state.timePoint->store(std::chrono::high_resolution_clock::now() + state.period);
+    }
+
+    BlockingRegion(const BlockingRegion&) = delete;
+    BlockingRegion& operator=(const BlockingRegion&) = delete;
+};
+
+/**
+ * @brief The WorkerT class owns executing thread.
+ * In thread it tries to pop task from its queues, choosing the lane by
+ * weighted round-robin; the deque is a part of the normal lane. If they are
+ * empty then it tries to steal from a randomly chosen worker and goes through
+ * all workers. If steal was unsuccessful then spins for a while and parks
+ * until a task is posted.
  */
 template <typename Task, template<typename> class Queue>
 class WorkerT
@@ -48,12 +280,17 @@ public:
      */
     WorkerT& operator=(WorkerT&& rhs) noexcept;
 
+    using Slot = WorkerSlot<Task, Queue>;
+    using SlotsVec = WorkerSlotsVec<Task, Queue>;
+
     /**
      * @brief start Create the executing thread and start tasks execution.
-     * @param id WorkerT ID.
-     * @param steal_donor Sibling worker to steal task from it.
+     * @param id WorkerT ID, the index of its slot.
+     * @param slots Slots of all workers of the pool.
+     * @param pool The state shared by the workers of the pool.
+     * @param observer The pool notified about blocking regions of the jobs.
      */
-    void start(size_t id, Queue<Task>& queue, Queue<Task>& steal_queue, std::shared_ptr<WorkerT>&& rwptr);
+    void start(size_t id, SlotsVec& slots, PoolState& pool, std::shared_ptr<WorkerT>&& rwptr, BlockingObserver* observer = nullptr);
 
     /**
      * @brief stop Stop all worker's thread and stealing activity.
@@ -71,32 +308,71 @@ public:
     /**
      * @brief threadFunc Executing thread function.
      * @param id WorkerT ID to be associated with this thread.
-     * @param steal_donor Sibling worker to steal task from it.
+     * @param slots Slots of all workers of the pool.
+     * @param pool The state shared by the workers of the pool.
+     * @return 'true' if the retired compensation worker has become a spare.
      */
 
-    void threadFunc(size_t id, Queue<Task>& queue, Queue<Task>& steal_queue, std::shared_ptr<WorkerT>&& rwptr);
+    bool threadFunc(size_t id, SlotsVec& slots, PoolState& pool, std::shared_ptr<WorkerT>&& rwptr, BlockingObserver* observer);
+
+    /**
+     * @brief retire Check if the compensation worker is not needed anymore,
+     * that is its slot has more compensation workers than blocked threads.
+     * @return 'true' if the worker should exit.
+     */
+    bool retire(Slot& own);
+
+    /**
+     * @brief steal Take a task of another worker, going through workers from
+     * a random one; a task of the high lane is preferred. Tasks of the normal
+     * lane are stolen by a half, the first one is returned in handler, the
+     * rest are put to the own deque if the worker owns it.
+     * @return 'true' on success.
+     */
+    static bool steal(size_t id, SlotsVec& slots, bool ownsDeque, Task& handler, uint64_t& rnd);
+
+    /**
+     * @brief stealHigh Take a task of the high lane of another worker, it is
+     * tried before a bulk task is started.
+     * @return 'true' on success.
+     */
+    static bool stealHigh(size_t id, SlotsVec& slots, Task& handler);
+
+    /**
+     * @brief Limits of the number of spins before parking. The limit grows
+     * when tasks are found while spinning and decreases when the worker parks.
+     */
+    static constexpr uint32_t minSpins = 16;
+    static constexpr uint32_t maxSpins = 4096;
 
     static_assert(std::atomic<uint64_t>::is_always_lock_free);
     static std::atomic<uint64_t> activeCount;
     static std::atomic<uint64_t> expelledCount;
+    //threads in blocking regions, running compensation workers and all compensation workers started
+    static std::atomic<uint64_t> blockedCount;
+    static std::atomic<uint64_t> compensatingCount;
+    static std::atomic<uint64_t> compensatedCount;
     static std::chrono::milliseconds defaultPeriodMs;
 
     std::atomic<TimePoint> m_timePoint = maxTimePoint();
     static_assert(decltype(m_timePoint)::is_always_lock_free);
     std::atomic<bool> m_running_flag{true};
     std::thread m_thread;
+    EventCount* m_events = nullptr;
+    //the counter of the compensation workers of the pool, it is set for a compensation worker only
+    std::atomic<size_t>* m_compensations = nullptr;
 };
 
 
 /// Implementation
 
-namespace detail
+/**
+ * @brief currentWorkerId Return ID of the worker of the current thread,
+ * -1u if the thread is not a worker.
+ */
+inline size_t currentWorkerId()
 {
-    inline size_t* thread_id()
-    {
-        static thread_local size_t tss_id = -1u;
-        return &tss_id;
-    }
+    return *detail::thread_id();
 }
 
 template <typename Task, template<typename> class Queue>
@@ -105,6 +381,15 @@ std::atomic<uint64_t> WorkerT<Task, Queue>::activeCount = 0;
 template <typename Task, template<typename> class Queue>
 std::atomic<uint64_t> WorkerT<Task, Queue>::expelledCount = 0;
 
+template <typename Task, template<typename> class Queue>
+std::atomic<uint64_t> WorkerT<Task, Queue>::blockedCount = 0;
+
+template <typename Task, template<typename> class Queue>
+std::atomic<uint64_t> WorkerT<Task, Queue>::compensatingCount = 0;
+
+template <typename Task, template<typename> class Queue>
+std::atomic<uint64_t> WorkerT<Task, Queue>::compensatedCount = 0;
+
 template <typename Task, template<typename> class Queue>
 std::chrono::milliseconds WorkerT<Task, Queue>::defaultPeriodMs(200);
 
@@ -128,19 +413,25 @@ inline WorkerT<Task, Queue>& WorkerT<Task, Queue>::operator=(WorkerT&& rhs) noex
 template <typename Task, template<typename> class Queue>
 inline void WorkerT<Task, Queue>::stop()
 {
-    m_running_flag.store(false, std::memory_order_relaxed);
+    m_running_flag.store(false, std::memory_order_seq_cst);
+    if (m_events) m_events->notifyAll();
     m_thread.join();
 }
 
 template <typename Task, template<typename> class Queue>
-inline void WorkerT<Task, Queue>::start(size_t id, Queue<Task>& queue, Queue<Task>& steal_queue, std::shared_ptr<WorkerT>&& rwptr)
+inline void WorkerT<Task, Queue>::start(size_t id, SlotsVec& slots, PoolState& pool, std::shared_ptr<WorkerT>&& rwptr, BlockingObserver* observer)
 {
     assert(rwptr.get() == this);
     ++activeCount;
-    m_thread = std::thread([this,id,&queue,&steal_queue,rwptr]()
+    m_events = &slots[id]->events;
+    m_thread = std::thread([this,id,&slots,&pool,rwptr,observer]()
     {
-        std::shared_ptr<WorkerT> wptr = rwptr;
-        threadFunc(id, queue, steal_queue, std::move(wptr));
+        //a retired compensation worker parks as a spare and can compensate another slot later
+        for (size_t slot = id; threadFunc(slot, slots, pool, std::shared_ptr<WorkerT>(rwptr), observer); )
+        {
+            slot = pool.waitSpare();
+            if (slot == -1u) break;
+        }
     });
 
 }
@@ -152,35 +443,176 @@ inline size_t WorkerT<Task, Queue>::getWorkerIdForCurrentThread()
 }
 
 template <typename Task, template<typename> class Queue>
-inline void WorkerT<Task, Queue>::threadFunc(size_t id, Queue<Task>& queue, Queue<Task>& steal_queue, std::shared_ptr<WorkerT>&& rwptr)
+inline bool WorkerT<Task, Queue>::steal(size_t id, SlotsVec& slots, bool ownsDeque, Task& handler, uint64_t& rnd)
+{
+    size_t n = slots.size();
+    if (n < 2) return false;
+
+    //xorshift
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+
+    Slot& own = *slots[id];
+    size_t first = rnd % n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t v = (first + i) % n;
+        //the deque of the own slot can be owned by the expelled worker yet
+        if (v == id && ownsDeque) continue;
+        Slot& victim = *slots[v];
+
+        if (victim.queues[HighLane].pop(handler)) return true;
+
+        size_t size = victim.deque.size();
+        if (size && victim.deque.steal(handler))
+        {
+            size_t more = (ownsDeque)? (size - 1) / 2 : 0;
+            for (Task t; more && own.deque.canPush() && victim.deque.steal(t); --more)
+            {
+                bool ok = own.deque.push(std::move(t));
+                assert(ok);
+            }
+            return true;
+        }
+
+        Queue<Task>& queue = victim.queues[NormalLane];
+        size = queue.size();
+        if (size && queue.pop(handler))
+        {
+            size_t more = (ownsDeque)? (size - 1) / 2 : 0;
+            for (Task t; more && own.deque.canPush() && queue.pop(t); --more)
+            {
+                bool ok = own.deque.push(std::move(t));
+                assert(ok);
+            }
+            return true;
+        }
+
+        //the deque is a part of the normal lane, the bulk tasks are stolen one by one
+        if (victim.queues[BulkLane].pop(handler)) return true;
+    }
+    return false;
+}
+
+template <typename Task, template<typename> class Queue>
+inline bool WorkerT<Task, Queue>::stealHigh(size_t id, SlotsVec& slots, Task& handler)
+{
+    size_t n = slots.size();
+    for (size_t i = 1; i < n; ++i)
+    {
+        if (slots[(id + i) % n]->queues[HighLane].pop(handler)) return true;
+    }
+    return false;
+}
+
+template <typename Task, template<typename> class Queue>
+inline bool WorkerT<Task, Queue>::retire(Slot& own)
+{
+    if (!m_compensations) return false;
+    uint32_t c = own.compensating.load(std::memory_order_seq_cst);
+    while (c > own.blocked.load(std::memory_order_seq_cst))
+    {
+        if (own.compensating.compare_exchange_weak(c, c - 1, std::memory_order_seq_cst)) return true;
+    }
+    return false;
+}
+
+template <typename Task, template<typename> class Queue>
+inline bool WorkerT<Task, Queue>::threadFunc(size_t id, SlotsVec& slots, PoolState& pool, std::shared_ptr<WorkerT>&& rwptr, BlockingObserver* observer)
 {
     assert(rwptr.get() == this);
 
     *detail::thread_id() = id;
+    detail::BlockingState& blocking = detail::blocking_state();
+    blocking.observer = observer;
+    blocking.timePoint = &m_timePoint;
+    blocking.period = defaultPeriodMs;
 
+    Slot& own = *slots[id];
     Task handler;
+    uint64_t rnd = (id + 1) * 0x9E3779B97F4A7C15ull;
+    uint32_t spinLimit = minSpins;
+    uint32_t spins = 0;
+    bool ownsDeque = false;
+    LaneScheduler lanes(pool.laneWeights);
+
+    auto takeOwn = [&](size_t lane) -> bool
+    {
+        if (lane == NormalLane && ownsDeque && own.deque.pop(handler)) return true;
+        //the owner of a high task can be busy with a long job
+        if (lane == BulkLane && own.queues[BulkLane].size() && stealHigh(id, slots, handler)) return true;
+        return own.queues[lane].pop(handler);
+    };
+
+    auto take = [&]() -> bool
+    {
+        if (!ownsDeque) ownsDeque = !own.dequeOwned.exchange(true, std::memory_order_acquire);
+        if (lanes.pick(takeOwn)) return true;
+        if (!steal(id, slots, ownsDeque, handler, rnd)) return false;
+        //the rest of the stolen tasks can be taken by a parked worker
+        if (own.deque.size()) notifyAny(pool, slots, id + 1);
+        return true;
+    };
+
+    auto execute = [this, &handler]()
+    {
+        m_timePoint = getTimePoint(defaultPeriodMs);
+        handler();
+        m_timePoint = maxTimePoint();
+    };
 
     while (m_running_flag.load(std::memory_order_relaxed))
     {
-        if (queue.pop(handler) || steal_queue.pop(handler))
+        if (take())
         {
-            try
-            {
-                m_timePoint = getTimePoint(defaultPeriodMs);
-                handler();
-                m_timePoint = maxTimePoint();
-            }
-            catch(...)
-            {
-                throw;
-            }
+            if (spins) spinLimit = std::min(maxSpins, spinLimit * 2);
+            spins = 0;
+            execute();
+            if (retire(own)) break;
+            continue;
+        }
+        if (spins < spinLimit)
+        {
+            ++spins;
+            cpuRelax();
+            continue;
         }
-        else
+
+        spins = 0;
+        spinLimit = std::max(minSpins, spinLimit / 2);
+        pool.parked.fetch_add(1, std::memory_order_seq_cst);
+        EventCount::Key key = own.events.prepareWait();
+        //a task could be posted or the worker stopped after the last check
+        if (take())
+        {
+            own.events.cancelWait();
+            pool.parked.fetch_sub(1, std::memory_order_seq_cst);
+            execute();
+            if (retire(own)) break;
+            continue;
+        }
+        //a blocking region could end after the last check
+        if (!m_running_flag.load(std::memory_order_seq_cst) || retire(own))
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            own.events.cancelWait();
+            pool.parked.fetch_sub(1, std::memory_order_seq_cst);
+            break;
         }
+        own.events.wait(key);
+        pool.parked.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    if (ownsDeque) own.dequeOwned.store(false, std::memory_order_release);
+    bool spare = false;
+    if (m_compensations)
+    {
+        --*m_compensations;
+        --compensatingCount;
+        //it is registered while it is active, so the pool waits for it
+        spare = m_running_flag.load(std::memory_order_relaxed) && pool.enterSpare();
     }
     --activeCount;
+    return spare;
 }
 
 }
@@ -1,93 +1,86 @@
 #pragma once
 
 #include <chrono>
-#include <queue>
+#include <cstdint>
 #include <functional>
-#include <iostream>
-#include <string>
+#include <vector>
 
 namespace graft
 {
     namespace ch = std::chrono;
 
-    template<typename TR_ptr>
-    class TimerList
+    //Hierarchical timing wheel with 1 ms resolution. It has 4 levels of 256 slots, that covers about 49 days.
+    //Adding and cancelling of a timer are O(1), a timer is moved to a lower level at most 3 times before it fires.
+    //It is not thread-safe, timers are added, cancelled and fired in the IO thread.
+    class TimingWheel
     {
-        struct timer
+    public:
+        using Callback = std::function<void()>;
+
+        class Handle
         {
-            ch::milliseconds timeout;
-            ch::milliseconds lap;
-            TR_ptr ptr;
+        public:
+            Handle() = default;
+        private:
+            friend class TimingWheel;
+            Handle(uint32_t index, uint32_t generation) : m_index(index), m_generation(generation) { }
 
-            timer(ch::milliseconds timeout, TR_ptr ptr)
-                : timeout(timeout)
-                , lap(ch::milliseconds::max())
-                , ptr(ptr) {}
+            uint32_t m_index = UINT32_MAX;
+            uint32_t m_generation = 0;
+        };
 
-            timer() = delete;
+        TimingWheel();
+        TimingWheel(const TimingWheel&) = delete;
+        TimingWheel& operator = (const TimingWheel&) = delete;
 
-            void start()
-            {
-                lap = ch::time_point_cast<ch::milliseconds>(
-                    ch::steady_clock::now()
-                ).time_since_epoch() + timeout;
-            }
+        using time_point = ch::steady_clock::time_point;
 
-            bool fired()
-            {
-                return lap <=
-                    ch::time_point_cast<ch::milliseconds>(
-                        ch::steady_clock::now()
-                    ).time_since_epoch();
-            }
-            void dump(const std::string &pref) const
-            {
-                std::cout << pref << " timeout: " << timeout.count()
-                    << "; lap: " << lap.count() << std::endl;
-            }
+        //cb is called from eval() not earlier than timeout passes;
+        //now parameters can be set by tests to go through time faster
+        Handle add(ch::milliseconds timeout, Callback cb, time_point now = ch::steady_clock::now());
+        //does nothing if the timer has been fired or cancelled already, the handle is reset
+        void cancel(Handle& handle);
+        bool pending(const Handle& handle) const;
+        //fires the timers that are due, returns the number of fired ones
+        size_t eval(time_point now = ch::steady_clock::now());
+        //time left until the earliest timer, max() if there are no timers;
+        //for timers that are far enough it can be less, it is the time when they are moved to a lower level
+        ch::milliseconds nextTimeout(time_point now = ch::steady_clock::now()) const;
+        size_t size() const { return m_count; }
 
-            bool operator < (const timer& other) const
-            {
-                return lap < other.lap;
-            }
-            bool operator > (const timer& other) const { return ! operator <(other); }
-        };
+    private:
+        static constexpr int Levels = 4;
+        static constexpr int SlotBits = 8;
+        static constexpr uint32_t Slots = 1 << SlotBits;
+        static constexpr uint32_t SlotMask = Slots - 1;
+        static constexpr uint32_t Words = Slots / 64;
+        static constexpr uint32_t npos = UINT32_MAX;
 
-        class priority_queue : public std::priority_queue<timer, std::vector<timer>, std::greater<timer>>
+        struct Node
         {
-            using base_t = std::priority_queue<timer, std::vector<timer>, std::greater<timer>>;
-        public:
-            const typename base_t::container_type& get_c() const { return base_t::c; }
+            uint64_t expires = 0;
+            Callback cb;
+            uint32_t prev = npos;
+            uint32_t next = npos;
+            uint32_t slot = npos; //level * Slots + index, npos if the node is free
+            uint32_t generation = 0;
         };
 
-        priority_queue m_pq;
+        uint64_t toTick(time_point now) const;
+        void link(uint32_t index, uint64_t base);
+        void unlink(uint32_t index);
+        void release(uint32_t index);
+        void cascade(int level, uint32_t idx);
+        void tick();
+        //distance from 'from' to the first non-empty slot of the level going round, -1 if all are empty
+        int firstSet(int level, uint32_t from) const;
 
-    public:
-
-        void push(ch::milliseconds timeout, TR_ptr ptr)
-        {
-            timer t(timeout, ptr);
-            t.start();
-            m_pq.emplace(std::move(t));
-        }
-
-        void eval()
-        {
-            while(!m_pq.empty())
-            {
-                auto t = m_pq.top();
-                if(!t.fired()) break;
-                m_pq.pop();
-                t.ptr->getManager().onTimer(t.ptr);
-            }
-        }
-        void dump(const std::string &pref) const
-        {
-            auto& vec = m_pq.get_c();
-            std::for_each(vec.begin(), vec.end(),
-                [&pref](auto& t) { t.dump(pref); }
-            );
-        }
+        std::vector<Node> m_nodes;
+        std::vector<uint32_t> m_free;
+        uint32_t m_heads[Levels * Slots];
+        uint64_t m_bitmap[Levels][Words];
+        uint64_t m_current = 0; //the last processed tick
+        size_t m_count = 0;
+        time_point m_origin;
     };
 }
-
@@ -58,6 +58,9 @@ protected:
     bool init(const std::string &daemon_address, boost::optional<epee::net_utils::http::login> daemon_login);
 
 private:
+    template <typename Request, typename Response>
+    bool invoke_http_json(const std::string &uri, const Request &req, Response &res);
+
     epee::net_utils::http::http_simple_client m_http_client;
     std::chrono::seconds m_rpc_timeout;
 };
@@ -189,10 +189,18 @@ public:
     uint64_t getBlockchainBasedListForAuthSample(uint64_t block_number, blockchain_based_list& list) const;
     
     /*!
-     * \brief synchronizeWithCryptonode - synchronize with cryptonode
-     * \return
+     * \brief needStakes - checks if the stakes should be requested from cryptonode, the request is repeated after a delay
+     *                      until the stakes are received
+     * \return            - true if the request should be sent now
+     */
+    bool needStakes();
+
+    /*!
+     * \brief needBlockchainBasedList - checks if the blockchain based list should be requested from cryptonode
+     * \param last_received_block_height - the height of the last received list
+     * \return                           - true if the request should be sent now
      */
-    void synchronizeWithCryptonode(const char* supernode_network_address, const char* supernode_address);
+    bool needBlockchainBasedList(uint64_t& last_received_block_height);
 
     /*!
      * \brief getBlockchainHeight - returns current daemon block height
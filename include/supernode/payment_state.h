@@ -0,0 +1,152 @@
+#pragma once
+
+#include "lib/graft/graft_utility.hpp"
+#include "supernode/requestdefines.h"
+#include "supernode/requests/authorize_rta_tx.h"
+#include "supernode/requests/sale_details.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace cryptonote { class transaction; }
+
+namespace graft {
+
+/*!
+ * \brief PaymentState - everything the supernode knows about a payment
+ */
+struct PaymentState
+{
+    int status = static_cast<int>(RTAStatus::None);
+    std::shared_ptr<const SaleData> sale;
+    // the details of the sale, it is set (possibly empty) when the details are known locally
+    std::shared_ptr<const std::string> saleDetails;
+    // cached sale details received from a remote supernode
+    std::shared_ptr<const supernode::request::SaleDetailsResponse> saleDetailsResult;
+    std::shared_ptr<const PayData> pay;
+    // rta tx of the payment
+    std::string txId;
+    uint64_t txAmount = 0;
+    std::shared_ptr<const cryptonote::transaction> tx;
+    supernode::request::RtaAuthResult votes;
+};
+
+/*!
+ * \brief PaymentStateStore - one record per payment id and the index tx id -> payment id.
+ *        A record is updated atomically under its lock, it expires when it is not accessed for the ttl.
+ *        The index has no ttl of its own, the binding is the txId of the record and its entry is removed
+ *        together with the record.
+ */
+class PaymentStateStore
+{
+public:
+    explicit PaymentStateStore(std::chrono::seconds ttl = RTA_TX_TTL) : m_ttl(ttl) { }
+    PaymentStateStore(const PaymentStateStore&) = delete;
+    PaymentStateStore& operator = (const PaymentStateStore&) = delete;
+
+    /*!
+     * \brief read - calls f(const PaymentState&) under the lock of the record
+     * \return     - false if there is no record for the payment
+     */
+    template<typename F>
+    bool read(const std::string &payment_id, F f) const
+    {
+        return m_payments.read(payment_id, f);
+    }
+
+    /*!
+     * \brief update - calls f(PaymentState&) under the lock of the record, the record is created if there is none
+     */
+    template<typename F>
+    void update(const std::string &payment_id, F f)
+    {
+        m_payments.addOrApply(payment_id, f, m_ttl, [this](std::pair<std::string, PaymentState> &expired) {
+            unbindTx(expired.second.txId, expired.first);
+        });
+    }
+
+    void remove(const std::string &payment_id)
+    {
+        std::string tx_id;
+        read(payment_id, [&tx_id](const PaymentState &state) { tx_id = state.txId; });
+        m_payments.remove(payment_id);
+        unbindTx(tx_id, payment_id);
+    }
+
+    int status(const std::string &payment_id, int defval = static_cast<int>(RTAStatus::None)) const
+    {
+        read(payment_id, [&defval](const PaymentState &state) { defval = state.status; });
+        return defval;
+    }
+
+    void setStatus(const std::string &payment_id, int status)
+    {
+        update(payment_id, [status](PaymentState &state) { state.status = status; });
+    }
+
+    /*!
+     * \brief bindTx - maps tx id to the payment and calls f(PaymentState&) in the same update of the record,
+     *               the record of the payment is created if there is none
+     */
+    template<typename F>
+    void bindTx(const std::string &tx_id, const std::string &payment_id, F f)
+    {
+        std::string old_tx_id;
+        update(payment_id, [&tx_id, &f, &old_tx_id](PaymentState &state) {
+            old_tx_id = state.txId;
+            state.txId = tx_id;
+            f(state);
+        });
+        m_txIndex.addOrUpdate(tx_id, payment_id);
+        if (old_tx_id != tx_id)
+            unbindTx(old_tx_id, payment_id);
+    }
+
+    void bindTx(const std::string &tx_id, const std::string &payment_id)
+    {
+        bindTx(tx_id, payment_id, [](PaymentState&) { });
+    }
+
+    /*!
+     * \brief paymentIdByTx - returns empty string if the tx is unknown or the record of the payment
+     *                      is gone or bound to another tx
+     */
+    std::string paymentIdByTx(const std::string &tx_id) const
+    {
+        std::string payment_id;
+        m_txIndex.read(tx_id, [&payment_id](const std::string &id) { payment_id = id; });
+        if (payment_id.empty())
+            return payment_id;
+        bool bound = false;
+        read(payment_id, [&tx_id, &bound](const PaymentState &state) { bound = (state.txId == tx_id); });
+        return bound ? payment_id : std::string();
+    }
+
+    /*!
+     * \brief cleanup - removes the expired records and their index entries
+     * \return        - number of expired records
+     */
+    size_t cleanup()
+    {
+        return m_payments.cleanup();
+    }
+
+private:
+    // removes the index entry if it still refers to the payment
+    void unbindTx(const std::string &tx_id, const std::string &payment_id)
+    {
+        if (tx_id.empty())
+            return;
+        bool own = false;
+        m_txIndex.read(tx_id, [&payment_id, &own](const std::string &id) { own = (id == payment_id); });
+        if (own)
+            m_txIndex.remove(tx_id);
+    }
+
+    std::chrono::seconds m_ttl;
+    TSHashtable<std::string, PaymentState> m_payments;
+    TSHashtable<std::string, std::string> m_txIndex;
+};
+
+}
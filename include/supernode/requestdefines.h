@@ -23,22 +23,11 @@ static const std::string MESSAGE_RTA_CANT_BUILD_AUTH_SAMPLE("Can't build auth sa
 static const std::string MESSAGE_INVALID_TRANSACTION("Can't parse transaction");
 
 //Context Keys
-static const std::string CONTEXT_KEY_SALE_DETAILS(":saledetails");
-static const std::string CONTEXT_KEY_SALE(":sale");
-static const std::string CONTEXT_KEY_STATUS(":status");
-static const std::string CONTEXT_KEY_PAY(":pay");
+// the state of the payments is kept by PaymentStateStore
 static const std::string CONTEXT_KEY_SUPERNODE("supernode");
 static const std::string CONTEXT_KEY_FULLSUPERNODELIST("fsl");
-// key to maintain auth responses from supernodes for given tx id
-static const std::string CONTEXT_KEY_AUTH_RESULT_BY_TXID(":tx_id_to_auth_resp");
-// key to map tx_id -> payment_id
-static const std::string CONTEXT_KEY_PAYMENT_ID_BY_TXID(":tx_id_to_payment_id");
-// key to map tx_id -> tx
-static const std::string CONTEXT_KEY_TX_BY_TXID(":tx_id_to_tx");
 // key to store tx id in local context
 static const std::string CONTEXT_TX_ID("tx_id");
-// key to map tx_id -> amount
-static const std::string CONTEXT_KEY_AMOUNT_BY_TX_ID(":tx_id_to_amount");
 
 // key to store sale_details response coming from callback
 static const std::string CONTEXT_SALE_DETAILS_RESULT(":sale_details_result");
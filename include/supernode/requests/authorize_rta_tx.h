@@ -3,8 +3,18 @@
 
 #include "lib/graft/router.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 namespace graft::supernode::request {
 
+GRAFT_DEFINE_IO_STRUCT_INITED(SupernodeSignature,
+                              (std::string, id_key, std::string()),
+                              (std::string, result_signature, std::string()), // signarure for tx_id + result
+                              (std::string, tx_signature, std::string())      // signature for tx_id only
+                              );
+
 GRAFT_DEFINE_IO_STRUCT(AuthorizeRtaTxRequest,
                        (std::string, tx_hex),
                        (std::string, payment_id), // TODO: this should be put to tx.extra and removed from here
@@ -12,6 +22,30 @@ GRAFT_DEFINE_IO_STRUCT(AuthorizeRtaTxRequest,
                                                  // TODO: Amount needs to be protected with signature
                        );
 
+// votes of the auth sample for rta tx
+struct RtaAuthResult
+{
+    std::vector<SupernodeSignature> approved;
+    std::vector<SupernodeSignature> rejected;
+    bool alreadyApproved(const std::string &id) const
+    {
+        return contains(approved, id);
+    }
+
+    bool alreadyRejected(const std::string &id) const
+    {
+        return contains(rejected, id);
+    }
+
+private:
+    static bool contains(const std::vector<SupernodeSignature> &v, const std::string &id)
+    {
+        return std::find_if(v.begin(), v.end(), [&](const SupernodeSignature &item) {
+            return item.id_key == id;
+        }) != v.end();
+    }
+};
+
 void registerAuthorizeRtaTxRequests(graft::Router& router);
 
 }
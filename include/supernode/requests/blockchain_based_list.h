@@ -28,6 +28,15 @@ GRAFT_DEFINE_IO_STRUCT_INITED(BlockchainBasedListResponse,
 GRAFT_DEFINE_JSON_RPC_REQUEST(BlockchainBasedListJsonRpcRequest, BlockchainBasedList);
 GRAFT_DEFINE_JSON_RPC_RESPONSE_RESULT(BlockchainBasedListJsonRpcResponse, BlockchainBasedListResponse);
 
+// request to cryptonode, it sends the lists after the height to the network address
+GRAFT_DEFINE_IO_STRUCT_INITED(GetBlockchainBasedList,
+                              (std::string, network_address, std::string()),
+                              (std::string, supernode_public_id, std::string()),
+                              (uint64_t,    last_received_block_height, 0)
+                       );
+
+GRAFT_DEFINE_JSON_RPC_REQUEST(GetBlockchainBasedListJsonRpcRequest, GetBlockchainBasedList);
+
 void registerBlockchainBasedListRequest(graft::Router &router);
 
 }
@@ -34,6 +34,16 @@ void registerSendSupernodeAnnounceRequest(graft::Router &router);
  */
 Status sendAnnounce(const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx,
         graft::Output& output);
+/*!
+ * \brief sendAnnounceAsync - send supernode announce without waiting for cryptonode, used by periodic task
+ * \param vars
+ * \param input
+ * \param ctx
+ * \param output
+ * \return
+ */
+Status sendAnnounceAsync(const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx,
+        graft::Output& output);
 
 }
 
@@ -27,6 +27,14 @@ GRAFT_DEFINE_IO_STRUCT_INITED(SendSupernodeStakesResponse,
 GRAFT_DEFINE_JSON_RPC_REQUEST(SendSupernodeStakesJsonRpcRequest, SupernodeStakes);
 GRAFT_DEFINE_JSON_RPC_RESPONSE_RESULT(SendSupernodeStakesJsonRpcResponse, SendSupernodeStakesResponse);
 
+// request to cryptonode, it sends the stakes to the network address
+GRAFT_DEFINE_IO_STRUCT_INITED(GetSupernodeStakes,
+                              (std::string, network_address, std::string()),
+                              (std::string, supernode_public_id, std::string())
+                       );
+
+GRAFT_DEFINE_JSON_RPC_REQUEST(GetSupernodeStakesJsonRpcRequest, GetSupernodeStakes);
+
 void registerSendSupernodeStakesRequest(graft::Router &router);
 
 }
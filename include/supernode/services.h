@@ -0,0 +1,18 @@
+#pragma once
+
+#include "lib/graft/service_registry.h"
+#include "rta/supernode.h"
+#include "rta/fullsupernodelist.h"
+#include "supernode/payment_state.h"
+
+#include <memory>
+#include <string>
+
+//the services of the supernode, they are registered by Supernode::prepareSupernode()
+namespace graft::services
+{
+    using Supernode = ServiceKey<SupernodePtr, AppIndex + 0>;
+    using FullSupernodeList = ServiceKey<FullSupernodeListPtr, AppIndex + 1>;
+    using WatchonlyWalletsPath = ServiceKey<std::string, AppIndex + 2>;
+    using PaymentStates = ServiceKey<std::shared_ptr<PaymentStateStore>, AppIndex + 3>;
+}//namespace graft::services
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <regex>
 #include <chrono>
+#include <mutex>
 
 namespace graft {
 
@@ -154,6 +155,8 @@ private:
     IpMap m_ipmap;
     std::chrono::steady_clock::duration m_banTimeout;
     std::deque< std::pair<std::chrono::steady_clock::time_point, in_addr_t> > m_bannedIPs;
+    //processIp can be called from several IO threads
+    std::mutex m_mutex;
 
     void unban()
     {
@@ -207,6 +210,7 @@ private:
 public:
     virtual bool processIp(in_addr_t addr, bool networkOrder = true) override
     {
+        std::lock_guard<std::mutex> lk(m_mutex);
         if(banEnabled && m_banTimeout.count() != 0)
         {
             unban();
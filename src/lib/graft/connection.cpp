@@ -4,6 +4,8 @@
 #include "lib/graft/sys_info.h"
 #include "lib/graft/graft_exception.h"
 
+#include <iostream>
+
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "supernode.connection"
 
@@ -47,7 +49,6 @@ void UpstreamStub::ev_handler(mg_connection *upstream, int ev, void *ev_data)
     {
     case MG_EV_CLOSE:
     {
-        mg_set_timer(upstream, 0);
         LOG_PRINT_CLN(2,upstream,"Stub connection closed");
         upstream->handler = static_empty_ev_handler;
         m_onCloseCallback(upstream);
@@ -127,7 +128,9 @@ void UpstreamSender::send(TaskManager &manager, const std::string& def_uri)
         m_upstream = upstream;
         m_upstream->user_data = this;
     }
-    mg_set_timer(m_upstream, mg_time() + m_timeout);
+    TimingWheel& timers = manager.getTimers();
+    timers.cancel(m_timer);
+    m_timer = timers.add(std::chrono::milliseconds(static_cast<int64_t>(m_timeout * 1000)), [this]{ onTimeout(); });
 
     auto& rsi = manager.runtimeSysInfo();
     rsi.count_upstrm_http_req();
@@ -146,6 +149,7 @@ void UpstreamSender::ev_handler(mg_connection *upstream, int ev, void *ev_data)
         {
             std::ostringstream ss;
             ss << "cryptonode connect failed: " << strerror(err);
+            cancelTimer(upstream);
             setError(Status::Error, ss.str().c_str());
             upstream->handler = static_empty_ev_handler;
             m_upstream = nullptr;
@@ -155,18 +159,17 @@ void UpstreamSender::ev_handler(mg_connection *upstream, int ev, void *ev_data)
     } break;
     case MG_EV_HTTP_REPLY:
     {
-        mg_set_timer(upstream, 0);
+        cancelTimer(upstream);
         http_message* hm = static_cast<http_message*>(ev_data);
-        m_bt->getInput() = Input(*hm, client_host(upstream));
+        m_bt->getInput() = Input(*hm, client_host(upstream), mg::mg_take_message_x(upstream, *hm));
 
-        ConnectionBase* conBase = ConnectionBase::from(upstream->mgr);
-        assert(conBase);
-        conBase->getSysInfoCounter().count_upstrm_http_resp_bytes_raw(hm->message.len);
+        Looper* looper = Looper::from(upstream->mgr);
+        looper->runtimeSysInfo().count_upstrm_http_resp_bytes_raw(hm->message.len);
 
         setError(Status::Ok);
         if(!m_keepAlive)
         {
-            upstream->flags |= MG_F_CLOSE_IMMEDIATELY;
+            mg::mg_set_flags_x(upstream, MG_F_CLOSE_IMMEDIATELY);
             upstream->handler = static_empty_ev_handler;
             m_upstream = nullptr;
         }
@@ -175,43 +178,82 @@ void UpstreamSender::ev_handler(mg_connection *upstream, int ev, void *ev_data)
     } break;
     case MG_EV_CLOSE:
     {
-        mg_set_timer(upstream, 0);
+        cancelTimer(upstream);
         setError(Status::Error, "cryptonode connection unexpectedly closed");
         upstream->handler = static_empty_ev_handler;
         m_upstream = nullptr;
         m_onDone(*this, m_connectioId, m_upstream);
         releaseItself();
     } break;
-    case MG_EV_TIMER:
-    {
-        mg_set_timer(upstream, 0);
-        setError(Status::Error, "cryptonode request timout");
-        upstream->flags |= MG_F_CLOSE_IMMEDIATELY;
-        upstream->handler = static_empty_ev_handler;
-        m_upstream = nullptr;
-        m_onDone(*this, m_connectioId, m_upstream);
-        releaseItself();
-    } break;
     default:
         break;
     }
 }
 
+void UpstreamSender::cancelTimer(mg_connection* upstream)
+{
+    Looper::from(upstream->mgr)->getTimers().cancel(m_timer);
+}
+
+void UpstreamSender::onTimeout()
+{
+    mg_connection* upstream = m_upstream;
+    assert(upstream);
+    setError(Status::Error, "cryptonode request timout");
+    mg::mg_set_flags_x(upstream, MG_F_CLOSE_IMMEDIATELY);
+    upstream->handler = static_empty_ev_handler;
+    m_upstream = nullptr;
+    m_onDone(*this, m_connectioId, m_upstream);
+    releaseItself();
+}
+
 ConnectionBase::~ConnectionBase()
 {
     //m_looper depends on pointer that is held by m_sysInfo.
     //It could be possible that m_looper uses the counters in its dtor.
     //Thus we should ensure that m_looper should be destroyed before m_sysInfo.
     //Following is explicit destruction order to be independent on the members order..
+    //Secondary loopers share the thread pool and the global context of m_looper.
+    m_loopers.clear();
     m_looper.reset();
     m_sysInfo.reset();
 }
 
 ConnectionBase* ConnectionBase::from(mg_mgr *mgr)
 {
-    void* user_data = getUserData(mgr);
-    assert(user_data);
-    return static_cast<ConnectionBase*>(user_data);
+    return &Looper::from(mgr)->getConnectionBase();
+}
+
+bool ConnectionBase::ready() const
+{
+    if(!m_looperReady || !m_looper->ready()) return false;
+    for(auto& looper : m_loopers)
+    {
+        if(!looper->ready()) return false;
+    }
+    return true;
+}
+
+void ConnectionBase::stop(bool force)
+{
+    assert(m_looper);
+    forEachLooper([force](Looper& looper){ looper.stop(force); });
+}
+
+void ConnectionBase::serve()
+{
+    assert(m_looper);
+    std::vector<std::thread> threads;
+    threads.reserve(m_loopers.size());
+    for(auto& looper : m_loopers)
+    {
+        threads.emplace_back([&looper]{ looper->serve(); });
+    }
+    m_looper->serve();
+    for(auto& th : threads)
+    {
+        th.join();
+    }
 }
 
 void ConnectionBase::loadBlacklist(const ConfigOpts& copts)
@@ -265,6 +307,10 @@ void ConnectionBase::createLooper(ConfigOpts& configOpts)
 {
     assert(m_sysInfo && !m_looper);
     m_looper = std::make_unique<Looper>(configOpts, *this);
+    for(int i = 1; i < configOpts.io_threads; ++i)
+    {
+        m_loopers.emplace_back(std::make_unique<Looper>(configOpts, *this, m_looper.get()));
+    }
     m_looperReady = true;
 }
 
@@ -293,6 +339,11 @@ void ConnectionBase::bindConnectionManagers()
         cm->enableRouting();
         checkRoutes(*cm);
         cm->bind(getLooper());
+        if(!cm->shardable()) continue;
+        for(auto& looper : m_loopers)
+        {
+            cm->bind(*looper);
+        }
     }
 }
 
@@ -313,11 +364,28 @@ void ConnectionBase::checkRoutes(graft::ConnectionManager& cm)
 }
 
 
-Looper::Looper(const ConfigOpts& copts, ConnectionBase& connectionBase)
-    : TaskManager(copts, connectionBase.getSysInfoCounter())
+Looper::Looper(const ConfigOpts& copts, ConnectionBase& connectionBase, Looper* primary)
+    : TaskManager(copts, connectionBase.getSysInfoCounter(), primary)
     , m_mgr(std::make_unique<mg_mgr>())
+    , m_connectionBase(connectionBase)
 {
-    mg_mgr_init(m_mgr.get(), &connectionBase, cb_event);
+    mg_mgr_init(m_mgr.get(), this, cb_event);
+    if(copts.io_backend == "epoll")
+    {
+#ifdef GN_ENABLE_EPOLL
+        mg::mg_mgr_use_epoll_x(m_mgr.get(), cb_event);
+        m_epoll = true;
+#else
+        throw exit_error("The server is built without epoll support, use io-backend=select");
+#endif
+    }
+}
+
+Looper* Looper::from(mg_mgr* mgr)
+{
+    void* user_data = getUserData(mgr);
+    assert(user_data);
+    return static_cast<Looper*>(user_data);
 }
 
 
@@ -331,15 +399,21 @@ void Looper::serve()
     setIOThread(true);
 
     m_ready = true;
+    int timeout = pollTimeout();
     for (;;)
     {
-        mg_mgr_poll(m_mgr.get(), m_copts.timer_poll_interval_ms);
-        getTimerList().eval();
+        mg_mgr_poll(m_mgr.get(), timeout);
+        size_t fired = getTimers().eval();
         checkUpstreamBlockingIO();
+        checkUpstreamAsyncIO();
         checkPeriodicTaskIO();
+        checkForeignResumeIO();
         executePostponedTasks();
         expelWorkers();
         if( stopped() && (m_forceStop || canStop()) ) break;
+        //deadlines added from other threads wake the loop by notifyJobReady, the ones added in this thread
+        //are taken into account here; fired timers can close connections, mongoose should process it without waiting
+        timeout = (fired)? 0 : pollTimeout();
     }
 
     setIOThread(false);
@@ -356,12 +430,19 @@ void Looper::stop(bool force)
 
 void Looper::notifyJobReady()
 {
+#ifdef GN_ENABLE_EPOLL
+    if(m_epoll)
+    {
+        mg::mg_notify_epoll_x(m_mgr.get());
+        return;
+    }
+#endif
     mg_notify(m_mgr.get());
 }
 
 void Looper::cb_event(mg_mgr *mgr, uint64_t cnt)
 {
-    TaskManager& tm = ConnectionBase::from(mgr)->getLooper();
+    TaskManager& tm = *Looper::from(mgr);
     tm.cb_event(cnt);
 }
 
@@ -378,7 +459,7 @@ void ConnectionManager::ev_handler_empty(mg_connection *client, int ev, void *ev
 void ConnectionManager::ev_handler(ClientTask* ct, mg_connection *client, int ev, void *ev_data)
 {
     assert(ct->m_client == client);
-    assert(&ct->getManager() == &ConnectionBase::from(client->mgr)->getLooper());
+    assert(&ct->getManager() == Looper::from(client->mgr));
     switch (ev)
     {
     case MG_EV_CLOSE:
@@ -399,7 +480,8 @@ void HttpConnectionManager::bind(Looper& looper)
 
     const ConfigOpts& opts = looper.getCopts();
 
-    mg_connection *nc_http = mg_bind(mgr, opts.http_address.c_str(), ev_handler_http);
+    mg_connection *nc_http = (opts.io_threads == 1)? mg_bind(mgr, opts.http_address.c_str(), ev_handler_http)
+                                                   : mg::mg_bind_reuseport_x(mgr, opts.http_address.c_str(), ev_handler_http);
     if(!nc_http)
     {
         std::ostringstream oss;
@@ -459,93 +541,242 @@ CoapConnectionManager* CoapConnectionManager::from_accepted(mg_connection* cn)
     return static_cast<CoapConnectionManager*>(cm);
 }
 
-void HttpConnectionManager::ev_handler_http(mg_connection *client, int ev, void *ev_data)
+HttpConnectionManager::ClientState* HttpConnectionManager::state(mg_connection* client)
 {
-    ConnectionBase* conBase = ConnectionBase::from(client->mgr);
+    assert(client->user_data);
+    return static_cast<ClientState*>(client->user_data);
+}
+
+void HttpConnectionManager::setIdleTimer(mg_connection* client)
+{
+    Looper* looper = Looper::from(client->mgr);
+    ClientState* cs = state(client);
+    TimingWheel& timers = looper->getTimers();
+    timers.cancel(cs->timer);
+    std::chrono::milliseconds timeout(static_cast<int64_t>(looper->getCopts().http_connection_timeout * 1000));
+    cs->timer = timers.add(timeout, [client]
+    {
+        LOG_PRINT_CLN(1,client,"Client timeout; closing connection");
+        state(client)->closing = true; //without this we will get MG_EV_HTTP_REQUEST
+        mg::mg_set_flags_x(client, MG_F_CLOSE_IMMEDIATELY);
+    });
+}
 
+void HttpConnectionManager::ev_handler_http(mg_connection *client, int ev, void *ev_data)
+{
     switch (ev)
     {
     case MG_EV_HTTP_REQUEST:
     {
-        conBase->getLooper().runtimeSysInfo().count_http_request_total();
+        ClientState* cs = state(client);
+        if(cs->closing) break;
 
-        mg_set_timer(client, 0);
+        Looper::from(client->mgr)->getTimers().cancel(cs->timer);
+        onRequest(client, static_cast<http_message*>(ev_data));
+        processPipeline(client);
+        break;
+    }
+    case MG_EV_ACCEPT:
+    {
+        Looper* looper = Looper::from(client->mgr);
+        if(!looper->getConnectionBase().getBlackList().processIp( client->sa.sin.sin_addr.s_addr ))
+        {
+            LOG_PRINT_CLN(2,client,"The address is in the black-list; closing connection");
+            client->user_data = nullptr;
+            mg::mg_set_flags_x(client, MG_F_CLOSE_IMMEDIATELY);
+            break;
+        }
+        //user_data of the accepted connection is inherited from the listening one
+        client->user_data = new ClientState(HttpConnectionManager::from_accepted(client));
+        setIdleTimer(client);
+        break;
+    }
+    case MG_EV_CLOSE:
+    {
+        if(client->flags & MG_F_LISTENING) break;
+        if(!client->user_data) break; //closed by the black-list
+        ClientState* cs = state(client);
+        Looper::from(client->mgr)->getTimers().cancel(cs->timer);
+        if(cs->task)
+        {//the task is not completed yet, it will not respond
+            cs->task->m_client = nullptr;
+        }
+        client->user_data = nullptr;
+        delete cs;
+        break;
+    }
+    default:
+        break;
+    }
+}
 
-        struct http_message *hm = (struct http_message *) ev_data;
+void HttpConnectionManager::onRequest(mg_connection *client, http_message *hm)
+{
+    Looper* looper = Looper::from(client->mgr);
+    ClientState* cs = state(client);
 
-        conBase->getLooper().runtimeSysInfo().count_http_req_bytes_raw(hm->message.len);
+    looper->runtimeSysInfo().count_http_request_total();
+    looper->runtimeSysInfo().count_http_req_bytes_raw(hm->message.len);
 
-        std::string uri(hm->uri.p, hm->uri.len);
+    std::string uri(hm->uri.p, hm->uri.len);
 
-        int method = translateMethod(hm->method.p, hm->method.len);
-        if (method < 0) return;
+    int method = translateMethod(hm->method.p, hm->method.len);
+    if (method < 0)
+    {//the request is answered in its turn, the rest of the pipeline cannot be trusted
+        LOG_PRINT_CLN(1,client,"Unknown HTTP method " << std::string(hm->method.p, hm->method.len));
+        cs->closing = true;
+        Request req;
+        req.routed = false;
+        req.keepAlive = false;
+        req.errorCode = 501;
+        req.errorMessage = "method not implemented";
+        cs->pipeline.emplace_back(std::move(req));
+        return;
+    }
 
-        const sockaddr_in& remote_address = client->sa.sin;
-        uint16_t remote_port = static_cast<uint16_t>(remote_address.sin_port);
-        char remote_address_host_str[INET_ADDRSTRLEN];
-        if (!inet_ntop(AF_INET, &(remote_address.sin_addr), remote_address_host_str, sizeof remote_address_host_str))
-            *remote_address_host_str = '\0';
+    const sockaddr_in& remote_address = client->sa.sin;
+    uint16_t remote_port = static_cast<uint16_t>(remote_address.sin_port);
+    char remote_address_host_str[INET_ADDRSTRLEN];
+    if (!inet_ntop(AF_INET, &(remote_address.sin_addr), remote_address_host_str, sizeof remote_address_host_str))
+        *remote_address_host_str = '\0';
 
-        std::string s_method(hm->method.p, hm->method.len);
-        LOG_PRINT_CLN(1,client,"New HTTP client. uri:" << std::string(hm->uri.p, hm->uri.len) << " method:" << s_method
-            << " remote: " << remote_address_host_str << ":" << remote_port);
+    std::string s_method(hm->method.p, hm->method.len);
+    LOG_PRINT_CLN(1,client,"New HTTP client. uri:" << std::string(hm->uri.p, hm->uri.len) << " method:" << s_method
+        << " remote: " << remote_address_host_str << ":" << remote_port);
 
-        HttpConnectionManager* httpcm = HttpConnectionManager::from_accepted(client);
-        Router::JobParams prms;
-        if (httpcm->matchRoute(uri, method, prms))
-        {
-            conBase->getLooper().runtimeSysInfo().count_http_request_routed();
+    //HTTP/1.1 is persistent by default, HTTP/1.0 requires explicit keep-alive
+    bool keepAlive = (mg_vcmp(&hm->proto, "HTTP/1.1") == 0);
+    if(mg_str* connection = mg_get_http_header(hm, "Connection"))
+    {
+        if(mg_vcasecmp(connection, "close") == 0) keepAlive = false;
+        else if(mg_vcasecmp(connection, "keep-alive") == 0) keepAlive = true;
+    }
+    int maxRequests = looper->getCopts().http_keep_alive_max_requests;
+    if(maxRequests <= ++cs->requests) keepAlive = false;
+    if(!keepAlive) cs->closing = true;
+
+    Request req;
+    req.keepAlive = keepAlive;
+    req.routed = cs->manager->matchRoute(uri, method, req.params);
+    if (req.routed)
+    {
+        looper->runtimeSysInfo().count_http_request_routed();
 
-            mg_str& body = hm->body;
-            prms.input = Input(*hm, client_host(client));
+        mg_str& body = hm->body;
+        req.params.input = Input(*hm, client_host(client), mg::mg_take_message_x(client, *hm));
 
-            prms.input.port = remote_port;
+        req.params.input.port = remote_port;
 
-            LOG_PRINT_CLN(2,client,"Matching Route found; body = " << std::string(body.p, body.len));
-            BaseTask* bt = BaseTask::Create<ClientTask>(httpcm, client, prms).get();
-            assert(dynamic_cast<ClientTask*>(bt));
-            ClientTask* ptr = static_cast<ClientTask*>(bt);
+        LOG_PRINT_CLN(2,client,"Matching Route found; body = " << std::string(body.p, body.len));
+    }
+    else
+    {
+        looper->runtimeSysInfo().count_http_request_unrouted();
+        LOG_PRINT_CLN(2,client,"Matching Route not found");
+    }
+    cs->pipeline.emplace_back(std::move(req));
+}
 
-            client->user_data = ptr;
-            client->handler = static_ev_handler<ClientTask>;
+void HttpConnectionManager::processPipeline(mg_connection *client)
+{
+    ClientState* cs = state(client);
+    //the function can be called recursively from respond
+    if(cs->processing) return;
+    cs->processing = true;
 
-            conBase->getLooper().onNewClient(ptr->getSelf());
-        }
-        else
-        {
-            conBase->getLooper().runtimeSysInfo().count_http_request_unrouted();
+    Looper* looper = Looper::from(client->mgr);
+    while(!cs->task && !cs->pipeline.empty())
+    {
+        Request req = std::move(cs->pipeline.front());
+        cs->pipeline.pop_front();
 
-            LOG_PRINT_CLN(2,client,"Matching Route not found; closing connection");
-            mg_http_send_error(client, 500, "invalid parameter");
-            client->flags |= MG_F_SEND_AND_CLOSE;
+        if(!req.routed)
+        {
+            send(client, req.errorCode, req.errorMessage, "text/plain", req.keepAlive);
+            continue;
         }
-        break;
+
+        BaseTask* bt = BaseTask::Create<ClientTask>(cs->manager, client, std::move(req.params)).get();
+        assert(dynamic_cast<ClientTask*>(bt));
+        ClientTask* ptr = static_cast<ClientTask*>(bt);
+        ptr->m_keepAlive = req.keepAlive;
+        cs->task = ptr;
+
+        looper->onNewClient(ptr->getSelf());
     }
-    case MG_EV_ACCEPT:
+    //the requests queued before the one that closes the connection are answered, no requests are queued after it;
+    //the last response closes the connection
+    if(!cs->closing && !cs->task)
+    {//wait for the next request
+        setIdleTimer(client);
+    }
+
+    cs->processing = false;
+}
+
+namespace
+{
+
+const char* statusMessage(int code)
+{
+    switch(code)
     {
-        if(!conBase->getBlackList().processIp( client->sa.sin.sin_addr.s_addr ))
-        {
-            LOG_PRINT_CLN(2,client,"The address is in the black-list; closing connection");
-            client->flags |= MG_F_CLOSE_IMMEDIATELY;
-            break;
-        }
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
 
-        const ConfigOpts& opts = conBase->getLooper().getCopts();
+} //namespace
 
-        mg_set_timer(client, mg_time() + opts.http_connection_timeout);
-        break;
+void HttpConnectionManager::send(mg_connection *client, int code, std::string&& s, const char* contentType, bool keepAlive)
+{
+    std::ostringstream oss;
+    oss << "HTTP/1.1 " << code << ' ' << statusMessage(code)
+        << "\r\nContent-Type: " << contentType
+        << ((keepAlive)? "\r\nConnection: keep-alive" : "\r\nConnection: close")
+        << "\r\nContent-Length: " << s.size() << "\r\n\r\n";
+    //the header block and the body are written together, the body is kept by the connection until it is written
+    mg::mg_send_x(client, oss.str(), std::move(s));
+    if(!keepAlive) mg::mg_set_flags_x(client, MG_F_SEND_AND_CLOSE);
+}
+
+void HttpConnectionManager::respond(ClientTask* ct, std::string&& s)
+{
+    if(ct->m_client == nullptr)
+    {//it is possible that a client has closed connection already
+        if(ct->getLastStatus() != Status::Again)
+            ct->getManager().onClientDone(ct->getSelf());
+        return;
     }
-    case MG_EV_TIMER:
+
+    int code = responseCode(ct);
+    auto& rsi = ct->getManager().runtimeSysInfo();
+
+    mg_connection* client = ct->m_client;
+    LOG_PRINT_CLN(2, client, "Reply to client: " << s);
+    if(Status::Ok == ct->getCtx().local.getLastStatus())
     {
-        LOG_PRINT_CLN(1,client,"Client timeout; closing connection");
-        mg_set_timer(client, 0);
-        client->handler = ev_handler_empty; //without this we will get MG_EV_HTTP_REQUEST
-        client->flags |= MG_F_CLOSE_IMMEDIATELY;
-        break;
+        rsi.count_http_resp_bytes_raw(s.size());
+        send(client, code, std::move(s), "application/json", ct->m_keepAlive);
     }
-    default:
-        break;
+    else
+    {
+        send(client, code, std::move(s), "text/plain", ct->m_keepAlive);
     }
+
+    LOG_PRINT_CLN(2, client, "Client request finished with result " << ct->getStrStatus());
+    if(ct->getLastStatus() != Status::Again)
+        ct->getManager().onClientDone(ct->getSelf());
+    ct->m_client = nullptr;
+
+    ClientState* cs = state(client);
+    assert(cs->task == ct);
+    cs->task = nullptr;
+    processPipeline(client);
 }
 
 void CoapConnectionManager::ev_handler_coap(mg_connection *client, int ev, void *ev_data)
@@ -584,15 +815,14 @@ void CoapConnectionManager::ev_handler_coap(mg_connection *client, int ev, void
             mg_str& body = cm->payload;
             prms.input.load(body.p, body.len);
 
-            BaseTask* rb_ptr = BaseTask::Create<ClientTask>(coapcm, client, prms).get();
+            BaseTask* rb_ptr = BaseTask::Create<ClientTask>(coapcm, client, std::move(prms)).get();
             assert(dynamic_cast<ClientTask*>(rb_ptr));
             ClientTask* ptr = static_cast<ClientTask*>(rb_ptr);
 
             client->user_data = ptr;
             client->handler = static_ev_handler<ClientTask>;
 
-            ConnectionBase* conBase = ConnectionBase::from(client->mgr);
-            conBase->getLooper().onNewClient(ptr->getSelf());
+            Looper::from(client->mgr)->onNewClient(ptr->getSelf());
         }
         break;
     }
@@ -604,20 +834,12 @@ void CoapConnectionManager::ev_handler_coap(mg_connection *client, int ev, void
     }
 }
 
-void ConnectionManager::respond(ClientTask* ct, const std::string& s)
+int ConnectionManager::responseCode(ClientTask* ct)
 {
-    if(ct->m_client == nullptr)
-    {//it is possible that a client has closed connection already
-        if(ct->getLastStatus() != Status::Again)
-            ct->getManager().onClientDone(ct->getSelf());
-        return;
-    }
-
     int code = 0;
-    auto& ctx = ct->getCtx();
     auto& rsi = ct->getManager().runtimeSysInfo();
 
-    switch(ctx.local.getLastStatus())
+    switch(ct->getCtx().local.getLastStatus())
     {
         case Status::Again:
         case Status::Ok:              { code = 200; rsi.count_http_resp_status_ok(); }    break;
@@ -627,6 +849,21 @@ void ConnectionManager::respond(ClientTask* ct, const std::string& s)
         case Status::Drop:            { code = 400; rsi.count_http_resp_status_drop(); }  break;
         default:                      assert(false);                                      break;
     }
+    return code;
+}
+
+void ConnectionManager::respond(ClientTask* ct, std::string&& s)
+{
+    if(ct->m_client == nullptr)
+    {//it is possible that a client has closed connection already
+        if(ct->getLastStatus() != Status::Again)
+            ct->getManager().onClientDone(ct->getSelf());
+        return;
+    }
+
+    int code = responseCode(ct);
+    auto& ctx = ct->getCtx();
+    auto& rsi = ct->getManager().runtimeSysInfo();
 
     auto& client = ct->m_client;
     LOG_PRINT_CLN(2, client, "Reply to client: " << s);
@@ -642,7 +879,7 @@ void ConnectionManager::respond(ClientTask* ct, const std::string& s)
     }
 
     LOG_PRINT_CLN(2, client, "Client request finished with result " << ct->getStrStatus());
-    client->flags |= MG_F_SEND_AND_CLOSE;
+    mg::mg_set_flags_x(client, MG_F_SEND_AND_CLOSE);
     if(ct->getLastStatus() != Status::Again)
         ct->getManager().onClientDone(ct->getSelf());
     client->handler = static_empty_ev_handler;
@@ -1,9 +1,16 @@
 
 #include "lib/graft/context.h"
+#include "lib/graft/fan_out.h"
 
 #include "supernode/requestdefines.h"
 
 namespace graft {
 
+FanOut& Context::fanOut()
+{
+    if(!m_fanOut) m_fanOut = std::make_shared<FanOut>();
+    return *m_fanOut;
+}
+
 }
 
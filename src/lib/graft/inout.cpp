@@ -20,10 +20,9 @@ void InOutHttpBase::set_str_field(const http_message& hm, const mg_str& str_fld,
     }
 }
 
-InOutHttpBase& InOutHttpBase::operator = (const http_message& hm)
+void InOutHttpBase::assign(const http_message& hm)
 {
     //fill corresponding fields from hm
-    set_str_field(hm, hm.body, body);
     set_str_field(hm, hm.method, method);
     set_str_field(hm, hm.uri, uri);
     set_str_field(hm, hm.proto, proto);
@@ -41,7 +40,24 @@ InOutHttpBase& InOutHttpBase::operator = (const http_message& hm)
         if(h_n.p == nullptr) break;
         headers.push_back({std::string(h_n.p, h_n.len), std::string(h_v.p, h_v.len)});
     }
-    return *this;
+}
+
+InHttp::InHttp(const http_message& hm, const std::string& host_)
+    : InOutHttpBase(hm, host_)
+{
+    std::string s;
+    set_str_field(hm, hm.body, s);
+    body = std::move(s);
+}
+
+InHttp::InHttp(const http_message& hm, const std::string& host_, std::shared_ptr<const char> message)
+    : InOutHttpBase(hm, host_)
+{
+    assert(message);
+    if(hm.body.len == 0) return;
+    size_t off = hm.body.p - hm.message.p;
+    assert(off + hm.body.len <= hm.message.len);
+    body.share(message, std::string_view(message.get() + off, hm.body.len));
 }
 
 std::string InOutHttpBase::combine_headers()
@@ -1,6 +1,22 @@
 
 #include "lib/graft/mongoosex.h"
 
+#include <cassert>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#ifdef GN_ENABLE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <iterator>
+#include <vector>
+#endif
+
 extern "C" {
 
 mg_connection *mg_connect_http_base(
@@ -14,6 +30,25 @@ mg_connection *mg_connect_http_base(
 namespace mg
 {
 
+namespace
+{
+#ifdef GN_ENABLE_EPOLL
+//the connection is visited on the next poll of the epoll interface
+void epoll_touch(mg_connection *nc);
+//ev_timer_time of the connection is changed
+void epoll_set_timer(mg_connection *nc);
+//false if the connection is not of the epoll interface
+bool epoll_send_owned(mg_connection *nc, std::string&& head, std::string&& body);
+//true if the connection has owned output, MG_F_SEND_AND_CLOSE is set when it is written
+bool epoll_close_after_owned(mg_connection *nc);
+#else
+void epoll_touch(mg_connection *) { }
+void epoll_set_timer(mg_connection *) { }
+bool epoll_send_owned(mg_connection *, std::string&&, std::string&&) { return false; }
+bool epoll_close_after_owned(mg_connection *) { return false; }
+#endif
+} //namespace
+
 mg_connection *mg_send_http_opt_x(mg_connection *nc,
     mg_mgr *mgr, MG_CB(mg_event_handler_t ev_handler, void *user_data),
     mg_connect_opts opts, const char *url, const char *extra_headers,
@@ -56,6 +91,7 @@ mg_connection *mg_send_http_opt_x(mg_connection *nc,
               (auth.buf == NULL ? "" : auth.buf), extra_headers);
 
     mg_send(nc, post_data.c_str(), post_data.size());
+    epoll_touch(nc);
 
     mbuf_free(&auth);
     return nc;
@@ -72,4 +108,671 @@ mg_connection *mg_connect_http_x(mg_connection *nc,
                                  post_data);
 }
 
+mg_connection *mg_bind_reuseport_x(
+    mg_mgr *mgr, const char *address,
+    MG_CB(mg_event_handler_t ev_handler, void *user_data))
+{
+    mg_str host = MG_NULL_STR;
+    unsigned int port = 0;
+    if(mg_parse_uri(mg_mk_str(address), NULL, NULL, &host, &port, NULL, NULL, NULL) != 0 || port == 0)
+        return NULL;
+
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if(host.len == 0)
+    {
+        sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+    else
+    {
+        std::string s_host(host.p, host.len);
+        if(inet_pton(AF_INET, s_host.c_str(), &sa.sin_addr) != 1) return NULL;
+    }
+
+    sock_t sock = socket(AF_INET, SOCK_STREAM, 0);
+    if(sock == INVALID_SOCKET) return NULL;
+
+    int on = 1;
+    if(setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+            || setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0
+            || bind(sock, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0
+            || listen(sock, SOMAXCONN) != 0)
+    {
+        closesocket(sock);
+        return NULL;
+    }
+
+    mg_connection *nc = mg_add_sock(mgr, sock, MG_CB(ev_handler, user_data));
+    if(nc == NULL)
+    {
+        closesocket(sock);
+        return NULL;
+    }
+    nc->sa.sin = sa;
+    nc->flags |= MG_F_LISTENING;
+    return nc;
+}
+
+std::shared_ptr<const char> mg_take_message_x(mg_connection *nc, const http_message& hm)
+{
+    mbuf& io = nc->recv_mbuf;
+    if(hm.message.p == io.buf && hm.message.len == io.len)
+    {
+        //mongoose removes the message from the buffer after the event, it does nothing with empty buffer
+        char* buf = io.buf;
+        mbuf_init(&io, 0);
+        return std::shared_ptr<const char>(buf, [](const char* p){ MG_FREE(const_cast<char*>(p)); });
+    }
+    char* buf = new char[hm.message.len];
+    memcpy(buf, hm.message.p, hm.message.len);
+    return std::shared_ptr<const char>(buf, std::default_delete<const char[]>());
+}
+
+void mg_send_iov_x(mg_connection *nc, const iovec *iov, int iovcnt)
+{
+    size_t sent = 0;
+    if(nc->send_mbuf.len == 0 && nc->sock != INVALID_SOCKET
+            && !(nc->flags & (MG_F_UDP | MG_F_CONNECTING | MG_F_SSL | MG_F_CLOSE_IMMEDIATELY)))
+    {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = const_cast<iovec*>(iov);
+        msg.msg_iovlen = iovcnt;
+        //on error the data is queued, mongoose will detect the error on the next send attempt
+        ssize_t n = sendmsg(nc->sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(0 < n)
+        {
+            sent = n;
+            nc->last_io_time = (time_t) mg_time();
+        }
+    }
+    for(int i = 0; i < iovcnt; ++i)
+    {
+        if(iov[i].iov_len <= sent)
+        {
+            sent -= iov[i].iov_len;
+            continue;
+        }
+        mg_send(nc, static_cast<const char*>(iov[i].iov_base) + sent, iov[i].iov_len - sent);
+        sent = 0;
+    }
+    if(nc->send_mbuf.len > 0) epoll_touch(nc);
+}
+
+void mg_send_x(mg_connection *nc, std::string&& head, std::string&& body)
+{
+    if(epoll_send_owned(nc, std::move(head), std::move(body))) return;
+    iovec iov[2] = { { &head[0], head.size() }, { &body[0], body.size() } };
+    mg_send_iov_x(nc, iov, (body.empty())? 1 : 2);
+}
+
+void mg_set_flags_x(mg_connection *nc, unsigned long flags)
+{
+    if((flags & MG_F_SEND_AND_CLOSE) && epoll_close_after_owned(nc)) flags &= ~MG_F_SEND_AND_CLOSE;
+    nc->flags |= flags;
+    epoll_touch(nc);
+}
+
+double mg_set_timer_x(mg_connection *nc, double timestamp)
+{
+    double old = nc->ev_timer_time;
+    nc->ev_timer_time = timestamp;
+    epoll_set_timer(nc);
+    return old;
+}
+
+#ifdef GN_ENABLE_EPOLL
+
+namespace
+{
+
+struct ConnData;
+class ConnList;
+
+constexpr size_t npos = size_t(-1);
+
+struct Link
+{
+    ConnList *list = NULL;
+    mg_connection *prev = NULL;
+    mg_connection *next = NULL;
+};
+
+//The data of the epoll interface for a connection, it is kept in mgr_data of the connection.
+struct ConnData
+{
+    //the connection is visited on the current or the next poll
+    Link ready;
+    //the position in the timer heap and ev_timer_time it is placed by
+    size_t heapIndex = npos;
+    double deadline = 0;
+    //UDP connections get MG_EV_POLL on every poll like with select, the DNS resolver of mongoose depends on it
+    Link polled;
+    //EPOLLOUT is in the event mask
+    bool out = false;
+    //The output taken by mg_send_x that the socket has not accepted yet, it follows send_mbuf.
+    //The strings are freed as they are written.
+    std::deque<std::string> owned;
+    size_t ownedOffset = 0;
+    //MG_F_SEND_AND_CLOSE is deferred until the owned output is written
+    bool closeAfterOwned = false;
+};
+
+ConnData* conn_data(mg_connection *nc)
+{
+    if(!nc->mgr_data) nc->mgr_data = new ConnData();
+    return static_cast<ConnData*>(nc->mgr_data);
+}
+
+//Intrusive list of connections, a connection is in one list per link at most.
+class ConnList
+{
+public:
+    explicit ConnList(Link ConnData::*link) : m_link(link) { }
+    ConnList(const ConnList&) = delete;
+    ConnList& operator = (const ConnList&) = delete;
+
+    bool empty() const { return m_head == NULL; }
+    mg_connection *front() const { return m_head; }
+    mg_connection *next(mg_connection *nc) const { return link(nc).next; }
+
+    void push_back(mg_connection *nc)
+    {
+        Link& l = link(nc);
+        assert(l.list == NULL);
+        l.list = this;
+        l.prev = m_tail;
+        l.next = NULL;
+        if(m_tail) link(m_tail).next = nc;
+        else m_head = nc;
+        m_tail = nc;
+    }
+
+    void erase(mg_connection *nc)
+    {
+        Link& l = link(nc);
+        assert(l.list == this);
+        if(l.prev) link(l.prev).next = l.next;
+        else m_head = l.next;
+        if(l.next) link(l.next).prev = l.prev;
+        else m_tail = l.prev;
+        l = Link();
+    }
+
+    void splice(ConnList& other)
+    {
+        while(!other.empty())
+        {
+            mg_connection *nc = other.front();
+            other.erase(nc);
+            push_back(nc);
+        }
+    }
+
+private:
+    Link& link(mg_connection *nc) const { return conn_data(nc)->*m_link; }
+
+    Link ConnData::*m_link;
+    mg_connection *m_head = NULL;
+    mg_connection *m_tail = NULL;
+};
+
+//Min-heap of connections by ev_timer_time, the earliest deadline is at the top.
+class TimerHeap
+{
+public:
+    bool empty() const { return m_heap.empty(); }
+    mg_connection *top() const { return m_heap.front(); }
+    static double deadline(mg_connection *nc) { return conn_data(nc)->deadline; }
+
+    //adds the connection or moves it to the new deadline
+    void set(mg_connection *nc, double deadline)
+    {
+        ConnData* cd = conn_data(nc);
+        double old = cd->deadline;
+        cd->deadline = deadline;
+        if(cd->heapIndex == npos)
+        {
+            cd->heapIndex = m_heap.size();
+            m_heap.push_back(nc);
+            up(cd->heapIndex);
+        }
+        else if(deadline < old) up(cd->heapIndex);
+        else down(cd->heapIndex);
+    }
+
+    void erase(mg_connection *nc)
+    {
+        ConnData* cd = conn_data(nc);
+        size_t i = cd->heapIndex;
+        assert(i != npos);
+        cd->heapIndex = npos;
+        cd->deadline = 0;
+        mg_connection *last = m_heap.back();
+        m_heap.pop_back();
+        if(i == m_heap.size()) return;
+        place(i, last);
+        up(i);
+        down(conn_data(last)->heapIndex);
+    }
+
+private:
+    void place(size_t i, mg_connection *nc)
+    {
+        m_heap[i] = nc;
+        conn_data(nc)->heapIndex = i;
+    }
+
+    void up(size_t i)
+    {
+        mg_connection *nc = m_heap[i];
+        while(0 < i && deadline(nc) < deadline(m_heap[(i - 1) / 2]))
+        {
+            place(i, m_heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, nc);
+    }
+
+    void down(size_t i)
+    {
+        mg_connection *nc = m_heap[i];
+        for(;;)
+        {
+            size_t c = 2 * i + 1;
+            if(m_heap.size() <= c) break;
+            if(c + 1 < m_heap.size() && deadline(m_heap[c + 1]) < deadline(m_heap[c])) ++c;
+            if(!(deadline(m_heap[c]) < deadline(nc))) break;
+            place(i, m_heap[c]);
+            i = c;
+        }
+        place(i, nc);
+    }
+
+    std::vector<mg_connection*> m_heap;
+};
+
+struct EpollData
+{
+    int epfd = -1;
+    int notifyfd = -1;
+    epoll_notify_cb_t cb = nullptr;
+    std::vector<epoll_event> events = std::vector<epoll_event>(1024);
+    ConnList ready{&ConnData::ready};
+    TimerHeap timers;
+    ConnList polled{&ConnData::polled};
+    //the connection in mg_if_poll, it is reset if the connection is closed
+    mg_connection *visiting = NULL;
+};
+
+const mg_iface_vtable* s_base_vtable = nullptr;
+mg_iface_vtable s_epoll_vtable;
+
+EpollData* epoll_data(mg_iface *iface)
+{
+    return static_cast<EpollData*>(iface->data);
+}
+
+void epoll_mark(EpollData* data, mg_connection *nc)
+{
+    if(!conn_data(nc)->ready.list) data->ready.push_back(nc);
+}
+
+void epoll_touch(mg_connection *nc)
+{
+    if(nc->iface == NULL || nc->iface->vtable != &s_epoll_vtable) return;
+    epoll_mark(epoll_data(nc->iface), nc);
+}
+
+void epoll_sync_timer(EpollData* data, mg_connection *nc);
+
+void epoll_set_timer(mg_connection *nc)
+{
+    if(nc->iface == NULL || nc->iface->vtable != &s_epoll_vtable) return;
+    epoll_sync_timer(epoll_data(nc->iface), nc);
+}
+
+uint32_t epoll_events(const ConnData* cd)
+{
+    return EPOLLIN | EPOLLRDHUP | EPOLLET | (cd->out ? uint32_t(EPOLLOUT) : 0u);
+}
+
+void epoll_watch(mg_connection *nc)
+{
+    if(nc->sock == INVALID_SOCKET) return;
+    EpollData* data = epoll_data(nc->iface);
+    ConnData* cd = conn_data(nc);
+    //EPOLLOUT is armed to wait for the connect and for the output that the socket has not taken
+    cd->out = (nc->flags & MG_F_CONNECTING) || nc->send_mbuf.len > 0 || !cd->owned.empty();
+    epoll_event ev;
+    ev.events = epoll_events(cd);
+    ev.data.ptr = nc;
+    epoll_ctl(data->epfd, EPOLL_CTL_ADD, nc->sock, &ev);
+    if((nc->flags & MG_F_UDP) && !cd->polled.list) data->polled.push_back(nc);
+    epoll_mark(data, nc);
+}
+
+void epoll_unwatch(mg_connection *nc)
+{
+    if(nc->sock == INVALID_SOCKET) return;
+    epoll_ctl(epoll_data(nc->iface)->epfd, EPOLL_CTL_DEL, nc->sock, NULL);
+}
+
+//places the connection in the timer heap by ev_timer_time
+void epoll_sync_timer(EpollData* data, mg_connection *nc)
+{
+    ConnData* cd = conn_data(nc);
+    if(nc->ev_timer_time == cd->deadline) return;
+    if(0 < nc->ev_timer_time) data->timers.set(nc, nc->ev_timer_time);
+    else data->timers.erase(nc);
+}
+
+//updates EPOLLOUT and the lists of the connection after it has been visited
+void epoll_update(EpollData* data, mg_connection *nc)
+{
+    ConnData* cd = conn_data(nc);
+    bool out = (nc->flags & MG_F_CONNECTING)
+            || ((nc->send_mbuf.len > 0 || !cd->owned.empty()) && !(nc->flags & MG_F_LISTENING));
+    if(out != cd->out && nc->sock != INVALID_SOCKET)
+    {
+        cd->out = out;
+        epoll_event ev;
+        ev.events = epoll_events(cd);
+        ev.data.ptr = nc;
+        //the edge is reported at once if the socket is writable already
+        epoll_ctl(data->epfd, EPOLL_CTL_MOD, nc->sock, &ev);
+    }
+    epoll_sync_timer(data, nc);
+    //the flags set by the handlers during the visit are processed on the next poll
+    if((nc->flags & MG_F_CLOSE_IMMEDIATELY) || ((nc->flags & MG_F_SEND_AND_CLOSE) && nc->send_mbuf.len == 0))
+        epoll_mark(data, nc);
+}
+
+void epoll_if_free(mg_iface *iface)
+{
+    EpollData* data = epoll_data(iface);
+    close(data->notifyfd);
+    close(data->epfd);
+    delete data;
+    iface->data = NULL;
+    s_base_vtable->free(iface);
+}
+
+void epoll_if_sock_set(mg_connection *nc, sock_t sock)
+{
+    epoll_unwatch(nc);
+    s_base_vtable->sock_set(nc, sock);
+    epoll_watch(nc);
+}
+
+int epoll_if_listen_tcp(mg_connection *nc, union socket_address *sa)
+{
+    int res = s_base_vtable->listen_tcp(nc, sa);
+    if(res == 0) epoll_watch(nc);
+    return res;
+}
+
+int epoll_if_listen_udp(mg_connection *nc, union socket_address *sa)
+{
+    int res = s_base_vtable->listen_udp(nc, sa);
+    if(res == 0) epoll_watch(nc);
+    return res;
+}
+
+void epoll_if_connect_tcp(mg_connection *nc, const union socket_address *sa)
+{
+    s_base_vtable->connect_tcp(nc, sa);
+    epoll_watch(nc);
+}
+
+void epoll_if_connect_udp(mg_connection *nc)
+{
+    s_base_vtable->connect_udp(nc);
+    epoll_watch(nc);
+}
+
+void epoll_if_destroy_conn(mg_connection *nc)
+{
+    EpollData* data = epoll_data(nc->iface);
+    if(ConnData* cd = static_cast<ConnData*>(nc->mgr_data))
+    {
+        if(cd->ready.list) cd->ready.list->erase(nc);
+        if(cd->heapIndex != npos) data->timers.erase(nc);
+        if(cd->polled.list) cd->polled.list->erase(nc);
+        delete cd;
+        nc->mgr_data = NULL;
+    }
+    if(data->visiting == nc) data->visiting = NULL;
+    epoll_unwatch(nc);
+    s_base_vtable->destroy_conn(nc);
+}
+
+void epoll_accept(mg_connection *lc)
+{
+    for(;;)
+    {
+        union socket_address sa;
+        socklen_t sa_len = sizeof(sa);
+        sock_t sock = accept4(lc->sock, &sa.sa, &sa_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(sock == INVALID_SOCKET) break; //EAGAIN, the backlog is drained
+        mg_connection *nc = mg_if_accept_new_conn(lc);
+        if(nc == NULL)
+        {
+            closesocket(sock);
+            continue;
+        }
+        nc->iface->vtable->sock_set(nc, sock);
+        mg_if_accept_tcp_cb(nc, &sa, sa_len);
+    }
+}
+
+//writes send_mbuf, then the owned output
+void epoll_send(mg_connection *nc)
+{
+    if(nc->flags & MG_F_CLOSE_IMMEDIATELY) return;
+    if(nc->send_mbuf.len > 0) mg_if_can_send_cb(nc);
+    ConnData* cd = conn_data(nc);
+    while(!cd->owned.empty() && nc->send_mbuf.len == 0 && !(nc->flags & MG_F_CLOSE_IMMEDIATELY))
+    {
+        iovec iov[16];
+        size_t iovcnt = 0;
+        size_t offset = cd->ownedOffset;
+        for(auto it = cd->owned.begin(); it != cd->owned.end() && iovcnt < std::size(iov); ++it, offset = 0)
+        {
+            iov[iovcnt++] = { &(*it)[offset], it->size() - offset };
+        }
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(nc->sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(n < 0)
+        {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            break;
+        }
+        nc->last_io_time = (time_t) mg_time();
+        for(size_t left = n; left > 0; )
+        {
+            size_t rest = cd->owned.front().size() - cd->ownedOffset;
+            if(left < rest)
+            {
+                cd->ownedOffset += left;
+                break;
+            }
+            left -= rest;
+            cd->owned.pop_front();
+            cd->ownedOffset = 0;
+        }
+    }
+    if(cd->owned.empty() && cd->closeAfterOwned)
+    {
+        cd->closeAfterOwned = false;
+        nc->flags |= MG_F_SEND_AND_CLOSE;
+    }
+}
+
+bool epoll_send_owned(mg_connection *nc, std::string&& head, std::string&& body)
+{
+    if(nc->iface == NULL || nc->iface->vtable != &s_epoll_vtable || nc->sock == INVALID_SOCKET
+            || (nc->flags & (MG_F_UDP | MG_F_SSL)))
+        return false;
+    ConnData* cd = conn_data(nc);
+    cd->owned.push_back(std::move(head));
+    if(!body.empty()) cd->owned.push_back(std::move(body));
+    //mongoose is not called here, it can be a handler of the connection
+    if(!cd->out && nc->send_mbuf.len == 0 && !(nc->flags & MG_F_CONNECTING)) epoll_send(nc);
+    //EPOLLOUT is armed on the visit if the socket has not taken all
+    if(!cd->owned.empty()) epoll_touch(nc);
+    return true;
+}
+
+bool epoll_close_after_owned(mg_connection *nc)
+{
+    if(nc->iface == NULL || nc->iface->vtable != &s_epoll_vtable) return false;
+    ConnData* cd = conn_data(nc);
+    if(cd->owned.empty()) return false;
+    cd->closeAfterOwned = true;
+    return true;
+}
+
+void epoll_handle_event(mg_connection *nc, uint32_t events)
+{
+    if(nc->flags & MG_F_CONNECTING)
+    {
+        if(!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if(getsockopt(nc->sock, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+        mg_if_connect_cb(nc, err);
+        return;
+    }
+    if((nc->flags & MG_F_LISTENING) && !(nc->flags & MG_F_UDP))
+    {
+        if(events & EPOLLIN) epoll_accept(nc);
+        return;
+    }
+    //read even on EPOLLHUP/EPOLLRDHUP to get the rest of the data and the close notification
+    if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) mg_if_can_recv_cb(nc);
+    if(events & EPOLLOUT) epoll_send(nc);
+}
+
+void epoll_visit(EpollData* data, mg_connection *nc, double now)
+{
+    //the output queued since the last poll is tried at once, EPOLLOUT is armed if the socket does not take all of it
+    if(!conn_data(nc)->out && !(nc->flags & (MG_F_CONNECTING | MG_F_LISTENING))) epoll_send(nc);
+    data->visiting = nc;
+    mg_if_poll(nc, now);
+    if(data->visiting != nc) return; //closed
+    data->visiting = NULL;
+    epoll_update(data, nc);
+}
+
+time_t epoll_if_poll(mg_iface *iface, int timeout_ms)
+{
+    mg_mgr *mgr = iface->mgr;
+    EpollData* data = epoll_data(iface);
+
+    if(!data->ready.empty())
+    {
+        timeout_ms = 0;
+    }
+    else if(!data->timers.empty())
+    {//like the select based interface, do not sleep past the earliest connection timer
+        double timer_timeout_ms = (TimerHeap::deadline(data->timers.top()) - mg_time()) * 1000 + 1;
+        if(timer_timeout_ms < timeout_ms) timeout_ms = std::max(0, static_cast<int>(timer_timeout_ms));
+    }
+
+    int n = epoll_wait(data->epfd, data->events.data(), data->events.size(), timeout_ms);
+    double now = mg_time();
+
+    for(int i = 0; i < n; ++i)
+    {
+        epoll_event& ev = data->events[i];
+        if(ev.data.ptr == NULL)
+        {//notification
+            uint64_t cnt = 0;
+            if(read(data->notifyfd, &cnt, sizeof(cnt)) == sizeof(cnt) && data->cb) data->cb(mgr, cnt);
+            continue;
+        }
+        mg_connection *nc = static_cast<mg_connection*>(ev.data.ptr);
+        epoll_handle_event(nc, ev.events);
+        epoll_mark(data, nc);
+    }
+    if(n == static_cast<int>(data->events.size())) data->events.resize(2*n);
+
+    //Only the connections that have something to do are visited: the ones with events, due timers, output
+    //or close flags set outside of their handlers, and UDP ones. The rest are not touched whatever their number is.
+    while(!data->timers.empty() && TimerHeap::deadline(data->timers.top()) <= now)
+    {//the timer is placed again after the visit if it is not fired
+        mg_connection *nc = data->timers.top();
+        data->timers.erase(nc);
+        epoll_mark(data, nc);
+    }
+    for(mg_connection *nc = data->polled.front(); nc != NULL; nc = data->polled.next(nc))
+    {
+        epoll_mark(data, nc);
+    }
+    //the connections marked during the visits are visited on the next poll
+    ConnList visiting(&ConnData::ready);
+    visiting.splice(data->ready);
+    while(!visiting.empty())
+    {
+        mg_connection *nc = visiting.front();
+        visiting.erase(nc);
+        epoll_visit(data, nc, now);
+    }
+
+    return static_cast<time_t>(now);
+}
+
+} //namespace
+
+void mg_mgr_use_epoll_x(mg_mgr *mgr, epoll_notify_cb_t cb)
+{
+    assert(mgr->active_connections == NULL);
+    mg_iface *iface = mgr->ifaces[MG_MAIN_IFACE];
+    if(!s_base_vtable)
+    {
+        s_base_vtable = iface->vtable;
+        s_epoll_vtable = *s_base_vtable;
+        s_epoll_vtable.free = epoll_if_free;
+        s_epoll_vtable.poll = epoll_if_poll;
+        s_epoll_vtable.sock_set = epoll_if_sock_set;
+        s_epoll_vtable.listen_tcp = epoll_if_listen_tcp;
+        s_epoll_vtable.listen_udp = epoll_if_listen_udp;
+        s_epoll_vtable.connect_tcp = epoll_if_connect_tcp;
+        s_epoll_vtable.connect_udp = epoll_if_connect_udp;
+        s_epoll_vtable.destroy_conn = epoll_if_destroy_conn;
+    }
+    assert(iface->vtable == s_base_vtable && iface->data == NULL);
+
+    EpollData* data = new EpollData();
+    data->epfd = epoll_create1(EPOLL_CLOEXEC);
+    data->notifyfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    data->cb = cb;
+    assert(0 <= data->epfd && 0 <= data->notifyfd);
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    epoll_ctl(data->epfd, EPOLL_CTL_ADD, data->notifyfd, &ev);
+
+    iface->data = data;
+    iface->vtable = &s_epoll_vtable;
+}
+
+void mg_notify_epoll_x(mg_mgr *mgr)
+{
+    mg_iface *iface = mgr->ifaces[MG_MAIN_IFACE];
+    assert(iface->vtable == &s_epoll_vtable);
+    uint64_t one = 1;
+    ssize_t res = write(epoll_data(iface)->notifyfd, &one, sizeof(one));
+    (void)res;
+}
+
+#endif //GN_ENABLE_EPOLL
+
 } //namespace mg
@@ -0,0 +1,130 @@
+#include "lib/graft/object_pool.h"
+
+#include <cassert>
+
+namespace graft {
+
+namespace
+{
+
+thread_local SlabPool* t_current = nullptr;
+
+}
+
+SlabPool* SlabPool::create()
+{
+    return new SlabPool();
+}
+
+SlabPool::~SlabPool()
+{
+    assert(m_refs == 0);
+}
+
+void SlabPool::close()
+{
+    if(t_current == this) t_current = nullptr;
+    release();
+}
+
+void SlabPool::setCurrent(SlabPool* pool)
+{
+    t_current = pool;
+}
+
+SlabPool* SlabPool::current()
+{
+    return t_current;
+}
+
+void* SlabPool::allocate(size_t size)
+{
+    SlabPool* pool = t_current;
+    Header* h;
+    if(pool && 0 < size && size <= MaxSize)
+    {
+        h = pool->take((size - 1) / ClassSize);
+    }
+    else
+    {
+        h = static_cast<Header*>(::operator new(sizeof(Header) + size));
+        h->owner = nullptr;
+    }
+    return h + 1;
+}
+
+void SlabPool::deallocate(void* p) noexcept
+{
+    if(!p) return;
+    Header* h = static_cast<Header*>(p) - 1;
+    SlabPool* owner = h->owner;
+    if(!owner)
+    {
+        ::operator delete(h);
+        return;
+    }
+    if(owner == t_current) owner->put(h);
+    else owner->putRemote(h);
+    owner->release();
+}
+
+SlabPool::Header* SlabPool::take(uint32_t cls)
+{
+    if(!m_free[cls] && m_remote.load(std::memory_order_relaxed))
+    {//return the blocks freed by other threads
+        FreeNode* node = m_remote.exchange(nullptr, std::memory_order_acquire);
+        while(node)
+        {
+            FreeNode* next = node->next;
+            Header* h = reinterpret_cast<Header*>(node) - 1;
+            node->next = m_free[h->cls];
+            m_free[h->cls] = node;
+            node = next;
+        }
+    }
+
+    Header* h;
+    if(m_free[cls])
+    {
+        FreeNode* node = m_free[cls];
+        m_free[cls] = node->next;
+        h = reinterpret_cast<Header*>(node) - 1;
+    }
+    else
+    {
+        size_t blockSize = sizeof(Header) + (cls + 1) * ClassSize;
+        if(size_t(m_chunkEnd - m_chunkPos) < blockSize)
+        {//the tail of the previous chunk is lost, it is less than the biggest block
+            m_chunks.emplace_back(new char[ChunkSize]);
+            m_chunkPos = m_chunks.back().get();
+            m_chunkEnd = m_chunkPos + ChunkSize;
+        }
+        h = reinterpret_cast<Header*>(m_chunkPos);
+        m_chunkPos += blockSize;
+        h->owner = this;
+        h->cls = cls;
+    }
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+    return h;
+}
+
+void SlabPool::put(Header* h) noexcept
+{
+    FreeNode* node = reinterpret_cast<FreeNode*>(h + 1);
+    node->next = m_free[h->cls];
+    m_free[h->cls] = node;
+}
+
+void SlabPool::putRemote(Header* h) noexcept
+{
+    FreeNode* node = reinterpret_cast<FreeNode*>(h + 1);
+    node->next = m_remote.load(std::memory_order_relaxed);
+    while(!m_remote.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlabPool::release() noexcept
+{
+    if(m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+}
+
+}//namespace graft
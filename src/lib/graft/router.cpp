@@ -4,9 +4,87 @@
 namespace graft
 {
 
+RouteVars& RouteVars::operator = (const RouteVars& v)
+{
+    if(this != &v)
+    {
+        m_buf = v.m_buf;
+        m_more = v.m_more;
+        std::copy(std::begin(v.m_inline), std::end(v.m_inline), std::begin(m_inline));
+        m_size = v.m_size;
+    }
+    return *this;
+}
+
+RouteVars& RouteVars::operator = (RouteVars&& v) noexcept
+{
+    if(this != &v)
+    {
+        m_buf = std::move(v.m_buf);
+        m_more = std::move(v.m_more);
+        std::copy(std::begin(v.m_inline), std::end(v.m_inline), std::begin(m_inline));
+        m_size = v.m_size;
+        v.clear();
+    }
+    return *this;
+}
+
+void RouteVars::emplace(std::string_view key, std::string_view value)
+{
+    Entry e{uint32_t(m_buf.size()), uint32_t(key.size()), uint32_t(m_buf.size() + key.size()), uint32_t(value.size())};
+    m_buf.append(key).append(value);
+
+    if(m_size == InlineVars)
+    {
+        m_more.assign(m_inline, m_inline + InlineVars);
+    }
+    if(InlineVars <= m_size)
+    {
+        m_more.emplace_back();
+    }
+    //after the equal keys like std::multimap
+    size_t pos = upperIndex(key);
+    ++m_size;
+    Entry* ents = entries();
+    std::copy_backward(ents + pos, ents + m_size - 1, ents + m_size);
+    ents[pos] = e;
+}
+
+size_t RouteVars::lowerIndex(std::string_view k) const
+{
+    size_t i = 0;
+    while(i < m_size && key(i) < k) ++i;
+    return i;
+}
+
+size_t RouteVars::upperIndex(std::string_view k) const
+{
+    size_t i = 0;
+    while(i < m_size && key(i) <= k) ++i;
+    return i;
+}
+
+RouteVars::const_iterator RouteVars::find(std::string_view k) const
+{
+    const_iterator it = lower_bound(k);
+    if(it == end() || it->first != k) return end();
+    return it;
+}
+
+size_t RouteVars::count(std::string_view k) const
+{
+    size_t cnt = 0;
+    for(size_t i = 0; i < m_size; ++i)
+    {
+        if(key(i) == k) ++cnt;
+    }
+    return cnt;
+}
+
 template<typename In, typename Out>
 bool RouterT<In,Out>::Root::arm()
 {
+    assert(!m_compiled);
     std::for_each(m_routers.begin(), m_routers.end(),
         [this](Router& ro)
         {
@@ -24,12 +102,119 @@ bool RouterT<In,Out>::Root::arm()
     if (err != 0)
         std::cout << "error: " << std::string(errstr) << std::endl;
 
+    buildStatic();
     return m_compiled = (err == 0);
 }
 
 template<typename In, typename Out>
-bool RouterT<In,Out>::Root::match(const std::string& target, int method, JobParams& params)
+uint64_t RouterT<In,Out>::Root::hash(const char* s, size_t len, uint64_t seed)
+{
+    //FNV-1a
+    uint64_t h = 0xcbf29ce484222325ull ^ seed;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h ^ (h >> 32);
+}
+
+template<typename In, typename Out>
+void RouterT<In,Out>::Root::buildStatic()
 {
+    //the endpoints that contain no r3 patterns are matched by exact comparison
+    std::map<std::string, std::vector<const Route*>> statics;
+    int methods = 0;
+    for(const RouterT& ro : m_routers)
+    {
+        for(const Route& r : ro.m_routes)
+        {
+            methods |= r.methods;
+            if(r.endpoint.find_first_of("{}*()[]^$+?|\\") != std::string::npos) continue;
+            statics[r.endpoint].push_back(&r);
+        }
+    }
+    //the precedence of the routes is that of r3, the first registered route wins;
+    //an endpoint stays in r3 only if a patterned route, registered earlier, shadows it for some method
+    for(auto it = statics.begin(); it != statics.end(); )
+    {
+        bool same = true;
+        for(int method = 0; same && method <= methods; method = method? method << 1 : 1)
+        {
+            if(method && !(method & methods)) continue;
+            same = (pickStatic(it->second, method) == matchR3(it->first, method));
+        }
+        it = same? std::next(it) : statics.erase(it);
+    }
+    m_static.clear();
+    if(statics.empty()) return;
+
+    //look for a seed without collisions, the table grows if it takes too long
+    for(size_t size = 2; ; size *= 2)
+    {
+        if(size < 2 * statics.size()) continue;
+        for(uint64_t seed = 1; seed <= 1000; ++seed)
+        {
+            std::vector<StaticEntry> table(size);
+            bool ok = true;
+            for(auto& [endpoint, routes] : statics)
+            {
+                StaticEntry& e = table[hash(endpoint.data(), endpoint.size(), seed) & (size - 1)];
+                if(!e.routes.empty())
+                {
+                    ok = false;
+                    break;
+                }
+                e.endpoint = endpoint;
+                e.routes = routes;
+            }
+            if(!ok) continue;
+            m_static = std::move(table);
+            m_seed = seed;
+            return;
+        }
+    }
+}
+
+template<typename In, typename Out>
+const typename RouterT<In,Out>::Route* RouterT<In,Out>::Root::matchStatic(const std::string& target, int method) const
+{
+    if(m_static.empty()) return nullptr;
+    const StaticEntry& e = m_static[hash(target.data(), target.size(), m_seed) & (m_static.size() - 1)];
+    if(e.endpoint != target) return nullptr;
+    return pickStatic(e.routes, method);
+}
+
+template<typename In, typename Out>
+const typename RouterT<In,Out>::Route* RouterT<In,Out>::Root::pickStatic(const std::vector<const Route*>& routes, int method)
+{
+    for(const Route* r : routes)
+    {
+        //the same as r3 does, 0 matches any method
+        if(method == 0 || (r->methods & method)) return r;
+    }
+    return nullptr;
+}
+
+template<typename In, typename Out>
+const typename RouterT<In,Out>::Route* RouterT<In,Out>::Root::matchR3(const std::string& target, int method) const
+{
+    match_entry *entry = match_entry_create(target.c_str());
+    entry->request_method = method;
+    R3Route *m = r3_tree_match_route(m_node, entry);
+    match_entry_free(entry);
+    return m? static_cast<const Route*>(m->data) : nullptr;
+}
+
+template<typename In, typename Out>
+bool RouterT<In,Out>::Root::match(const std::string& target, int method, JobParams& params) const
+{
+    if(const Route* r = matchStatic(target, method))
+    {
+        params.h3 = &r->h3;
+        return true;
+    }
+
     bool ret = false;
 
     match_entry *entry = match_entry_create(target.c_str());
@@ -39,12 +224,12 @@ bool RouterT<In,Out>::Root::match(const std::string& target, int method, JobPara
     if (m)
     {
         for (size_t i = 0; i < entry->vars.tokens.size; i++)
-            params.vars.emplace(std::make_pair(
-                std::move(std::string(entry->vars.slugs.entries[i].base, entry->vars.slugs.entries[i].len)),
-                std::move(std::string(entry->vars.tokens.entries[i].base, entry->vars.tokens.entries[i].len))
-            ));
+            params.vars.emplace(
+                std::string_view(entry->vars.slugs.entries[i].base, entry->vars.slugs.entries[i].len),
+                std::string_view(entry->vars.tokens.entries[i].base, entry->vars.tokens.entries[i].len)
+            );
 
-        params.h3 = static_cast<Route*>(m->data)->h3;
+        params.h3 = &static_cast<const Route*>(m->data)->h3;
         ret = true;
     }
     match_entry_free(entry);
@@ -18,6 +18,10 @@ Counter::Counter(void)
 , m_upstrm_http_resp_err_cnt(0)
 , m_upstrm_http_req_bytes_raw_cnt(0)
 , m_upstrm_http_resp_bytes_raw_cnt(0)
+, m_global_ctx_expired_cnt(0)
+, m_expired_window_start(steady_sec())
+, m_expired_window_cnt(0)
+, m_expired_per_sec(0)
 , m_system_start_time(std::chrono::system_clock::now())
 {
 }
@@ -26,5 +30,25 @@ Counter::~Counter(void)
 {
 }
 
+void Counter::count_global_ctx_expired(u32 inc_delta)
+{
+    m_global_ctx_expired_cnt += inc_delta;
+
+    u64 now = steady_sec();
+    u64 start = m_expired_window_start;
+    if(start + ExpiredRateWindowSec <= now && m_expired_window_start.compare_exchange_strong(start, now))
+    {
+        m_expired_per_sec = m_expired_window_cnt.exchange(0) / (now - start);
+    }
+    m_expired_window_cnt += inc_delta;
+}
+
+u32 Counter::global_ctx_expired_per_sec(void) const
+{
+    // nothing has expired during the last window
+    if(m_expired_window_start + 2 * ExpiredRateWindowSec <= steady_sec()) return 0;
+    return m_expired_per_sec;
+}
+
 }
 
@@ -43,6 +43,15 @@ Status handler(const Vars& vars, const Input& input, Ctx& ctx, Output& output)
     ri.upstrm_http_req_bytes_raw  = rsi.upstrm_http_req_bytes_raw_cnt();
     ri.upstrm_http_resp_bytes_raw = rsi.upstrm_http_resp_bytes_raw_cnt();
 
+    ri.global_ctx_expired         = rsi.global_ctx_expired_cnt();
+    ri.global_ctx_expired_per_sec = rsi.global_ctx_expired_per_sec();
+
+    ri.workers_active       = ThreadPoolX::getActiveWorkersCount();
+    ri.workers_expelled     = ThreadPoolX::getExpelledWorkersCount();
+    ri.workers_blocked      = ThreadPoolX::getBlockedWorkersCount();
+    ri.workers_compensating = ThreadPoolX::getCompensatingWorkersCount();
+    ri.workers_compensated  = ThreadPoolX::getCompensatedCount();
+
     ri.uptime_sec = rsi.system_uptime_sec();
 
     auto& cfg = out.configuration;
@@ -13,169 +13,138 @@
 
 namespace graft {
 
-thread_local bool TaskManager::io_thread = false;
+thread_local TaskManager* TaskManager::io_manager = nullptr;
 
-void StateMachine::process(BaseTaskPtr bt)
+template<size_t N>
+constexpr StateMachine::Matrix StateMachine::makeMatrix(const Row (&table)[N])
 {
-    static const char *state_strs[] = { GRAFT_STATE_LIST(EXP_TO_STR) };
-
-    St cur_stat = status(bt);
-
-    for(auto& r : m_table)
+    static_assert(N < 256, "the index of a row does not fit in Cell");
+    Matrix m{};
+    for(size_t r = 0; r < N; ++r)
     {
-        if(m_state != std::get<smStateStart>(r)) continue;
-
-        Statuses& ss = std::get<smStatuses>(r);
-        if(ss.size()!=0)
+        for(size_t s = 0; s < StatusCount; ++s)
         {
-            bool res = false;
-            for(auto s : ss)
-            {
-                if(s == cur_stat)
-                {
-                    res = true;
-                    break;
-                }
-            }
-            if(!res) continue;
+            if(!(table[r].statuses & (StatusMask(1) << s))) continue;
+            Cell& c = m.cells[table[r].start][s];
+            //too many rows for a state and a status, increase MaxCandidates
+            if(c.count == MaxCandidates) throw std::logic_error("state machine matrix overflow");
+            c.rows[c.count++] = uint8_t(r);
         }
+    }
+    return m;
+}
+
+StateMachine::State StateMachine::process(BaseTask& bt, State state, const Row* table, const Matrix& matrix)
+{
+    static const char *state_strs[] = { GRAFT_STATE_LIST(EXP_TO_STR) };
+
+    St cur_stat = bt.getLastStatus();
 
-        Guard& g = std::get<smGuard>(r);
-        if(g && !g(bt)) continue;
+    const Cell& cell = matrix.cells[state][static_cast<int>(cur_stat)];
+    for(size_t i = 0; i < cell.count; ++i)
+    {
+        const Row& r = table[cell.rows[i]];
 
-        Action& a = std::get<smAction>(r);
-        if(a) a(bt);
+        if(r.guard && !r.guard(bt)) continue;
 
-        State prev_state = m_state;
-        m_state = std::get<smStateEnd>(r);
+        if(r.action) r.action(bt);
 
         mlog_current_log_category = "sm";
-        LOG_PRINT_RQS_BT(3,bt, "sm: " << state_strs[int(prev_state)] << "->" << state_strs[int(m_state)] );
+        LOG_PRINT_RQS_BT(3,&bt, "sm: " << state_strs[int(state)] << "->" << state_strs[int(r.end)] );
         mlog_current_log_category.clear();
 
-        return;
+        return r.end;
     }
     {
-        bool is_periodic = (dynamic_cast<PeriodicTask*>(bt.get()) != nullptr);
+        bool is_periodic = (dynamic_cast<PeriodicTask*>(&bt) != nullptr);
         std::ostringstream oss;
-        oss << (is_periodic? "periodic;" : "") << " state " << state_strs[int(m_state)] << " status " << bt->getStrStatus();
-        const Router::Handler3& h3 = bt->getHandler3();
+        oss << (is_periodic? "periodic;" : "") << " state " << state_strs[int(state)] << " status " << bt.getStrStatus();
+        const Router::Handler3& h3 = bt.getHandler3();
         oss << "{" << !!h3.pre_action << "," << !!h3.worker_action << "," << !!h3.post_action << "}";
         throw std::runtime_error("State machine table is not complete." + oss.str());
     }
 }
 
-const StateMachine::Guard StateMachine::has(Router::Handler H3::* act)
-{
-    return [act](BaseTaskPtr bt)->bool
-    {
-        return (bt->getHandler3().*act != nullptr);
-    };
-}
-
-const StateMachine::Guard StateMachine::hasnt(Router::Handler H3::* act)
+void StateMachine::dispatch(BaseTask& bt, State state)
 {
-    return [act](BaseTaskPtr bt)->bool
-    {
-        return (bt->getHandler3().*act == nullptr);
-    };
-}
-
-void StateMachine::init_table()
-{
-
-    const Action run_forward = [](BaseTaskPtr bt)
-    {
-        bt->getManager().processForward(bt);
-    };
-
-    const Action run_response = [](BaseTaskPtr bt)
-    {
-        assert(St::Again == bt->getLastStatus());
-        bt->getManager().respondAndDie(bt, bt->getOutput().data(), false);
-    };
-
-    const Action run_error_response = [](BaseTaskPtr bt)
-    {
-        assert(St::Error == bt->getLastStatus() ||
-               St::InternalError == bt->getLastStatus() ||
-               St::Stop == bt->getLastStatus());
-        bt->getManager().respondAndDie(bt, bt->getOutput().data());
-    };
+    //the actions get the task by reference, a shared pointer is taken only by those that keep the task
+#define ST(...) mask({__VA_ARGS__})
 
-    const Action run_drop = [](BaseTaskPtr bt)
+    static constexpr Row table[] =
     {
-        assert(St::Drop == bt->getLastStatus());
-        bt->getManager().respondAndDie(bt, "Job done Drop."); //TODO: Expect HTTP Error Response
-    };
-
-    const Action run_ok_response = [](BaseTaskPtr bt)
-    {
-        assert(St::Ok == bt->getLastStatus());
-        bt->getManager().processOk(bt);
-    };
-
-    const Action run_postpone = [](BaseTaskPtr bt)
-    {
-        assert(St::Postpone == bt->getLastStatus());
-        bt->getManager().postponeTask(bt);
-    };
+//      Start                   Status          Target              Guard               Action
+        {EXECUTE,               ANY,            PRE_ACTION,         nullptr,
+            [](BaseTask& bt) { bt.getManager().checkThreadPoolOverflow(bt); } },
+        {PRE_ACTION,            ST(St::Busy),   EXIT,               nullptr,            nullptr },
+        {PRE_ACTION,            ST(St::None, St::Ok, St::Forward, St::Postpone),
+                                                CHK_PRE_ACTION,     nullptr,
+            [](BaseTask& bt) { bt.getManager().runPreAction(bt); } },
+        {CHK_PRE_ACTION,        ST(St::Again),  PRE_ACTION,         nullptr,            runResponse },
+        {CHK_PRE_ACTION,        ST(St::Ok),     WORKER_ACTION,      has<&H3::pre_action>, nullptr },
+        {CHK_PRE_ACTION,        ST(St::Forward),POST_ACTION,        has<&H3::pre_action>, nullptr },
+        {CHK_PRE_ACTION,        ST(St::Error, St::InternalError, St::Stop),
+                                                EXIT,               has<&H3::pre_action>, runErrorResponse },
+        {CHK_PRE_ACTION,        ST(St::Drop),   EXIT,               has<&H3::pre_action>, runDrop },
+        {CHK_PRE_ACTION,        ST(St::None, St::Ok, St::Forward, St::Postpone),
+                                                WORKER_ACTION,      nullptr,            nullptr },
+        {WORKER_ACTION,         ANY,            CHK_WORKER_ACTION,  nullptr,
+            [](BaseTask& bt) { bt.getManager().runWorkerAction(bt); } },
+        {CHK_WORKER_ACTION,     ANY,            EXIT,               has<&H3::worker_action>, nullptr },
+        {CHK_WORKER_ACTION,     ANY,            POST_ACTION,        nullptr,            nullptr },
 
-    const Action check_overflow = [](BaseTaskPtr bt)
-    {
-        bt->getManager().checkThreadPoolOverflow(bt);
+        {WORKER_ACTION_DONE,    ST(St::Again),  WORKER_ACTION,      nullptr,            runResponse },
+        {WORKER_ACTION_DONE,    ANY,            POST_ACTION,        nullptr,            nullptr },
+        {POST_ACTION,           ANY,            CHK_POST_ACTION,    nullptr,
+            [](BaseTask& bt) { bt.getManager().runPostAction(bt); } },
+        {CHK_POST_ACTION,       ST(St::Again),  POST_ACTION,        nullptr,            runResponse },
+        {CHK_POST_ACTION,       ST(St::Forward),EXIT,               nullptr,
+            [](BaseTask& bt) { bt.getManager().processForward(bt.getSelf()); } },
+        {CHK_POST_ACTION,       ST(St::Ok),     EXIT,               nullptr,
+            [](BaseTask& bt)
+            {
+                assert(St::Ok == bt.getLastStatus());
+                bt.getManager().processOk(bt.getSelf());
+            } },
+        {CHK_POST_ACTION,       ST(St::Error, St::InternalError, St::Stop),
+                                                EXIT,               nullptr,            runErrorResponse },
+        {CHK_POST_ACTION,       ST(St::Drop),   EXIT,               nullptr,            runDrop },
+        {CHK_POST_ACTION,       ST(St::Postpone), EXIT,             nullptr,
+            [](BaseTask& bt)
+            {
+                assert(St::Postpone == bt.getLastStatus());
+                bt.getManager().postponeTask(bt.getSelf());
+            } },
     };
 
-    const Action run_preaction = [](BaseTaskPtr bt)
-    {
-        bt->getManager().runPreAction(bt);
-    };
+#undef ST
 
-    const Action run_workeraction = [](BaseTaskPtr bt)
-    {
-        bt->getManager().runWorkerAction(bt);
-    };
+    static constexpr Matrix matrix = makeMatrix(table);
 
-    const Action run_postaction = [](BaseTaskPtr bt)
+    while(state != EXIT)
     {
-        bt->getManager().runPostAction(bt);
-    };
-
-#define ANY { }
-
-    m_table = std::vector<row>(
-    {
-//      Start                   Status          Target              Guard               Action
-        {EXECUTE,               ANY,            PRE_ACTION,         nullptr,            check_overflow },
-        {PRE_ACTION,            {St::Busy},     EXIT,               nullptr,            nullptr },
-        {PRE_ACTION,            {St::None, St::Ok, St::Forward, St::Postpone},
-                                                CHK_PRE_ACTION,     nullptr,            run_preaction },
-        {CHK_PRE_ACTION,        {St::Again},    PRE_ACTION,         nullptr,            run_response },
-        {CHK_PRE_ACTION,        {St::Ok},       WORKER_ACTION,      has(&H3::pre_action), nullptr },
-        {CHK_PRE_ACTION,        {St::Forward},  POST_ACTION,        has(&H3::pre_action), nullptr },
-        {CHK_PRE_ACTION,        {St::Error, St::InternalError, St::Stop},
-                                                EXIT,               has(&H3::pre_action), run_error_response },
-        {CHK_PRE_ACTION,        {St::Drop},     EXIT,               has(&H3::pre_action), run_drop },
-        {CHK_PRE_ACTION,        {St::None, St::Ok, St::Forward, St::Postpone},
-                                                WORKER_ACTION,      nullptr,            nullptr },
-        {WORKER_ACTION,         ANY,            CHK_WORKER_ACTION,  nullptr,            run_workeraction },
-        {CHK_WORKER_ACTION,     ANY,            EXIT,               has(&H3::worker_action), nullptr },
-        {CHK_WORKER_ACTION,     ANY,            POST_ACTION,        nullptr,            nullptr },
+        state = process(bt, state, table, matrix);
+    }
+}
 
-        {WORKER_ACTION_DONE,    {St::Again},    WORKER_ACTION,      nullptr,            run_response },
-        {WORKER_ACTION_DONE,    ANY,            POST_ACTION,        nullptr,            nullptr },
-        {POST_ACTION,           ANY,            CHK_POST_ACTION,    nullptr,            run_postaction },
-        {CHK_POST_ACTION,       {St::Again},    POST_ACTION,        nullptr,            run_response },
-        {CHK_POST_ACTION,       {St::Forward},  EXIT,               nullptr,            run_forward },
-        {CHK_POST_ACTION,       {St::Ok},       EXIT,               nullptr,            run_ok_response },
-        {CHK_POST_ACTION,       {St::Error, St::InternalError, St::Stop},
-                                                EXIT,               nullptr,            run_error_response },
-        {CHK_POST_ACTION,       {St::Drop},     EXIT,               nullptr,            run_drop },
-        {CHK_POST_ACTION,       {St::Postpone}, EXIT,               nullptr,            run_postpone },
-    });
+void StateMachine::runResponse(BaseTask& bt)
+{
+    assert(St::Again == bt.getLastStatus());
+    bt.getManager().respondAndDie(bt.getSelf(), bt.getOutput().data(), false);
+}
 
-#undef ANY
+void StateMachine::runErrorResponse(BaseTask& bt)
+{
+    assert(St::Error == bt.getLastStatus() ||
+           St::InternalError == bt.getLastStatus() ||
+           St::Stop == bt.getLastStatus());
+    BaseTaskPtr self = bt.getSelf();
+    bt.getManager().respondAndDie(self, bt.getManager().takeResponse(self));
+}
 
+void StateMachine::runDrop(BaseTask& bt)
+{
+    assert(St::Drop == bt.getLastStatus());
+    bt.getManager().respondAndDie(bt.getSelf(), "Job done Drop."); //TODO: Expect HTTP Error Response
 }
 
 class Uuid_Input : private std::pair<Context::uuid_t,std::shared_ptr<Input>>
@@ -204,6 +173,56 @@ public:
     { }
 };
 
+//The owners of the postponed tasks of the TaskManagers sharing the primary one, and the answers that come before
+//their tasks are postponed. An answer is routed to the TaskManager that holds the task, so the answers are kept
+//in one place and are not left behind in the other TaskManagers.
+class PostponeDirectory
+{
+public:
+    PostponeDirectory(int life_time_ms) : m_future(life_time_ms) { }
+
+    //returns true and the answer if it has come already, otherwise the task is registered
+    bool postpone(const Context::uuid_t& uuid, TaskManager* owner, Input& input)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        auto res = m_future.extract(uuid);
+        if(res.first)
+        {
+            assert(res.second.getInputPtr());
+            input = *res.second.getInputPtr();
+            return true;
+        }
+        m_owners[uuid] = owner;
+        return false;
+    }
+
+    //returns the owner of the postponed task, or nullptr and the answer is kept for the task to be postponed
+    TaskManager* resume(const Context::uuid_t& uuid, const Input& input)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        auto it = m_owners.find(uuid);
+        if(it == m_owners.end())
+        {
+            m_future.add(Uuid_Input(uuid, input));
+            return nullptr;
+        }
+        TaskManager* owner = it->second;
+        m_owners.erase(it);
+        return owner;
+    }
+
+    void erase(const Context::uuid_t& uuid)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_owners.erase(uuid);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::map<Context::uuid_t, TaskManager*> m_owners;
+    ExpiringList m_future;
+};
+
 class UpstreamManager
 {
 public:
@@ -238,7 +257,7 @@ public:
         }
         if(connItem->m_maxConnections != 0 && connItem->m_idleConnections.empty() && connItem->m_connCnt == connItem->m_maxConnections)
         {
-            connItem->m_taskQueue.push_back(bt);
+            connItem->m_taskQueue.push(bt, bt->getPriority());
             return;
         }
 
@@ -293,7 +312,11 @@ private:
         void releaseActive(ConnectionId connectionId, mg_connection* client)
         {
             assert(m_keepAlive || ((connectionId == 0) && (client == nullptr)));
-            if(!m_keepAlive) return;
+            if(!m_keepAlive)
+            {
+                --m_connCnt;
+                return;
+            }
             auto it = m_activeConnections.find(connectionId);
             assert(it != m_activeConnections.end());
             assert(it->second == nullptr || client == nullptr || it->second == client);
@@ -325,7 +348,8 @@ private:
         double m_timeout;
         //assert(m_upstreamQueue.empty() || 0 < m_maxConn);
         int m_maxConnections;
-        std::deque<BaseTaskPtr> m_taskQueue;
+        //the tasks waiting for a connection when the limit is reached
+        LaneQueue<BaseTaskPtr> m_taskQueue;
         bool m_keepAlive = false;
         std::map<mg_connection*, ConnectionId> m_idleConnections;
         std::map<ConnectionId, mg_connection*> m_activeConnections;
@@ -337,8 +361,8 @@ private:
         ++m_cntUpstreamSenderDone;
         m_onDoneCallback(uss);
         connItem->releaseActive(connectionId, client);
-        if(connItem->m_taskQueue.empty()) return;
-        BaseTaskPtr bt = connItem->m_taskQueue.front(); connItem->m_taskQueue.pop_front();
+        BaseTaskPtr bt;
+        if(!connItem->m_taskQueue.pop(bt)) return;
         createUpstreamSender(connItem, bt);
     }
 
@@ -346,7 +370,7 @@ private:
     {
         int uriId = 0;
         const ConfigOpts& opts = m_manager.getCopts();
-        m_default = ConnItem(uriId++, opts.cryptonode_rpc_address.c_str(), 0, false, opts.upstream_request_timeout);
+        m_default = ConnItem(uriId++, opts.cryptonode_rpc_address.c_str(), opts.cryptonode_max_connections, false, opts.upstream_request_timeout);
 
         for(auto& subs : OutHttp::uri_substitutions)
         {
@@ -375,6 +399,8 @@ private:
         }
         else
         {
+            //counts the connection against the limit
+            connItem->getConnection();
             uss = UpstreamSender::Create(bt, onDoneAct, connItem->m_timeout);
         }
 
@@ -391,12 +417,13 @@ private:
     TaskManager& m_manager; //TODO: should be removed, and be independent of TaskManager
 };
 
-TaskManager::TaskManager(const ConfigOpts& copts, SysInfoCounter& sysInfoCounter)
+TaskManager::TaskManager(const ConfigOpts& copts, SysInfoCounter& sysInfoCounter, TaskManager* primary)
     : m_copts(copts)
     , m_sysInfoCounter(sysInfoCounter)
-    , m_gcm(this)
-    , m_futurePostponeUuids(std::make_unique<ExpiringList>(1000 * copts.http_connection_timeout))
-    , m_stateMachine(std::make_unique<StateMachine>())
+    , m_primary(primary)
+    , m_gcm(primary? primary->m_gcm : std::make_shared<GlobalContextMap>(static_cast<HandlerAPI*>(this)))
+    , m_pool(SlabPool::create())
+    , m_postponeDirectory(primary? primary->m_postponeDirectory : std::make_shared<PostponeDirectory>(1000 * copts.http_connection_timeout))
 {
     copts.check_asserts();
 
@@ -406,7 +433,7 @@ TaskManager::TaskManager(const ConfigOpts& copts, SysInfoCounter& sysInfoCounter
 
 TaskManager::~TaskManager()
 {
-
+    m_pool->close();
 }
 
 inline size_t TaskManager::next_pow2(size_t val)
@@ -424,9 +451,10 @@ bool TaskManager::addPeriodicTask(const Router::Handler& h_worker,
                                   std::chrono::milliseconds initial_interval_ms,
                                   double random_factor)
 {
-    if(io_thread)
-    {//it is called from pre_action or post_action, and we can call requestAddPeriodicTask directly
-        addPeriodicTask({nullptr, h_worker, nullptr}, interval_ms, initial_interval_ms, random_factor);
+    if(io_manager)
+    {//it is called from pre_action or post_action, the task is added to the looper of this IO thread directly,
+     //the global context is shared by the loopers so ctx.handlerAPI() is not necessarily this one
+        io_manager->addPeriodicTask({nullptr, h_worker, nullptr}, interval_ms, initial_interval_ms, random_factor);
         return true;
     }
     else
@@ -449,6 +477,11 @@ const ConfigOpts& TaskManager::configOpts() const
     return m_copts;
 }
 
+ServiceRegistry& TaskManager::services()
+{
+    return m_gcm->services();
+}
+
 void TaskManager::checkPeriodicTaskIO()
 {
     while(true)
@@ -467,7 +500,7 @@ void TaskManager::checkPeriodicTaskIO()
 //pay attension, input is output and vice versa
 void TaskManager::sendUpstreamBlocking(Output& output, Input& input, std::string& err)
 {
-    if(io_thread) throw std::logic_error("the function sendUpstreamBlocking should not be called in IO thread");
+    if(io_manager) throw std::logic_error("the function sendUpstreamBlocking should not be called in IO thread");
     std::promise<Input> promise;
     std::future<Input> future = promise.get_future();
     std::pair< std::promise<Input>, Output> pair = std::make_pair( std::move(promise), output);
@@ -476,6 +509,7 @@ void TaskManager::sendUpstreamBlocking(Output& output, Input& input, std::string
     err.clear();
     try
     {
+        tp::BlockingRegion blocking;
         input = future.get();
     }
     catch(std::exception& ex)
@@ -497,6 +531,34 @@ void TaskManager::checkUpstreamBlockingIO()
     }
 }
 
+void TaskManager::sendUpstreamAsync(const Output& output, UpstreamCallback callback)
+{
+    if(io_manager)
+    {//the same as addPeriodicTask, the request is sent by the looper of this IO thread
+        io_manager->sendUpstream(BaseTask::Create<AsyncUpstreamTask>(*io_manager, output, std::move(callback)));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(m_upstreamAsyncMutex);
+        m_upstreamAsync.emplace_back(output, std::move(callback));
+    }
+    notifyJobReady();
+}
+
+void TaskManager::checkUpstreamAsyncIO()
+{
+    std::deque<std::pair<Output, UpstreamCallback>> requests;
+    {
+        std::lock_guard<std::mutex> lk(m_upstreamAsyncMutex);
+        if(m_upstreamAsync.empty()) return;
+        requests.swap(m_upstreamAsync);
+    }
+    for(auto& item : requests)
+    {
+        sendUpstream(BaseTask::Create<AsyncUpstreamTask>(*this, item.first, std::move(item.second)));
+    }
+}
+
 void TaskManager::sendUpstream(BaseTaskPtr bt)
 {
     assert(m_upstreamManager);
@@ -510,16 +572,24 @@ void TaskManager::onTimer(BaseTaskPtr bt)
     Execute(bt);
 }
 
-void TaskManager::respondAndDie(BaseTaskPtr bt, const std::string& s, bool die)
+std::string TaskManager::takeResponse(BaseTaskPtr bt)
+{
+    //the output of a client task is not used after the final response, so it is moved to the connection;
+    //the response of a periodic task is not sent anywhere
+    if(!dynamic_cast<ClientTask*>(bt.get())) return std::string();
+    return std::move(bt->getOutput().body);
+}
+
+void TaskManager::respondAndDie(BaseTaskPtr bt, std::string s, bool die)
 {
     ClientTask* ct = dynamic_cast<ClientTask*>(bt.get());
     if(ct)
     {
-        ct->m_connectionManager->respond(ct, s);
+        ct->m_connectionManager->respond(ct, std::move(s));
     }
     else
     {
-        assert( dynamic_cast<PeriodicTask*>(bt.get()) );
+        assert( dynamic_cast<PeriodicTask*>(bt.get()) || dynamic_cast<AsyncUpstreamTask*>(bt.get()) );
     }
 
     Context::uuid_t uuid = bt->getCtx().getId(false);
@@ -527,7 +597,11 @@ void TaskManager::respondAndDie(BaseTaskPtr bt, const std::string& s, bool die)
     {
         auto it = m_postponedTasks.find(uuid);
         if (it != m_postponedTasks.end())
+        {
+            m_timers.cancel(it->second->getTimer());
             m_postponedTasks.erase(it);
+            m_postponeDirectory->erase(uuid);
+        }
     }
 
     if(die)
@@ -536,66 +610,77 @@ void TaskManager::respondAndDie(BaseTaskPtr bt, const std::string& s, bool die)
 
 void TaskManager::schedule(PeriodicTask* pt)
 {
-    m_timerList.push(pt->getTimeout(), pt->getSelf());
+    BaseTaskPtr bt = pt->getSelf();
+    pt->getTimer() = m_timers.add(pt->getTimeout(), [bt]{ bt->getManager().onTimer(bt); });
 }
 
 bool TaskManager::canStop()
 {
     return (m_cntBaseTask == m_cntBaseTaskDone)
             && (!m_upstreamManager->busy())
+            && m_waitingForPool.empty()
             && (m_cntJobSent == m_cntJobDone);
 }
 
-bool TaskManager::tryProcessReadyJob()
+void TaskManager::processReadyJob(GJPtr& gj)
 {
-    GJPtr gj;
-    bool res = m_resQueue->pop(gj);
-    if(!res) return res;
     ++m_cntJobDone;
     BaseTaskPtr bt = gj->getTask();
 
     LOG_PRINT_RQS_BT(2,bt,"worker_action completed with result " << bt->getStrStatus());
-    m_stateMachine->dispatch(bt, StateMachine::State::WORKER_ACTION_DONE);
-    return true;
+    StateMachine::dispatch(*bt, StateMachine::State::WORKER_ACTION_DONE);
+
+    BaseTaskPtr waiting;
+    if(m_waitingForPool.pop(waiting))
+    {
+        waiting->setLastStatus(Status::None);
+        Execute(waiting);
+    }
 }
 
 void TaskManager::Execute(BaseTaskPtr bt)
 {
-    m_stateMachine->dispatch(bt, StateMachine::State::EXECUTE);
+    StateMachine::dispatch(*bt, StateMachine::State::EXECUTE);
 }
 
-void TaskManager::checkThreadPoolOverflow(BaseTaskPtr bt)
+void TaskManager::checkThreadPoolOverflow(BaseTask& bt)
 {
-    auto& params = bt->getParams();
+    auto& params = bt.getParams();
 
     assert(m_cntJobDone <= m_cntJobSent);
-    if(params.h3.worker_action && m_cntJobSent - m_cntJobDone == m_threadPoolInputSize)
+    if(params.h3->worker_action && m_cntJobSent - m_cntJobDone == m_threadPoolInputSize)
     {//check overflow
-        bt->getCtx().local.setError("Service Unavailable", Status::Busy);
-        respondAndDie(bt,"Thread pool overflow");
+        if(dynamic_cast<AsyncUpstreamTask*>(&bt))
+        {//the callback is not dropped, it waits until a job is done
+            bt.setLastStatus(Status::Busy);
+            m_waitingForPool.push(bt.getSelf(), bt.getPriority());
+            return;
+        }
+        bt.getCtx().local.setError("Service Unavailable", Status::Busy);
+        respondAndDie(bt.getSelf(),"Thread pool overflow");
     }
     assert(m_cntJobSent - m_cntJobDone <= m_threadPoolInputSize);
 }
 
-void TaskManager::runPreAction(BaseTaskPtr bt)
+void TaskManager::runPreAction(BaseTask& bt)
 {
-    auto& params = bt->getParams();
+    auto& params = bt.getParams();
 
-    if(!params.h3.pre_action) return;
+    if(!params.h3->pre_action) return;
 
-    auto& ctx = bt->getCtx();
-    auto& output = bt->getOutput();
+    auto& ctx = bt.getCtx();
+    auto& output = bt.getOutput();
 
     try
     {
         // Please read the comment about exceptions and noexcept specifier
         // near 'void terminate()' function in main.cpp
-        mlog_current_log_category = params.h3.name;
-        Status status = params.h3.pre_action(params.vars, params.input, ctx, output);
+        mlog_current_log_category = params.h3->name;
+        Status status = params.h3->pre_action(params.vars, params.input, ctx, output);
         mlog_current_log_category.clear();
 
-        bt->setLastStatus(status);
-        if(Status::Ok == status && (params.h3.worker_action || params.h3.post_action)
+        bt.setLastStatus(status);
+        if(Status::Ok == status && (params.h3->worker_action || params.h3->post_action)
                 || Status::Forward == status)
         {
             params.input.assign(output);
@@ -603,29 +688,30 @@ void TaskManager::runPreAction(BaseTaskPtr bt)
     }
     catch(const std::exception& e)
     {
-        bt->setError(e.what());
+        bt.setError(e.what());
         params.input.reset();
         throw;
     }
     catch(...)
     {
-        bt->setError("unknown exception");
+        bt.setError("unknown exception");
         params.input.reset();
         throw;
     }
-    LOG_PRINT_RQS_BT(3,bt,"pre_action completed with result " << bt->getStrStatus());
+    LOG_PRINT_RQS_BT(3,&bt,"pre_action completed with result " << bt.getStrStatus());
 }
 
-void TaskManager::runWorkerAction(BaseTaskPtr bt)
+void TaskManager::runWorkerAction(BaseTask& bt)
 {
-    auto& params = bt->getParams();
+    auto& params = bt.getParams();
 
-    if(params.h3.worker_action)
+    if(params.h3->worker_action)
     {
         ++m_cntJobSent;
         m_threadPool->post(
-                    GJPtr( bt, m_resQueue.get(), this ),
-                    true
+                    GJPtr( bt.getSelf(), m_resQueue.get(), this ),
+                    true,
+                    toLane(bt.getPriority())
                     );
     }
 }
@@ -643,12 +729,12 @@ void TaskManager::runWorkerActionFromTheThreadPool(BaseTaskPtr bt)
         // Please read the comment about exceptions and noexcept specifier
         // near 'void terminate()' function in main.cpp
 
-        mlog_current_log_category = params.h3.name;
-        Status status = params.h3.worker_action(params.vars, params.input, ctx, output);
+        mlog_current_log_category = params.h3->name;
+        Status status = params.h3->worker_action(params.vars, params.input, ctx, output);
         mlog_current_log_category.clear();
 
         bt->setLastStatus(status);
-        if(Status::Ok == status && params.h3.post_action || Status::Forward == status)
+        if(Status::Ok == status && params.h3->post_action || Status::Forward == status)
         {
             params.input.assign(output);
         }
@@ -668,26 +754,26 @@ void TaskManager::runWorkerActionFromTheThreadPool(BaseTaskPtr bt)
 
 }
 
-void TaskManager::runPostAction(BaseTaskPtr bt)
+void TaskManager::runPostAction(BaseTask& bt)
 {
-    auto& params = bt->getParams();
+    auto& params = bt.getParams();
 
-    if(!params.h3.post_action) return;
+    if(!params.h3->post_action) return;
 
-    auto& ctx = bt->getCtx();
-    auto& output = bt->getOutput();
+    auto& ctx = bt.getCtx();
+    auto& output = bt.getOutput();
 
     try
     {
-        mlog_current_log_category = params.h3.name;
-        Status status = params.h3.post_action(params.vars, params.input, ctx, output);
+        mlog_current_log_category = params.h3->name;
+        Status status = params.h3->post_action(params.vars, params.input, ctx, output);
         mlog_current_log_category.clear();
 
         //in case of pre_action or worker_action return Forward we call post_action in any case
         //but we should ignore post_action result status and output
-        if(Status::Forward != bt->getLastStatus())
+        if(Status::Forward != bt.getLastStatus())
         {
-            bt->setLastStatus(status);
+            bt.setLastStatus(status);
             if(Status::Forward == status)
             {
                 params.input.assign(output);
@@ -696,17 +782,17 @@ void TaskManager::runPostAction(BaseTaskPtr bt)
     }
     catch(const std::exception& e)
     {
-        bt->setError(e.what());
+        bt.setError(e.what());
         params.input.reset();
         throw;
     }
     catch(...)
     {
-        bt->setError("unknown exception");
+        bt.setError("unknown exception");
         params.input.reset();
         throw;
     }
-    LOG_PRINT_RQS_BT(3,bt,"post_action completed with result " << bt->getStrStatus());
+    LOG_PRINT_RQS_BT(3,&bt,"post_action completed with result " << bt.getStrStatus());
 }
 
 void TaskManager::postponeTask(BaseTaskPtr bt)
@@ -714,66 +800,61 @@ void TaskManager::postponeTask(BaseTaskPtr bt)
     Context::uuid_t uuid = bt->getCtx().getId();
     assert(!uuid.is_nil());
 
-    //find already recieved uuid
-    auto res = m_futurePostponeUuids->extract(uuid);
-    if(res.first)
+    //find already recieved uuid, the answer could come to any IO thread
+    Input input;
+    if(m_postponeDirectory->postpone(uuid, this, input))
     {//found
         //set saved input
-        assert(res.second.getInputPtr());
-        bt->getParams().input = *res.second.getInputPtr();
-        m_readyToResume.push_back(bt);
+        bt->getParams().input = std::move(input);
+        m_readyToResume.push(bt, bt->getPriority());
         LOG_PRINT_RQS_BT(2,bt,"for the task with uuid '" << uuid << "' an answer found; it will be resumed.");
         return;
     }
 
     assert(m_postponedTasks.find(uuid) == m_postponedTasks.end());
     m_postponedTasks[uuid] = bt;
-    std::chrono::duration<double> timeout(m_copts.http_connection_timeout);
-    std::chrono::steady_clock::time_point tpoint = std::chrono::steady_clock::now()
-            + std::chrono::duration_cast<std::chrono::steady_clock::duration>( timeout );
-    m_expireTaskQueue.push(std::make_pair(
-                                    tpoint,
-                                    uuid)
-                                );
+    std::chrono::milliseconds timeout(static_cast<int64_t>(m_copts.http_connection_timeout * 1000));
+    bt->getTimer() = m_timers.add(timeout, [this, uuid]{ expirePostponed(uuid); });
     LOG_PRINT_RQS_BT(2,bt,"task with uuid '" << uuid << "' postponed.");
 }
 
 void TaskManager::executePostponedTasks()
 {
-    while(!m_readyToResume.empty())
+    //the tasks of higher priorities are resumed first, the lanes are interleaved by their weights
+    BaseTaskPtr bt;
+    while(m_readyToResume.pop(bt))
     {
-        BaseTaskPtr& bt = m_readyToResume.front();
         Context::uuid_t uuid = bt->getCtx().getId();
         LOG_PRINT_RQS_BT(2,bt,"task with uuid '" << uuid << "' resumed.");
         Execute(bt);
-        m_readyToResume.pop_front();
     }
+}
 
-    if(m_expireTaskQueue.empty()) return;
-
-    auto now = std::chrono::steady_clock::now();
-    while(!m_expireTaskQueue.empty())
-    {
-        auto& pair = m_expireTaskQueue.top();
-        if(now <= pair.first) break;
+void TaskManager::expirePostponed(const Context::uuid_t& uuid)
+{
+    auto it = m_postponedTasks.find(uuid);
+    if(it == m_postponedTasks.end()) return;
+
+    BaseTaskPtr bt = it->second;
+    LOG_PRINT_RQS_BT(2,bt,"postponed task with uuid '" << uuid << "' expired.");
+    std::string msg = "Postpone task response timeout";
+    bt->setError(msg.c_str(), Status::Error);
+    respondAndDie(bt, std::move(msg));
+}
 
-        auto it = m_postponedTasks.find(pair.second);
-        if(it != m_postponedTasks.end())
-        {
-            BaseTaskPtr& bt = it->second;
-            Context::uuid_t uuid = bt->getCtx().getId();
-            LOG_PRINT_RQS_BT(2,bt,"postponed task with uuid '" << uuid << "' expired.");
-            std::string msg = "Postpone task response timeout";
-            bt->setError(msg.c_str(), Status::Error);
-            respondAndDie(bt, msg);
-        }
+int TaskManager::pollTimeout() const
+{
+    if(!m_readyToResume.empty()) return 0;
 
-        m_expireTaskQueue.pop();
-    }
+    std::chrono::milliseconds timeout(m_copts.timer_poll_interval_ms);
+    timeout = std::min(timeout, m_timers.nextTimeout());
+    return timeout.count();
 }
 
 void TaskManager::expelWorkers()
 {
+    //the thread pool is shared, only the primary manager expels its workers
+    if(!isPrimary()) return;
     if(getCopts().workers_expelling_interval_ms == 0) return;
     m_threadPool->expelWorkers();
 }
@@ -788,34 +869,118 @@ void TaskManager::getThreadPoolInfo(uint64_t& activeWorkers, uint64_t& expelledW
 void TaskManager::processForward(BaseTaskPtr bt)
 {
     assert(Status::Forward == bt->getLastStatus());
+    Context& ctx = bt->getCtx();
+    if(ctx.hasFanOut() && ctx.fanOut().m_pending)
+    {
+        sendFanOut(bt);
+        return;
+    }
     LOG_PRINT_RQS_BT(3,bt,"Sending request to CryptoNode");
     sendUpstream(bt);
 }
 
+void TaskManager::sendFanOut(BaseTaskPtr bt)
+{
+    FanOut& fanOut = bt->getCtx().fanOut();
+    fanOut.m_pending = false;
+    std::shared_ptr<FanOut::Round> round = fanOut.m_round;
+    LOG_PRINT_RQS_BT(3,bt,"Sending " << round->items.size() << " requests to CryptoNode");
+
+    if(round->timeout.count() > 0)
+    {
+        round->timer = m_timers.add(round->timeout, [this, bt, round]
+        {
+            LOG_PRINT_RQS_BT(2,bt,"fan-out timeout, " << round->ok << " of " << round->items.size() << " requests answered");
+            joinFanOut(bt, round);
+        });
+    }
+    for(size_t i = 0; i < round->items.size(); ++i)
+    {
+        sendUpstream(BaseTask::Create<FanOutTask>(*this, bt, round, i));
+    }
+}
+
+void TaskManager::joinFanOut(const BaseTaskPtr& bt, const std::shared_ptr<FanOut::Round>& round)
+{
+    if(round->joined) return;
+    round->joined = true;
+    m_timers.cancel(round->timer);
+    if(!bt->getSelf())
+    {//it is possible that a client has closed connection already
+        return;
+    }
+    //the handler continues with the answers
+    Execute(bt);
+}
+
 void TaskManager::processOk(BaseTaskPtr bt)
 {
     Context::uuid_t nextUuid = bt->getCtx().getNextTaskId();
     if(!nextUuid.is_nil())
     {
-        auto it = m_postponedTasks.find(nextUuid);
-        if(it == m_postponedTasks.end())
+        if(resumePostponed(nextUuid, bt->getInput()))
         {
-            LOG_PRINT_RQS_BT(2,bt,"attempt to resume task with uuid '" << nextUuid << "' failed, maybe it is not postponed yet.");
-            Input input = bt->getInput();
-            m_futurePostponeUuids->add(Uuid_Input(nextUuid, std::move(input)));
+            LOG_PRINT_RQS_BT(2,bt,"resuming task with uuid '" << nextUuid << "'.");
         }
         else
         {
-            LOG_PRINT_RQS_BT(2,bt,"resuming task with uuid '" << nextUuid << "'.");
-            //redirect callback input to postponed task
-            BaseTaskPtr& bt_next = it->second;
-            bt_next->getInput() = bt->getInput();
+            LOG_PRINT_RQS_BT(2,bt,"attempt to resume task with uuid '" << nextUuid << "' failed, maybe it is not postponed yet.");
+        }
+    }
+    respondAndDie(bt, takeResponse(bt));
+}
 
-            m_readyToResume.push_back(bt_next);
-            m_postponedTasks.erase(it);
+bool TaskManager::resumePostponed(const Context::uuid_t& uuid, const Input& input)
+{
+    TaskManager* owner = m_postponeDirectory->resume(uuid, input);
+    if(!owner) return false;
+    if(owner != this)
+    {//the task is postponed by another IO thread
+        owner->resumePostponedTask(uuid, input);
+        return true;
+    }
+    return resumeOwnPostponed(uuid, input);
+}
+
+bool TaskManager::resumeOwnPostponed(const Context::uuid_t& uuid, const Input& input)
+{
+    auto it = m_postponedTasks.find(uuid);
+    //the task could expire after the answer has been routed here
+    if(it == m_postponedTasks.end()) return false;
+    //redirect callback input to postponed task
+    BaseTaskPtr& bt_next = it->second;
+    bt_next->getInput() = input;
+    m_timers.cancel(bt_next->getTimer());
+
+    m_readyToResume.push(bt_next, bt_next->getPriority());
+    m_postponedTasks.erase(it);
+    return true;
+}
+
+void TaskManager::resumePostponedTask(const Context::uuid_t& uuid, const Input& input)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_foreignResumeMutex);
+        m_foreignResume.emplace_back(uuid, input);
+    }
+    notifyJobReady();
+}
+
+void TaskManager::checkForeignResumeIO()
+{
+    std::deque<std::pair<Context::uuid_t, Input>> foreign;
+    {
+        std::lock_guard<std::mutex> lk(m_foreignResumeMutex);
+        if(m_foreignResume.empty()) return;
+        foreign.swap(m_foreignResume);
+    }
+    for(auto& item : foreign)
+    {
+        if(resumeOwnPostponed(item.first, item.second))
+        {
+            LOG_PRINT_L2("resuming task with uuid '" << item.first << "' by callback from another IO thread.");
         }
     }
-    respondAndDie(bt, bt->getOutput().data());
 }
 
 void TaskManager::addPeriodicTask(
@@ -850,14 +1015,22 @@ void TaskManager::initThreadPool(int threadCount, int workersQueueSize, int expe
     th_op.setThreadCount(threadCount);
     th_op.setQueueSize(workersQueueSize);
     th_op.setExpellingIntervalMs(expellingIntervalMs);
-    graft::ThreadPoolX thread_pool(th_op);
+    if(0 <= m_copts.workers_compensation_max) th_op.setMaxCompensationThreads(m_copts.workers_compensation_max);
 
-    const size_t maxinputSize = th_op.threadCount()*th_op.queueSize();
+    //the input of the shared thread pool is divided between IO threads
+    const size_t maxinputSize = std::max(size_t(1), th_op.threadCount()*th_op.queueSize() / m_copts.io_threads);
     size_t resQueueSize = next_pow2( maxinputSize );
-    graft::TPResQueue resQueue(resQueueSize);
 
-    m_threadPool = std::make_unique<ThreadPoolX>(std::move(thread_pool));
-    m_resQueue = std::make_unique<TPResQueue>(std::move(resQueue));
+    if(isPrimary())
+    {
+        m_threadPool = std::make_shared<ThreadPoolX>(th_op);
+    }
+    else
+    {
+        assert(m_primary->m_threadPool);
+        m_threadPool = m_primary->m_threadPool;
+    }
+    m_resQueue = std::make_unique<TPResQueue>(th_op.threadCount(), resQueueSize);
     m_threadPoolInputSize = maxinputSize;
     m_promiseQueue = std::make_unique<PromiseQueue>( threadCount );
     //TODO: it is not clear how many items we need in PeriodicTaskQueue, maybe we should make it dynamically but this requires additional synchronization
@@ -865,29 +1038,21 @@ void TaskManager::initThreadPool(int threadCount, int workersQueueSize, int expe
     m_upstreamManager = std::make_unique<UpstreamManager>(*this, [this](UpstreamSender& uss){ onUpstreamDone(uss); } );
 
     LOG_PRINT_L1("Thread pool created with " << threadCount
-                 << " workers with " << workersQueueSize
-                 << " queue size each. The output queue size is " << resQueueSize);
+                 << " workers and up to " << th_op.maxCompensationThreads() << " compensation threads with " << workersQueueSize
+                 << " queue size each. The output queue size is " << resQueueSize << " per worker");
 }
 
 void TaskManager::setIOThread(bool current)
 {
-    io_thread = current;
+    io_manager = current? this : nullptr;
+    SlabPool::setCurrent(current? m_pool : nullptr);
 }
 
 void TaskManager::cb_event(uint64_t cnt)
 {
-    //When multiple threads write to the output queue of the thread pool.
-    //It is possible that a hole appears when a thread has not completed to set
-    //the cell data in the queue. The hole leads to failure of pop operations.
-    //Thus, it is better to process as many cells as we can without waiting when
-    //the cell will be filled, instead of basing on the counter.
-    //We cannot lose any cell because a notification follows the hole completion.
-
-    while(true)
-    {
-        bool res = tryProcessReadyJob();
-        if(!res) break;
-    }
+    //cnt is the number of notifications, a worker notifies once per batch of results,
+    //so all the results that are ready are processed instead of basing on the counter
+    m_resQueue->drain([this](GJPtr& gj){ processReadyJob(gj); });
 }
 
 void TaskManager::onUpstreamDone(UpstreamSender& uss)
@@ -904,6 +1069,40 @@ void TaskManager::upstreamDoneProcess(UpstreamSender& uss)
         runtimeSysInfo().count_upstrm_http_resp_err();
 
     BaseTaskPtr bt = uss.getTask();
+    if(FanOutTask* ft = dynamic_cast<FanOutTask*>(bt.get()))
+    {
+        BaseTaskPtr parent = ft->m_parent;
+        std::shared_ptr<FanOut::Round> round = ft->m_round;
+        ft->finalize();
+        if(round->joined) return; //the answer came after the timeout or is not required
+
+        FanOut::Item& item = round->items[ft->m_index];
+        if(Status::Ok == uss.getStatus())
+        {
+            item.status = Status::Ok;
+            item.input = std::move(bt->getInput());
+            ++round->ok;
+        }
+        else
+        {
+            item.status = Status::Error;
+            item.error = uss.getError();
+        }
+        ++round->done;
+        if(round->complete()) joinFanOut(parent, round);
+        return;
+    }
+    if(AsyncUpstreamTask* at = dynamic_cast<AsyncUpstreamTask*>(bt.get()))
+    {//the callback is run in the thread pool as the worker_action of the task
+        if(Status::Ok != uss.getStatus())
+        {
+            at->m_error = uss.getError();
+            bt->getInput().reset();
+        }
+        bt->setLastStatus(Status::None);
+        Execute(bt);
+        return;
+    }
     UpstreamTask* ust = dynamic_cast<UpstreamTask*>(bt.get());
     if(ust)
     {
@@ -926,14 +1125,14 @@ void TaskManager::upstreamDoneProcess(UpstreamSender& uss)
         bt->setError(uss.getError().c_str(), uss.getStatus());
         LOG_PRINT_RQS_BT(2,bt, "CryptoNode done with error: " << uss.getError().c_str());
         assert(Status::Error == bt->getLastStatus()); //Status::Error only possible value now
-        respondAndDie(bt, bt->getOutput().data());
+        respondAndDie(bt, takeResponse(bt));
 
         return;
     }
     //here you can send a job to the thread pool or send response to client
     //uss will be destroyed on exit, save its result
     {//now always create a job and put it to the thread pool after CryptoNode
-        LOG_PRINT_RQS_BT(2,bt, "CryptoNode answered : '" << make_dump_output( bt->getInput().body, getCopts().log_trunc_to_size ) << "'");
+        LOG_PRINT_RQS_BT(2,bt, "CryptoNode answered : '" << make_dump_output( bt->getInput().data(), getCopts().log_trunc_to_size ) << "'");
         if(!bt->getSelf())
         {//it is possible that a client has closed connection already
             return;
@@ -949,6 +1148,13 @@ BaseTask::BaseTask(TaskManager& manager, const Router::JobParams& params)
 {
 }
 
+BaseTask::BaseTask(TaskManager& manager, Router::JobParams&& params)
+    : m_manager(manager)
+    , m_params(std::move(params))
+    , m_ctx(manager.getGcm())
+{
+}
+
 const char* BaseTask::getStrStatus(Status s)
 {
     assert(s<=Status::Stop);
@@ -966,6 +1172,18 @@ void UpstreamTask::finalize()
     releaseItself();
 }
 
+void AsyncUpstreamTask::finalize()
+{
+    releaseItself();
+}
+
+void FanOutTask::finalize()
+{
+    m_parent.reset();
+    m_round.reset();
+    releaseItself();
+}
+
 void PeriodicTask::finalize()
 {
     if(m_ctx.local.getLastStatus() == Status::Stop)
@@ -990,8 +1208,8 @@ std::chrono::milliseconds PeriodicTask::getTimeout()
     return std::chrono::milliseconds(v);
 }
 
-ClientTask::ClientTask(ConnectionManager* connectionManager, mg_connection *client, Router::JobParams& prms)
-    : BaseTask(ConnectionBase::from( getMgr(client) )->getLooper(), prms)
+ClientTask::ClientTask(ConnectionManager* connectionManager, mg_connection *client, Router::JobParams&& prms)
+    : BaseTask(*Looper::from( getMgr(client) ), std::move(prms))
     , m_connectionManager(connectionManager)
     , m_client(client)
 {
@@ -0,0 +1,212 @@
+#include "lib/graft/timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace graft {
+
+TimingWheel::TimingWheel()
+    : m_origin(ch::steady_clock::now())
+{
+    std::fill(std::begin(m_heads), std::end(m_heads), npos);
+    memset(m_bitmap, 0, sizeof(m_bitmap));
+}
+
+uint64_t TimingWheel::toTick(time_point now) const
+{
+    if(now <= m_origin) return 0;
+    return ch::duration_cast<ch::milliseconds>(now - m_origin).count();
+}
+
+TimingWheel::Handle TimingWheel::add(ch::milliseconds timeout, Callback cb, time_point now)
+{
+    uint32_t index;
+    if(m_free.empty())
+    {
+        index = m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    else
+    {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    Node& node = m_nodes[index];
+    node.expires = toTick(now) + std::max(ch::milliseconds::rep(0), timeout.count());
+    node.cb = std::move(cb);
+    //the current tick is processed already
+    link(index, m_current + 1);
+    ++m_count;
+    return Handle(index, node.generation);
+}
+
+bool TimingWheel::pending(const Handle& handle) const
+{
+    if(m_nodes.size() <= handle.m_index) return false;
+    const Node& node = m_nodes[handle.m_index];
+    return node.slot != npos && node.generation == handle.m_generation;
+}
+
+void TimingWheel::cancel(Handle& handle)
+{
+    if(pending(handle))
+    {
+        unlink(handle.m_index);
+        release(handle.m_index);
+    }
+    handle = Handle();
+}
+
+void TimingWheel::link(uint32_t index, uint64_t base)
+{
+    Node& node = m_nodes[index];
+    if(node.expires < base) node.expires = base;
+    uint64_t delta = node.expires - m_current;
+
+    int level = 0;
+    while(level < Levels - 1 && (delta >> (SlotBits * (level + 1))) != 0) ++level;
+    if((delta >> (SlotBits * Levels)) != 0)
+    {//too far, it will be placed again on the last cascade
+        node.expires = m_current + (uint64_t(1) << (SlotBits * Levels)) - 1;
+    }
+    uint32_t idx = (node.expires >> (SlotBits * level)) & SlotMask;
+    uint32_t slot = level * Slots + idx;
+
+    node.slot = slot;
+    node.prev = npos;
+    node.next = m_heads[slot];
+    if(node.next != npos) m_nodes[node.next].prev = index;
+    m_heads[slot] = index;
+    m_bitmap[level][idx / 64] |= uint64_t(1) << (idx % 64);
+}
+
+void TimingWheel::unlink(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    assert(node.slot != npos);
+    if(node.prev != npos) m_nodes[node.prev].next = node.next;
+    else m_heads[node.slot] = node.next;
+    if(node.next != npos) m_nodes[node.next].prev = node.prev;
+
+    if(m_heads[node.slot] == npos)
+    {
+        uint32_t level = node.slot / Slots, idx = node.slot % Slots;
+        m_bitmap[level][idx / 64] &= ~(uint64_t(1) << (idx % 64));
+    }
+    node.prev = node.next = npos;
+}
+
+void TimingWheel::release(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    node.slot = npos;
+    ++node.generation;
+    node.cb = nullptr;
+    m_free.push_back(index);
+    --m_count;
+}
+
+void TimingWheel::cascade(int level, uint32_t idx)
+{
+    uint32_t slot = level * Slots + idx;
+    uint32_t index = m_heads[slot];
+    m_heads[slot] = npos;
+    m_bitmap[level][idx / 64] &= ~(uint64_t(1) << (idx % 64));
+    while(index != npos)
+    {
+        uint32_t next = m_nodes[index].next;
+        //the timers of the current tick go to the level 0 slot that is fired next
+        link(index, m_current);
+        index = next;
+    }
+}
+
+void TimingWheel::tick()
+{
+    ++m_current;
+    if((m_current & SlotMask) == 0)
+    {
+        for(int level = 1; level < Levels; ++level)
+        {
+            uint32_t idx = (m_current >> (SlotBits * level)) & SlotMask;
+            cascade(level, idx);
+            if(idx != 0) break;
+        }
+    }
+}
+
+size_t TimingWheel::eval(time_point now)
+{
+    size_t fired = 0;
+    uint64_t target = toTick(now);
+    while(m_current < target)
+    {
+        if(m_count == 0)
+        {
+            m_current = target;
+            break;
+        }
+        if(firstSet(0, (m_current + 1) & SlotMask) < 0)
+        {//nothing to fire until the next cascade
+            uint64_t last = m_current | SlotMask;
+            m_current = std::min(target, last);
+            if(m_current == target) break;
+        }
+        tick();
+        uint32_t& head = m_heads[m_current & SlotMask];
+        while(head != npos)
+        {
+            uint32_t index = head;
+            unlink(index);
+            //the callback can add and cancel timers, so the node is released before the call
+            Callback cb = std::move(m_nodes[index].cb);
+            release(index);
+            cb();
+            ++fired;
+        }
+    }
+    return fired;
+}
+
+int TimingWheel::firstSet(int level, uint32_t from) const
+{
+    const uint64_t* bits = m_bitmap[level];
+    uint32_t shift = from % 64;
+    for(uint32_t i = 0; i <= Words; ++i)
+    {
+        uint32_t w = (from / 64 + i) % Words;
+        uint64_t word = bits[w];
+        if(i == 0) word &= ~uint64_t(0) << shift;
+        else if(i == Words) word &= (uint64_t(1) << shift) - 1;
+        if(word)
+        {
+            uint32_t pos = w * 64 + __builtin_ctzll(word);
+            return (pos - from) & SlotMask;
+        }
+    }
+    return -1;
+}
+
+ch::milliseconds TimingWheel::nextTimeout(time_point now) const
+{
+    if(m_count == 0) return ch::milliseconds::max();
+
+    uint64_t deadline = UINT64_MAX;
+    int d = firstSet(0, (m_current + 1) & SlotMask);
+    if(0 <= d) deadline = m_current + 1 + d;
+    for(int level = 1; level < Levels; ++level)
+    {
+        uint64_t cur = m_current >> (SlotBits * level);
+        d = firstSet(level, (cur + 1) & SlotMask);
+        if(d < 0) continue;
+        //the slot is cascaded when the tick reaches its beginning
+        deadline = std::min(deadline, (cur + 1 + d) << (SlotBits * level));
+    }
+    assert(deadline != UINT64_MAX);
+
+    uint64_t tick = toTick(now);
+    return ch::milliseconds((deadline <= tick)? 0 : deadline - tick);
+}
+
+}//namespace graft
@@ -28,6 +28,7 @@
 //
 
 #include "rta/DaemonRpcClient.h"
+#include "lib/graft/thread_pool/worker.hpp"
 #include <rpc/core_rpc_server_commands_defs.h>
 #include <storages/http_abstract_invoke.h>
 #include <cryptonote_basic/cryptonote_format_utils.h>
@@ -61,6 +62,14 @@ DaemonRpcClient::~DaemonRpcClient()
 
 }
 
+template <typename Request, typename Response>
+bool DaemonRpcClient::invoke_http_json(const std::string &uri, const Request &req, Response &res)
+{
+    // a thread pool worker waiting for the daemon is compensated by another thread
+    tp::BlockingRegion blocking;
+    return epee::net_utils::invoke_http_json(uri, req, res, m_http_client, m_rpc_timeout);
+}
+
 bool DaemonRpcClient::get_tx_from_pool(const string &hash_str, cryptonote::transaction &out_tx)
 {
     crypto::hash hash;
@@ -73,7 +82,7 @@ bool DaemonRpcClient::get_tx_from_pool(const string &hash_str, cryptonote::trans
     cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::request req;
     cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::response res;
 
-    bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, m_http_client, m_rpc_timeout);
+    bool r = invoke_http_json("/get_transaction_pool_hashes.bin", req, res);
     if (!r) {
         LOG_ERROR("/get_transaction_pool_hashes.bin error");
         return r;
@@ -102,7 +111,7 @@ bool DaemonRpcClient::get_tx(const string &hash_str, cryptonote::transaction &ou
     req_tx.txs_hashes.push_back(hash_str);
 
     req_tx.decode_as_json = false;
-    bool r = epee::net_utils::invoke_http_json("/gettransactions", req_tx, res_tx, m_http_client, m_rpc_timeout);
+    bool r = invoke_http_json("/gettransactions", req_tx, res_tx);
     if (!r && res_tx.status != CORE_RPC_STATUS_OK) {
         LOG_ERROR("/getransactions error");
         return false;
@@ -144,7 +153,7 @@ bool DaemonRpcClient::get_height(uint64_t &height)
     // get full tx
     cryptonote::COMMAND_RPC_GET_HEIGHT::request req;
     cryptonote::COMMAND_RPC_GET_HEIGHT::response res =  boost::value_initialized<cryptonote::COMMAND_RPC_GET_HEIGHT::response>();
-    bool r = epee::net_utils::invoke_http_json("/getheight", req, res, m_http_client, m_rpc_timeout);
+    bool r = invoke_http_json("/getheight", req, res);
     if (!r && res.status != CORE_RPC_STATUS_OK) {
         LOG_ERROR("/getheight error");
         return false;
@@ -162,7 +171,7 @@ bool DaemonRpcClient::get_block_hash(uint64_t height, string &hash)
     req_t.id = epee::serialization::storage_entry(0);
     req_t.method = "on_getblockhash";
     req_t.params.push_back(height);
-    bool ok = epee::net_utils::invoke_http_json("/json_rpc", req_t, resp_t, m_http_client, m_rpc_timeout);
+    bool ok = invoke_http_json("/json_rpc", req_t, resp_t);
     if (!ok) {
         LOG_ERROR("/on_getblockhash error");
         return false;
@@ -181,7 +190,7 @@ bool DaemonRpcClient::send_supernode_stakes(const char* network_address, const c
     req.method = "send_supernode_stakes";
     req.params.network_address = network_address;
     req.params.supernode_public_id = id;
-    bool r = epee::net_utils::invoke_http_json("/json_rpc/rta", req, res, m_http_client, m_rpc_timeout);
+    bool r = invoke_http_json("/json_rpc/rta", req, res);
     if (!r) {
         LOG_ERROR("/json_rpc/rta/send_supernode_stakes error");
         return false;
@@ -200,7 +209,7 @@ bool DaemonRpcClient::send_supernode_blockchain_based_list(const char* network_a
     req.params.network_address = network_address;
     req.params.supernode_public_id = id;
     req.params.last_received_block_height = last_received_block_height;
-    bool r = epee::net_utils::invoke_http_json("/json_rpc/rta", req, res, m_http_client, m_rpc_timeout);
+    bool r = invoke_http_json("/json_rpc/rta", req, res);
     if (!r) {
         LOG_ERROR("/json_rpc/rta/send_supernode_blockchain_based_list error");
         return false;
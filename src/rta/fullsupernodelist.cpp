@@ -551,17 +551,19 @@ bool check_timeout_expired(boost::posix_time::ptime& next_recv_time)
 
 }
 
-void FullSupernodeList::synchronizeWithCryptonode(const char* network_address, const char* address)
+bool FullSupernodeList::needStakes()
 {
-    if (check_timeout_expired(m_next_recv_stakes))
-    {
-        m_rpc_client.send_supernode_stakes(network_address, address);
-    }
+    return check_timeout_expired(m_next_recv_stakes);
+}
 
-    if (check_timeout_expired(m_next_recv_blockchain_based_list))
-    {
-        m_rpc_client.send_supernode_blockchain_based_list(network_address, address, m_blockchain_based_list_max_block_number);
-    }
+bool FullSupernodeList::needBlockchainBasedList(uint64_t& last_received_block_height)
+{
+    if (!check_timeout_expired(m_next_recv_blockchain_based_list))
+        return false;
+
+    last_received_block_height = m_blockchain_based_list_max_block_number;
+
+    return true;
 }
 
 uint64_t FullSupernodeList::getBlockchainHeight() const
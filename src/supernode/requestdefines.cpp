@@ -5,6 +5,7 @@
 #include "rta/supernode.h"
 #include "supernode/requests/broadcast.h"
 #include "supernode/requests/sale_status.h"
+#include "supernode/services.h"
 
 #include <string_tools.h> // epee
 #include <misc_log_ex.h>
@@ -120,9 +121,7 @@ Status errorCustomError(const std::string& message, int code, Output& output)
 
 void cleanPaySaleData(const std::string& payment_id, Context& ctx)
 {
-    ctx.global.remove(payment_id + CONTEXT_KEY_PAY);
-    ctx.global.remove(payment_id + CONTEXT_KEY_SALE);
-    ctx.global.remove(payment_id + CONTEXT_KEY_STATUS);
+    ctx.services().get<services::PaymentStates>()->remove(payment_id);
 }
 
 void buildBroadcastSaleStatusOutput(const std::string& payment_id, int status, const SupernodePtr& supernode, Output& output)
@@ -33,6 +33,7 @@
 #include "supernode/requests/multicast.h"
 #include "supernode/requests/broadcast.h"
 #include "rta/supernode.h"
+#include "supernode/services.h"
 #include <misc_log_ex.h>
 #include <exception>
 
@@ -49,12 +50,6 @@ namespace {
 
 namespace graft::supernode::request {
 
-GRAFT_DEFINE_IO_STRUCT_INITED(SupernodeSignature,
-                              (std::string, id_key, std::string()),
-                              (std::string, result_signature, std::string()), // signarure for tx_id + result
-                              (std::string, tx_signature, std::string())      // signature for tx_id only
-                              );
-
 GRAFT_DEFINE_IO_STRUCT_INITED(AuthorizeRtaTxRequestResponse,
                         (int, Result, STATUS_OK)
                        );
@@ -88,29 +83,6 @@ enum class RtaAuthResponseHandlerState : int {
     StatusBroadcastReply
 };
 
-struct RtaAuthResult
-{
-    std::vector<SupernodeSignature> approved;
-    std::vector<SupernodeSignature> rejected;
-    bool alreadyApproved(const std::string &id)
-    {
-        return contains(approved, id);
-    }
-
-    bool alreadyRejected(const std::string &id)
-    {
-        return contains(rejected, id);
-    }
-
-private:
-    bool contains(const std::vector<SupernodeSignature> &v, const std::string &id)
-    {
-        return std::find_if(v.begin(), v.end(), [&](const SupernodeSignature &item) {
-            return item.id_key == id;
-        }) != v.end();
-    }
-};
-
 // TODO: this function duplicates PendingTransaction::putRtaSignatures
 void putRtaSignaturesToTx(cryptonote::transaction &tx, const std::vector<SupernodeSignature> &signatures, bool testnet)
 {
@@ -198,7 +170,7 @@ Status storeRequestAndReplyOk(const Router::vars_t& vars, const graft::Input& in
         return errorCustomError(string("failed to parse request: ")  + input.data(), ERROR_INVALID_REQUEST, output);
     }
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     AuthorizeRtaTxRequest authReq;
     Input innerInput;
@@ -248,7 +220,7 @@ Status handleTxAuthRequest(const Router::vars_t& vars, const graft::Input& /*inp
         return errorCustomError(string("failed to parse request: ")  + input.data(), ERROR_INVALID_REQUEST, output);
     }
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     AuthorizeRtaTxRequest authReq;
     Input innerInput;
@@ -277,15 +249,17 @@ Status handleTxAuthRequest(const Router::vars_t& vars, const graft::Input& /*inp
     MDEBUG("incoming auth req for payment: " << authReq.payment_id
            << ", tx_id: " << tx_id_str);
     // check if we already processed this tx
-    if (ctx.global.hasKey(tx_id_str + CONTEXT_KEY_TX_BY_TXID)) {
+    PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
+    bool processed = false;
+    string known_payment_id = payments.paymentIdByTx(tx_id_str);
+    if (!known_payment_id.empty()) {
+        payments.read(known_payment_id, [&processed](const PaymentState &state) { processed = state.tx != nullptr; });
+    }
+    if (processed) {
         LOG_ERROR("tx already processed: " << tx_id_str);
         return errorCustomError("tx already processed", ERROR_INVALID_PARAMS, output);
     }
 
-    // store tx amount in global context
-    MDEBUG("storing amount for payment: " << authReq.payment_id
-           << ", tx_id: " << tx_id_str << ", amount: " << authReq.amount);
-    ctx.global.set(tx_id_str + CONTEXT_KEY_AMOUNT_BY_TX_ID, authReq.amount, RTA_TX_TTL);
     // check if we have a fee assigned by sender wallet
     uint64 amount = 0;
     if (!supernode->getAmountFromTx(tx, amount)) {
@@ -307,10 +281,15 @@ Status handleTxAuthRequest(const Router::vars_t& vars, const graft::Input& /*inp
     signAuthResponse(authResponse, supernode);
     authResponse.signature.id_key  = supernode->idKeyAsString();
 
-    // store tx
-    ctx.global.set(authResponse.tx_id + CONTEXT_KEY_TX_BY_TXID, tx, RTA_TX_TTL);
-    // TODO: remove it when payment id will be in tx.extra
-    ctx.global.set(authResponse.tx_id + CONTEXT_KEY_PAYMENT_ID_BY_TXID, authReq.payment_id, RTA_TX_TTL);
+    // store tx and its amount, map tx_id -> payment_id
+    // TODO: remove the mapping when payment id will be in tx.extra
+    MDEBUG("storing amount for payment: " << authReq.payment_id
+           << ", tx_id: " << tx_id_str << ", amount: " << authReq.amount);
+    std::shared_ptr<const cryptonote::transaction> stored_tx = std::make_shared<cryptonote::transaction>(std::move(tx));
+    payments.bindTx(authResponse.tx_id, authReq.payment_id, [&](PaymentState &state) {
+        state.txAmount = authReq.amount;
+        state.tx = std::move(stored_tx);
+    });
 
     // store payment id in local ctx for the logging purposes
     ctx.local["payment_id"] = authReq.payment_id;
@@ -393,7 +372,7 @@ Status handleRtaAuthResponseMulticast(const Router::vars_t& vars, const graft::I
             return errorInvalidParams(output);
         }
 
-        SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+        const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
         RTAAuthResult result = static_cast<RTAAuthResult>(rtaAuthResp.result);
         // sanity check
@@ -403,13 +382,13 @@ Status handleRtaAuthResponseMulticast(const Router::vars_t& vars, const graft::I
         }
 
 
-        string ctx_payment_id_key = rtaAuthResp.tx_id + CONTEXT_KEY_PAYMENT_ID_BY_TXID;
+        PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
+        string payment_id = payments.paymentIdByTx(rtaAuthResp.tx_id);
 
-        if (!ctx.global.hasKey(ctx_payment_id_key)) {
+        if (payment_id.empty()) {
             LOG_ERROR("no payment_id for tx: " << rtaAuthResp.tx_id);
             return errorCustomError(string("unknown tx: ") + rtaAuthResp.tx_id, ERROR_INTERNAL_ERROR, output);
         }
-        string payment_id = ctx.global.get(ctx_payment_id_key, std::string());
         MDEBUG("incoming tx auth response payment: " << payment_id
                      << ", tx_id: " << rtaAuthResp.tx_id
                      << ", from: " << rtaAuthResp.signature.id_key
@@ -427,63 +406,65 @@ Status handleRtaAuthResponseMulticast(const Router::vars_t& vars, const graft::I
                                     ERROR_RTA_SIGNATURE_FAILED,
                                     output);
         }
-        // stop handling it if we already processed response
-        RtaAuthResult authResult;
-        string ctx_tx_to_auth_resp = rtaAuthResp.tx_id + CONTEXT_KEY_AUTH_RESULT_BY_TXID;
-        if (ctx.global.hasKey(ctx_tx_to_auth_resp)) {
-            authResult = ctx.global.get(ctx_tx_to_auth_resp, authResult);
-        }
+        // stop handling it if we already processed response, otherwise store the vote
+        bool already_processed = false;
+        size_t approved_votes = 0, rejected_votes = 0, rta_votes_to_approve = 0;
+        std::vector<SupernodeSignature> approved_signatures;
+        std::shared_ptr<const cryptonote::transaction> storedTx;
+        payments.update(payment_id, [&](PaymentState &state) {
+            RtaAuthResult &authResult = state.votes;
+            if (authResult.alreadyApproved(rtaAuthResp.signature.id_key)
+                    || authResult.alreadyRejected(rtaAuthResp.signature.id_key)) {
+                already_processed = true;
+                return;
+            }
+
+            if (result == RTAAuthResult::Approved) {
+                authResult.approved.push_back(rtaAuthResp.signature);
+            } else {
+                authResult.rejected.push_back(rtaAuthResp.signature);
+            }
 
-        if (authResult.alreadyApproved(rtaAuthResp.signature.id_key)
-                || authResult.alreadyRejected(rtaAuthResp.signature.id_key)) {
+            rta_votes_to_approve = state.txAmount / COIN > 100 ? 4 : 2;
+            approved_votes = authResult.approved.size();
+            rejected_votes = authResult.rejected.size();
+            if (rejected_votes < RTA_VOTES_TO_REJECT && approved_votes >= rta_votes_to_approve) {
+                approved_signatures = authResult.approved;
+            }
+            storedTx = state.tx;
+        });
+
+        if (already_processed) {
             return errorCustomError(string("supernode: ") + rtaAuthResp.signature.id_key + " already processed",
                                     ERROR_ADDRESS_INVALID, output);
         }
 
-        if (result == RTAAuthResult::Approved) {
-            authResult.approved.push_back(rtaAuthResp.signature);
-        } else {
-            authResult.rejected.push_back(rtaAuthResp.signature);
-        }
-
         MDEBUG("rta result accepted from " << rtaAuthResp.signature.id_key
                << ", payment: " << payment_id);
 
-        // store result in context
-        ctx.global.set(ctx_tx_to_auth_resp, authResult, RTA_TX_TTL);
-        if (!ctx.global.hasKey(rtaAuthResp.tx_id + CONTEXT_KEY_AMOUNT_BY_TX_ID)) {
-            string msg = string("no amount found for tx id: ") + rtaAuthResp.tx_id;
-            LOG_ERROR(msg);
-            return errorCustomError(msg, ERROR_INTERNAL_ERROR, output);
-        }
-
-        uint64_t tx_amount = ctx.global.get(rtaAuthResp.tx_id + CONTEXT_KEY_AMOUNT_BY_TX_ID, uint64_t(0));
-
-        size_t rta_votes_to_approve = tx_amount / COIN > 100 ? 4 : 2;
-
-        MDEBUG("approved votes: " << authResult.approved.size()
+        MDEBUG("approved votes: " << approved_votes
                << "/" << rta_votes_to_approve
-               << ", rejected votes: " << authResult.rejected.size()
+               << ", rejected votes: " << rejected_votes
                << ", payment: " << payment_id);
 
 
-        if (!ctx.global.hasKey(rtaAuthResp.tx_id + CONTEXT_KEY_TX_BY_TXID)) {
+        if (!storedTx) {
             string msg = string("rta auth response processed but no tx found for tx id: ") + rtaAuthResp.tx_id;
             LOG_ERROR(msg);
             return errorCustomError(msg, ERROR_INTERNAL_ERROR, output);
         }
 
-        if (authResult.rejected.size() >= RTA_VOTES_TO_REJECT) {
+        if (rejected_votes >= RTA_VOTES_TO_REJECT) {
             MDEBUG("payment: " << payment_id
                    << ", tx_id: " << rtaAuthResp.tx_id
                    << " rejected by auth sample, updating status");
 
             // tx rejected by auth sample, broadcast status;
             ctx.global[__FUNCTION__] = RtaAuthResponseHandlerState::StatusBroadcastReply;
-            ctx.global.set(payment_id + CONTEXT_KEY_STATUS, static_cast<int> (RTAStatus::Fail), RTA_TX_TTL);
+            payments.setStatus(payment_id, static_cast<int> (RTAStatus::Fail));
             buildBroadcastSaleStatusOutput(payment_id, static_cast<int> (RTAStatus::Fail), supernode, output);
             return Status::Forward;
-        } else if (authResult.approved.size() >= rta_votes_to_approve) {
+        } else if (approved_votes >= rta_votes_to_approve) {
             MDEBUG("payment: " << payment_id
                    << ", tx_id: " << rtaAuthResp.tx_id
                    << " approved by auth sample, pushing tx to pool");
@@ -491,8 +472,8 @@ Status handleRtaAuthResponseMulticast(const Router::vars_t& vars, const graft::I
             SendRawTxRequest req;
             // store tx_id in local context so we can use it when broadcasting status
             ctx.local[CONTEXT_TX_ID] = rtaAuthResp.tx_id;
-            cryptonote::transaction tx = ctx.global.get(rtaAuthResp.tx_id + CONTEXT_KEY_TX_BY_TXID, cryptonote::transaction());
-            putRtaSignaturesToTx(tx, authResult.approved, supernode->testnet());
+            cryptonote::transaction tx = *storedTx;
+            putRtaSignaturesToTx(tx, approved_signatures, supernode->testnet());
             createSendRawTxRequest(tx, req);
 #if 0
             // kept for future debugging
@@ -557,12 +538,13 @@ Status handleCryptonodeTxPushResponse(const Router::vars_t& vars, const graft::I
     }
 
     // obtain payment id for given tx_id
-    string payment_id = ctx.global.get(tx_id + CONTEXT_KEY_PAYMENT_ID_BY_TXID, std::string());
+    PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
+    string payment_id = payments.paymentIdByTx(tx_id);
     if (payment_id.empty()) {
         LOG_ERROR("Internal error, payment id not found for tx id: " << tx_id);
     }
 
-    RTAStatus status = static_cast<RTAStatus>(ctx.global.get(payment_id + CONTEXT_KEY_STATUS, int(RTAStatus::None)));
+    RTAStatus status = static_cast<RTAStatus>(payments.status(payment_id));
     if (status == RTAStatus::None) {
         LOG_ERROR("can't find status for payment_id: " << payment_id);
         return errorInvalidParams(output);
@@ -596,7 +578,7 @@ Status handleCryptonodeTxPushResponse(const Router::vars_t& vars, const graft::I
         status = RTAStatus::Success;
     }
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     MDEBUG("broadcasting status for payment id: " << payment_id << ", status : " << int(status));
     buildBroadcastSaleStatusOutput(payment_id, int(status), supernode, output);
@@ -712,9 +694,10 @@ void registerAuthorizeRtaTxRequests(graft::Router &router)
 {
     Router::Handler3 request_handler(nullptr, authorizeRtaTxRequestHandler, nullptr);
     Router::Handler3 response_handler(nullptr, authorizeRtaTxResponseHandler, nullptr);
-    router.addRoute(PATH_REQUEST, METHOD_POST, request_handler);
+    //the votes gate live payments, they should not wait behind the other requests
+    router.addRoute(PATH_REQUEST, METHOD_POST, request_handler, Priority::High);
     LOG_PRINT_L1("route " << PATH_REQUEST << " registered");
-    router.addRoute(PATH_RESPONSE, METHOD_POST, response_handler);
+    router.addRoute(PATH_RESPONSE, METHOD_POST, response_handler, Priority::High);
     LOG_PRINT_L1("route " << PATH_RESPONSE << " registered");
 }
 
@@ -29,6 +29,7 @@
 #include "supernode/requests/blockchain_based_list.h"
 #include "supernode/requestdefines.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 #include "rta/supernode.h"
 
 #include <misc_log_ex.h>
@@ -54,8 +55,8 @@ Status blockchainBasedListHandler
 {
     LOG_PRINT_L1(PATH << " called with payload: " << input.data());
 
-    boost::shared_ptr<FullSupernodeList> fsl = ctx.global.get("fsl", boost::shared_ptr<FullSupernodeList>());
-    SupernodePtr supernode = ctx.global.get("supernode", SupernodePtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     if (!fsl.get()) {
         LOG_ERROR("Internal error. Supernode list object missing");
@@ -9,6 +9,7 @@
 #include "lib/graft/requesttools.h"
 #include "rta/supernode.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 
 #include <misc_log_ex.h>
 #include <cryptonote_protocol/blobdatatype.h>
@@ -49,12 +50,12 @@ Status getSupernodeList(const Router::vars_t& vars, const graft::Input& input,
     bool validOnly = true;
 
     try {
-        validOnly = stoul(vars.find("all")->second) == 0;
+        validOnly = stoul(std::string(vars.find("all")->second)) == 0;
     } catch (...) {
         return errorInternalError("invalid input", output);
     }
 
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
     auto supernodes = fsl->items();
 
     SupernodeListJsonRpcResult resp;
@@ -116,7 +117,7 @@ Status getAuthSample(const Router::vars_t& vars, const graft::Input& input,
 {
 
 
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
     std::vector<SupernodePtr> sample;
     uint64_t sample_block_number = 0;
 
@@ -165,7 +166,7 @@ Status doAnnounce(const Router::vars_t& vars, const graft::Input& input,
 Status closeStakeWallets(const Router::vars_t& vars, const graft::Input& input,
                         graft::Context& ctx, graft::Output& output)
 {
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
     auto items = fsl->items();
     for (const auto &sn : items) {
         fsl->remove(sn);
@@ -197,12 +198,12 @@ Status getBlockchainBasedListImpl(const Router::vars_t& vars, const graft::Input
     uint64_t block_height = 0;
 
     try {
-        block_height = stoull(vars.find("block_height")->second);
+        block_height = stoull(std::string(vars.find("block_height")->second));
     } catch (...) {
         return errorInternalError("invalid input", output);
     }
 
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
 
     DbgBlockchainBasedListResponseJsonRpcResult resp;
 
@@ -269,12 +270,12 @@ void __registerDebugRequests(Router &router)
 #define _HANDLER(h) {nullptr, graft::supernode::request::debug::h, nullptr}
     // /debug/supernode_list/0 -> do not include inactive items
     // /debug/supernode_list/1 -> include inactive items
-    router.addRoute("/debug/supernode_list/{all:[0-1]}", METHOD_GET, _HANDLER(getSupernodeList));
-    router.addRoute("/debug/blockchain_based_list/{block_height:[0-9]+}", METHOD_GET, _HANDLER(getBlockchainBasedList<BlockchainBasedListMode_Source>));
-    router.addRoute("/debug/auth_sample_blockchain_based_list/{block_height:[0-9]+}", METHOD_GET, _HANDLER(getBlockchainBasedList<BlockchainBasedListMode_ForAuthSample>));
-    router.addRoute("/debug/announce", METHOD_POST, _HANDLER(doAnnounce));
-    router.addRoute("/debug/close_wallets/", METHOD_POST, _HANDLER(closeStakeWallets));
-    router.addRoute("/debug/auth_sample/{payment_id:[0-9a-zA-Z]+}", METHOD_GET, _HANDLER(getAuthSample));
+    router.addRoute("/debug/supernode_list/{all:[0-1]}", METHOD_GET, _HANDLER(getSupernodeList), Priority::Bulk);
+    router.addRoute("/debug/blockchain_based_list/{block_height:[0-9]+}", METHOD_GET, _HANDLER(getBlockchainBasedList<BlockchainBasedListMode_Source>), Priority::Bulk);
+    router.addRoute("/debug/auth_sample_blockchain_based_list/{block_height:[0-9]+}", METHOD_GET, _HANDLER(getBlockchainBasedList<BlockchainBasedListMode_ForAuthSample>), Priority::Bulk);
+    router.addRoute("/debug/announce", METHOD_POST, _HANDLER(doAnnounce), Priority::Bulk);
+    router.addRoute("/debug/close_wallets/", METHOD_POST, _HANDLER(closeStakeWallets), Priority::Bulk);
+    router.addRoute("/debug/auth_sample/{payment_id:[0-9a-zA-Z]+}", METHOD_GET, _HANDLER(getAuthSample), Priority::Bulk);
 }
 
 }
@@ -16,18 +16,18 @@ void registerForward(Router& router)
         {
 
             auto it = vars.equal_range("forward");
-            if(it.first == vars.end())
+            if(it.first == it.second)
             {
                 throw std::runtime_error("cannot find 'forward' var");
             }
-            auto& forward = it.first->second;
+            std::string forward(it.first->second);
             if(++it.first != it.second)
             {
                 throw std::runtime_error("multiple 'forward' vars found");
             }
 
             ctx.setCallback();
-            output.body = input.body;
+            output.body = input.data();
             output.uri = "$walletnode";
             output.path = "/api/" + forward;
             return Status::Forward;
@@ -39,14 +39,14 @@ void registerForward(Router& router)
         case Status::Postpone:
         {
             //generic callback should set the input that it has received from walletnode
-            output.body = input.body;
+            output.body = input.data();
             return graft::Status::Ok;
         }
         }
         assert(false);
     };
 
-    router.addRoute("/walletapi/{forward:create_account|restore_account|wallet_balance|prepare_transfer|transaction_history}",METHOD_POST,{nullptr,forward,nullptr});
+    router.addRoute("/walletapi/{forward:create_account|restore_account|wallet_balance|prepare_transfer|transaction_history}",METHOD_POST,{nullptr,forward,nullptr}, graft::Priority::Bulk);
 }
 
 void registerForwardRequest(Router& router)
@@ -56,30 +56,31 @@ void registerForwardRequest(Router& router)
         if(ctx.local.getLastStatus() == graft::Status::None)
         {
             auto it = vars.equal_range("forward");
-            auto& path = it.first->second;
-            if(it.first == vars.end())
+            if(it.first == it.second)
             {
                 throw std::runtime_error("cannot find 'forward' var");
             }
+            std::string path(it.first->second);
             if(++it.first != it.second)
             {
                 throw std::runtime_error("multiple 'forward' vars found");
             }
-            output.body = input.body;
+            output.body = input.data();
             output.path = path;
             return graft::Status::Forward;
         }
         if(ctx.local.getLastStatus() == graft::Status::Forward)
         {
-            output.body = input.body;
+            output.body = input.data();
             return graft::Status::Ok;
         }
         return graft::Status::Error;
     };
 
-    //METHOD_GET is required here because some GET requests from the wallet has body
+    //METHOD_GET is required here because some GET requests from the wallet has body;
+    //a wallet resync floods these routes, they should not delay the RTA requests
     router.addRoute("/{forward:gethashes.bin|json_rpc|getblocks.bin|gettransactions|sendrawtransaction|getheight|get_transaction_pool_hashes.bin|get_outs.bin}",
-                               METHOD_POST|METHOD_GET, graft::Router::Handler3(forward,nullptr,nullptr));
+                               METHOD_POST|METHOD_GET, graft::Router::Handler3(forward,nullptr,nullptr), graft::Priority::Bulk);
 }
 
 }
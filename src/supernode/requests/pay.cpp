@@ -10,6 +10,7 @@
 #include "supernode/requests/authorize_rta_tx.h"
 #include "rta/supernode.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 
 #include <misc_log_ex.h>
 #include <cryptonote_protocol/blobdatatype.h>
@@ -20,8 +21,8 @@
 
 namespace graft::supernode::request {
 
-static const std::string scPayClientHandlerKey("PayClientHandlerState");
-static const std::string scPayRequestBody("PayRequestBody");
+static constexpr graft::Context::Local::Key scPayClientHandlerKey("PayClientHandlerState");
+static constexpr graft::Context::Local::Key scPayRequestBody("PayRequestBody");
 
 enum class PayHandlerState : int
 {
@@ -59,8 +60,8 @@ Status processAuthorizationRequest(const std::string &tx_hex, const PayRequest &
            << ", auth sample: " << authSample);
 
     // map tx_id -> payment id
-    ctx.global.set(epee::string_tools::pod_to_hex(tx_hash) + CONTEXT_KEY_PAYMENT_ID_BY_TXID,
-                   pay_request.PaymentID, RTA_TX_TTL);
+    PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
+    payments.bindTx(epee::string_tools::pod_to_hex(tx_hash), pay_request.PaymentID);
 
     // send multicast to /cryptonode/authorize_rta_tx_request
     MulticastRequestJsonRpc cryptonode_req;
@@ -83,9 +84,11 @@ Status processAuthorizationRequest(const std::string &tx_hex, const PayRequest &
     // store payment id as we need it to change the sale/pay state in next call
     ctx.local["payment_id"] = pay_request.PaymentID;
     // TODO: what is the purpose of PayData?
-    PayData data(pay_request.Address, pay_request.BlockNumber, pay_request.Amount);
-    ctx.global[pay_request.PaymentID + CONTEXT_KEY_PAY] = data;
-    ctx.global[pay_request.PaymentID + CONTEXT_KEY_STATUS] = static_cast<int>(RTAStatus::InProgress);
+    std::shared_ptr<const PayData> data = std::make_shared<PayData>(pay_request.Address, pay_request.BlockNumber, pay_request.Amount);
+    payments.update(pay_request.PaymentID, [&data](PaymentState &state) {
+        state.pay = std::move(data);
+        state.status = static_cast<int>(RTAStatus::InProgress);
+    });
 
     output.load(cryptonode_req);
     output.path = "/json_rpc/rta";
@@ -109,14 +112,14 @@ Status handleClientPayRequest(const Router::vars_t& vars, const graft::Input& in
     }
     const PayRequest &in = req.params;
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
     // we don't really need to check address here, as we supposed to receive transaction
     if (!supernode->validateAddress(in.Address, supernode->testnet())) {
         return errorInvalidAddress(output);
     }
 
-    int current_status = ctx.global.get(in.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    int current_status = ctx.services().get<services::PaymentStates>()->status(in.PaymentID);
     if (errorFinishedPayment(current_status, output)) {
         return Status::Error;
     }
@@ -200,14 +203,14 @@ Status handleWaitingTxReply(const Router::vars_t& vars, const graft::Input& inpu
     // TODO: !implement tx vector in every interface!
     string tx_hex = res.Transactions[0];
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
     // we don't really need to check address here, as we supposed to receive transaction
     if (!supernode->validateAddress(payData.Address, supernode->testnet())) {
         return errorInvalidAddress(output);
     }
 
-    int current_status = ctx.global.get(payData.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    int current_status = ctx.services().get<services::PaymentStates>()->status(payData.PaymentID);
     if (errorFinishedPayment(current_status, output)) {
         return Status::Error;
     }
@@ -233,11 +236,14 @@ Status handleTxAuthReply(const Router::vars_t& vars, const graft::Input& input,
     MulticastResponseFromCryptonodeJsonRpc resp;
     std::string payment_id = ctx.local["payment_id"];
 
+    PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
     JsonRpcErrorResponse error;
     if (!input.get(resp) || resp.error.code != 0 || resp.result.status != STATUS_OK) {
 
-        ctx.global.remove(payment_id + CONTEXT_KEY_PAY);
-        ctx.global.remove(payment_id + CONTEXT_KEY_STATUS);
+        payments.update(payment_id, [](PaymentState &state) {
+            state.pay.reset();
+            state.status = static_cast<int>(RTAStatus::None);
+        });
 
         error.error.code = ERROR_INTERNAL_ERROR;
         error.error.message = "Error multicasting request";
@@ -246,10 +252,10 @@ Status handleTxAuthReply(const Router::vars_t& vars, const graft::Input& input,
         return Status::Error;
     }
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
     MDEBUG("pay multicasted for payment: " << payment_id);
 
-    int status = ctx.global.get(payment_id + CONTEXT_KEY_STATUS, static_cast<int>((RTAStatus::InProgress)));
+    int status = payments.status(payment_id, static_cast<int>(RTAStatus::InProgress));
     buildBroadcastSaleStatusOutput(payment_id, status, supernode, output);
     MDEBUG("broadcasting status for payment:  " << payment_id);
     MDEBUG(__FUNCTION__ << " end");
@@ -331,7 +337,7 @@ Status payClientHandler(const Router::vars_t& vars, const graft::Input& input,
 void registerPayRequest(Router &router)
 {
     Router::Handler3 clientHandler(nullptr, payClientHandler, nullptr);
-    router.addRoute("/pay", METHOD_POST, clientHandler);
+    router.addRoute("/pay", METHOD_POST, clientHandler, Priority::High);
 }
 
 }
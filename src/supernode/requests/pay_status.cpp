@@ -1,6 +1,7 @@
 
 #include "supernode/requests/pay_status.h"
 #include "supernode/requestdefines.h"
+#include "supernode/services.h"
 #include "lib/graft/jsonrpc.h"
 #include <misc_log_ex.h>
 
@@ -28,7 +29,7 @@ Status payStatusHandler(const Router::vars_t& vars, const graft::Input& input,
 
     MDEBUG("requested status for payment: " << in.PaymentID);
 
-    int current_status = ctx.global.get(in.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    int current_status = ctx.services().get<services::PaymentStates>()->status(in.PaymentID);
     if (in.PaymentID.empty() || current_status == 0)
     {
         MWARNING("no status for payment: " << in.PaymentID);
@@ -1,6 +1,7 @@
 
 #include "supernode/requests/reject_pay.h"
 #include "supernode/requestdefines.h"
+#include "supernode/services.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "supernode.rejectpayrequest"
@@ -11,12 +12,13 @@ Status rejectPayHandler(const Router::vars_t& vars, const graft::Input& input,
                         graft::Context& ctx, graft::Output& output)
 {
     RejectPayRequest in = input.get<RejectPayRequest>();
-    int current_status = ctx.global.get(in.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
+    int current_status = payments.status(in.PaymentID);
     if (in.PaymentID.empty() || current_status == 0)
     {
         return errorInvalidPaymentID(output);
     }
-    ctx.global[in.PaymentID + CONTEXT_KEY_STATUS] = static_cast<int>(RTAStatus::RejectedByWallet);
+    payments.setStatus(in.PaymentID, static_cast<int>(RTAStatus::RejectedByWallet));
     // TODO: Reject Pay: Add broadcast and another business logic
     RejectPayResponse out;
     out.Result = STATUS_OK;
@@ -1,6 +1,7 @@
 
 #include "supernode/requests/reject_sale.h"
 #include "supernode/requestdefines.h"
+#include "supernode/services.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "supernode.rejectsalerequest"
@@ -11,12 +12,13 @@ Status rejectSaleHandler(const Router::vars_t& vars, const graft::Input& input,
                          graft::Context& ctx, graft::Output& output)
 {
     RejectSaleRequest in = input.get<RejectSaleRequest>();
-    int current_status = ctx.global.get(in.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    PaymentStateStore &payments = *ctx.services().get<services::PaymentStates>();
+    int current_status = payments.status(in.PaymentID);
     if (in.PaymentID.empty() || current_status == 0)
     {
         return errorInvalidPaymentID(output);
     }
-    ctx.global[in.PaymentID + CONTEXT_KEY_STATUS] = static_cast<int>(RTAStatus::RejectedByPOS);
+    payments.setStatus(in.PaymentID, static_cast<int>(RTAStatus::RejectedByPOS));
     // TODO: Reject Sale: Add broadcast and another business logic
     RejectSaleResponse out;
     out.Result = STATUS_OK;
@@ -8,6 +8,7 @@
 #include "lib/graft/requesttools.h"
 #include "rta/supernode.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 
 #include <string>
 
@@ -22,7 +23,6 @@ BOOST_HANA_ADAPT_STRUCT(graft::SaleData,
 
 namespace graft::supernode::request {
 
-static const std::chrono::seconds SALE_TTL = std::chrono::seconds(60);
 
 // message to be multicasted to auth sample
 GRAFT_DEFINE_IO_STRUCT(SaleDataMulticast,
@@ -57,7 +57,7 @@ Status handleClientSaleRequest(const Router::vars_t& vars, const graft::Input& i
         return errorInvalidAmount(output);
     }
 
-    bool testnet = ctx.global["testnet"];
+    bool testnet = ctx.services().get<services::Testnet>();
 
 
     std::string payment_id = in.PaymentID;
@@ -67,8 +67,8 @@ Status handleClientSaleRequest(const Router::vars_t& vars, const graft::Input& i
     }
 
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
 
     // reply to caller (POS)
     SaleData data(in.IdKey, fsl->getBlockchainBasedListMaxBlockNumber(), in.Amount);
@@ -76,11 +76,6 @@ Status handleClientSaleRequest(const Router::vars_t& vars, const graft::Input& i
     // what needs to be multicasted to auth sample ?
     // 1. payment_id
     // 2. SaleData
-    if (!in.SaleDetails.empty())
-    {
-        ctx.global.set(payment_id + CONTEXT_KEY_SALE_DETAILS, in.SaleDetails, SALE_TTL);
-    }
-
     // generate auth sample
     std::vector<SupernodePtr> authSample;
     uint64_t auth_sample_block_number = 0;
@@ -91,8 +86,17 @@ Status handleClientSaleRequest(const Router::vars_t& vars, const graft::Input& i
     // here we need to perform two actions:
     // 1. multicast sale over auth sample
     // 2. broadcast sale status
-    ctx.global.set(payment_id + CONTEXT_KEY_SALE, data, SALE_TTL);
-    ctx.global.set(payment_id + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::Waiting), SALE_TTL);
+    std::shared_ptr<const SaleData> sale = std::make_shared<SaleData>(data);
+    std::shared_ptr<const std::string> details;
+    if (!in.SaleDetails.empty())
+    {
+        details = std::make_shared<std::string>(in.SaleDetails);
+    }
+    ctx.services().get<services::PaymentStates>()->update(payment_id, [&sale, &details](PaymentState &state) {
+        state.sale = std::move(sale);
+        state.saleDetails = std::move(details);
+        state.status = static_cast<int>(RTAStatus::Waiting);
+    });
 
     // store SaleData, payment_id and status in local context, so when we got reply from cryptonode, we just pass it to client
     ctx.local["sale_data"]  = data;
@@ -142,10 +146,10 @@ Status handleSaleMulticastReply(const Router::vars_t& vars, const graft::Input&
         return errorCustomError("Error multicasting request", ERROR_INTERNAL_ERROR, output);
     }
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     string payment_id = ctx.local["payment_id"];
-    int status = ctx.global.get(payment_id + CONTEXT_KEY_STATUS, static_cast<int>((RTAStatus::Waiting)));
+    int status = ctx.services().get<services::PaymentStates>()->status(payment_id, static_cast<int>(RTAStatus::Waiting));
 
     buildBroadcastSaleStatusOutput(payment_id, status, supernode, output);
     MINFO("sale multicast sent, broadcasting sale status: "
@@ -252,12 +256,19 @@ Status saleCryptonodeHandler(const Router::vars_t& vars, const graft::Input& inp
 
     // TODO: should be signed by sender??
 
-    if (!ctx.global.hasKey(payment_id + CONTEXT_KEY_SALE)) {
-        // TODO: clenup after payment done;
-        ctx.global[payment_id + CONTEXT_KEY_SALE] = sdm.sale_data;
-        ctx.global[payment_id + CONTEXT_KEY_STATUS] = sdm.status;
-        ctx.global[payment_id + CONTEXT_KEY_SALE_DETAILS] = sdm.details;
-    } else {
+    std::shared_ptr<const SaleData> sale = std::make_shared<SaleData>(std::move(sdm.sale_data));
+    std::shared_ptr<const std::string> details = std::make_shared<std::string>(std::move(sdm.details));
+    bool known = false;
+    ctx.services().get<services::PaymentStates>()->update(payment_id, [&](PaymentState &state) {
+        if (state.sale) {
+            known = true;
+            return;
+        }
+        state.sale = std::move(sale);
+        state.status = sdm.status;
+        state.saleDetails = std::move(details);
+    });
+    if (known) {
         MWARNING("payment " << payment_id << " already known");
     }
 
@@ -271,9 +282,9 @@ Status saleCryptonodeHandler(const Router::vars_t& vars, const graft::Input& inp
 void registerSaleRequest(graft::Router &router)
 {
     Router::Handler3 h1(nullptr, saleClientHandler, nullptr);
-    router.addRoute("/sale", METHOD_POST, h1);
+    router.addRoute("/sale", METHOD_POST, h1, Priority::High);
     Router::Handler3 h2(nullptr, saleCryptonodeHandler, nullptr);
-    router.addRoute("/cryptonode/sale", METHOD_POST, h2);
+    router.addRoute("/cryptonode/sale", METHOD_POST, h2, Priority::High);
 }
 
 }
@@ -5,6 +5,7 @@
 #include "lib/graft/jsonrpc.h"
 #include "lib/graft/router.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 #include "rta/supernode.h"
 #include "lib/graft/common/utils.h"
 
@@ -31,17 +32,24 @@ bool prepareSaleDetailsResponse(const SaleDetailsRequest &req, graft::Context &c
     SaleDetailsResponseJsonRpc out;
 
 
-    if (!ctx.global.hasKey(req.PaymentID + CONTEXT_KEY_SALE)) {
+    std::shared_ptr<const SaleData> sale_data;
+    std::shared_ptr<const std::string> details;
+    ctx.services().get<services::PaymentStates>()->read(req.PaymentID, [&](const PaymentState &state) {
+        sale_data = state.sale;
+        details = state.saleDetails;
+    });
+    if (!sale_data) {
         error.code = ERROR_PAYMENT_ID_INVALID;
         error.message = string("sale data missing for payment: ") + req.PaymentID;
         LOG_ERROR(__FUNCTION__ << " " << error.message);
         return false;
     }
 
-    resp.Details = ctx.global.get(req.PaymentID + CONTEXT_KEY_SALE_DETAILS, std::string());
-    SaleData sale_data = ctx.global.get(req.PaymentID + CONTEXT_KEY_SALE, SaleData());
+    if (details) {
+        resp.Details = *details;
+    }
 
-    uint64_t total_fee = static_cast<uint64_t>(std::round(sale_data.Amount * AUTHSAMPLE_FEE_PERCENTAGE / 100.0));
+    uint64_t total_fee = static_cast<uint64_t>(std::round(sale_data->Amount * AUTHSAMPLE_FEE_PERCENTAGE / 100.0));
 
     for (const auto &member : authSample) {
         SupernodeFee snf;
@@ -79,7 +87,14 @@ Status handleClientRequest(const Router::vars_t& vars, const graft::Input& input
         return errorInvalidPaymentID(output);
     }
 
-    int current_status = ctx.global.get(in.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    int current_status = static_cast<int>(RTAStatus::None);
+    std::shared_ptr<const SaleDetailsResponse> cached_sdr;
+    bool have_data_locally = false;
+    ctx.services().get<services::PaymentStates>()->read(in.PaymentID, [&](const PaymentState &state) {
+        current_status = state.status;
+        cached_sdr = state.saleDetailsResult;
+        have_data_locally = state.saleDetails != nullptr;
+    });
 
     if (errorFinishedPayment(current_status, output))
     {
@@ -88,26 +103,23 @@ Status handleClientRequest(const Router::vars_t& vars, const graft::Input& input
 
 
     // check if we have cached response
-    if (ctx.global.hasKey(in.PaymentID + CONTEXT_SALE_DETAILS_RESULT)) {
+    if (cached_sdr) {
         MDEBUG("found cached sale details for payment: " << in.PaymentID);
-        SaleDetailsResponse sdr = ctx.global.get(in.PaymentID + CONTEXT_SALE_DETAILS_RESULT, SaleDetailsResponse());
         SaleDetailsResponseJsonRpc out;
-        out.result = sdr;
+        out.result = *cached_sdr;
         output.load(out);
         return Status::Ok;
     }
 
     vector<SupernodePtr> authSample;
     uint64_t auth_sample_block_number = 0;
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     if (!fsl->buildAuthSample(in.BlockNumber, in.PaymentID, authSample, auth_sample_block_number)) {
         return  errorBuildAuthSample(output);
     }
     // we have sale details locally, easy way
-    bool have_data_locally = ctx.global.hasKey(in.PaymentID + CONTEXT_KEY_SALE_DETAILS);
-
     if (have_data_locally) {
         MDEBUG("found sale details locally for payment id: " << in.PaymentID << ", auth sample: " << authSample);
         SaleDetailsResponse sdr;
@@ -201,7 +213,7 @@ Status handleSaleDetailsResponse(const Router::vars_t& vars, const graft::Input&
     }
 
     UnicastRequest unicastReq = in.params;
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
     string payment_id = ctx.local["payment_id"];
     MDEBUG("received sale details from remote supernode: " << unicastReq.sender_address
            << ", payment: " << payment_id);
@@ -215,22 +227,24 @@ Status handleSaleDetailsResponse(const Router::vars_t& vars, const graft::Input&
     Input innerIn;
     innerIn.load(unicastReq.data);
 
-    SaleDetailsResponse sdr;
+    std::shared_ptr<SaleDetailsResponse> sdr = std::make_shared<SaleDetailsResponse>();
 
-    if (!innerIn.getT<serializer::JSON_B64>(sdr)) {
+    if (!innerIn.getT<serializer::JSON_B64>(*sdr)) {
         LOG_ERROR("error deserialize rta auth response");
         return errorInvalidParams(output);
     }
 
     // cache response;
-    ctx.global.set(payment_id + CONTEXT_SALE_DETAILS_RESULT, sdr, RTA_TX_TTL);
+    ctx.services().get<services::PaymentStates>()->update(payment_id, [&sdr](PaymentState &state) {
+        state.saleDetailsResult = sdr;
+    });
 
     // remove callback reply
     ctx.global.remove(task_id + CONTEXT_SALE_DETAILS_RESULT);
 
     // send response to the client
     SaleDetailsResponseJsonRpc out;
-    out.result = sdr;
+    out.result = *sdr;
     output.load(out);
     MDEBUG(__FUNCTION__ << " end");
     return Status::Ok;
@@ -266,7 +280,7 @@ Status handleSaleDetailsUnicastRequest(const Router::vars_t& vars, const graft::
     }
 
     UnicastRequest unicastReq = in.params;
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     if (unicastReq.receiver_address != supernode->idKeyAsString()) {
         string msg =  string("wrong receiver id: " + supernode->idKeyAsString());
@@ -287,7 +301,7 @@ Status handleSaleDetailsUnicastRequest(const Router::vars_t& vars, const graft::
 
     vector<SupernodePtr> authSample;
     uint64_t auth_sample_block_number = 0;
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
 
     MDEBUG("sale_details request from remote supernode: " << unicastReq.sender_address
            << ", payment: " << sdr.PaymentID
@@ -299,7 +313,11 @@ Status handleSaleDetailsUnicastRequest(const Router::vars_t& vars, const graft::
         return sendOkResponseToCryptonode(output); // cryptonode doesn't care about any errors, it's job is only deliver request
     }
 
-    if (ctx.global.hasKey(sdr.PaymentID + CONTEXT_KEY_SALE_DETAILS)) {
+    bool have_data_locally = false;
+    ctx.services().get<services::PaymentStates>()->read(sdr.PaymentID, [&](const PaymentState &state) {
+        have_data_locally = state.saleDetails != nullptr;
+    });
+    if (have_data_locally) {
         MDEBUG("sale details found for payment: " << sdr.PaymentID
                << ", auth sample: " << authSample);
 
@@ -380,7 +398,7 @@ Status saleDetailsCallbackHandler(const Router::vars_t& vars, const graft::Input
         return errorInternalError(msg, output);
     }
 
-    std::string id = vars.find("id")->second;
+    std::string id(vars.find("id")->second);
     boost::uuids::string_generator sg;
     boost::uuids::uuid uuid = sg(id);
     ctx.global.set(id + CONTEXT_SALE_DETAILS_RESULT, input.data(), RTA_TX_TTL);
@@ -2,6 +2,7 @@
 #include "supernode/requests/sale_status.h"
 #include "supernode/requests/broadcast.h"
 #include "supernode/requestdefines.h"
+#include "supernode/services.h"
 #include <misc_log_ex.h>
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -29,7 +30,7 @@ Status saleStatusHandler(const Router::vars_t& vars, const graft::Input& input,
 
     const SaleStatusRequest &in = req.params;
     MDEBUG("requested status for payment: " << in.PaymentID);
-    int current_status = ctx.global.get(in.PaymentID + CONTEXT_KEY_STATUS, static_cast<int>(RTAStatus::None));
+    int current_status = ctx.services().get<services::PaymentStates>()->status(in.PaymentID);
     if (in.PaymentID.empty() || current_status == 0)
     {
         MWARNING("no status for payment: " << in.PaymentID);
@@ -67,7 +68,7 @@ Status updateSaleStatusHandler(const Router::vars_t& vars, const graft::Input& i
         return errorInvalidParams(output);
     }
 
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
 
     MDEBUG("sale status update received for payment: " << ussb.PaymentID);
@@ -82,9 +83,14 @@ Status updateSaleStatusHandler(const Router::vars_t& vars, const graft::Input& i
         return Status::Error;
     } else {
         // TODO: complete state chart for status transitions
-        RTAStatus currentStatus = static_cast<RTAStatus>(ctx.global.get(ussb.PaymentID + CONTEXT_KEY_STATUS, int(RTAStatus::None)));
+        RTAStatus currentStatus = RTAStatus::None;
+        ctx.services().get<services::PaymentStates>()->update(ussb.PaymentID, [&](PaymentState &state) {
+            currentStatus = static_cast<RTAStatus>(state.status);
+            if (!isFiniteRtaStatus(currentStatus)) {
+                state.status = ussb.Status;
+            }
+        });
         if (!isFiniteRtaStatus(currentStatus)) {
-            ctx.global.set(ussb.PaymentID + CONTEXT_KEY_STATUS, ussb.Status, RTA_TX_TTL);
             MDEBUG("sale status updated for payment: " << ussb.PaymentID << " to: " << ussb.Status);
         } else {
             MWARNING("status already in finite state for payment: " << ussb.PaymentID
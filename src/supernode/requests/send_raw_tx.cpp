@@ -28,6 +28,7 @@
 
 #include "supernode/requests/send_raw_tx.h"
 #include "supernode/requestdefines.h"
+#include "lib/graft/flow.h"
 #include <misc_log_ex.h>
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -35,38 +36,44 @@
 
 namespace graft::supernode::request {
 
-Status sendRawTxHandler(const Router::vars_t& vars, const graft::Input& input,
-                                 graft::Context& ctx, graft::Output& output)
+struct SendRawTxFrame : FlowFrame { };
+
+// call from client
+Status forwardRawTx(SendRawTxFrame& frame, const Router::vars_t& vars, const graft::Input& input,
+                    graft::Context& ctx, graft::Output& output)
 {
-    // call from client
-    if (!ctx.local.hasKey(__FUNCTION__)) {
-        LOG_PRINT_L2("call from client, forwarding to cryptonode...");
+    LOG_PRINT_L2("call from client, forwarding to cryptonode...");
+
+    // just forward input to cryptonode
+    SendRawTxRequest req = input.get<SendRawTxRequest>();
+    output.load(req);
+    return Status::Forward;
+}
 
-        // just forward input to cryptonode
-        SendRawTxRequest req = input.get<SendRawTxRequest>();
-        output.load(req);
-        ctx.local[__FUNCTION__] = true;
-        return Status::Forward;
+// response from cryptonode
+Status handleRawTxReply(SendRawTxFrame& frame, const Router::vars_t& vars, const graft::Input& input,
+                        graft::Context& ctx, graft::Output& output)
+{
+    LOG_PRINT_L2("response from cryptonode : " << input.data());
+    SendRawTxResponse resp = input.get<SendRawTxResponse>();
+    if (resp.status == "OK") { // positive reply
+        output.load(resp);
+        return Status::Ok;
     } else {
-    // response from cryptonode
-        LOG_PRINT_L2("response from cryptonode : " << input.data());
-        SendRawTxResponse resp = input.get<SendRawTxResponse>();
-        if (resp.status == "OK") { // positive reply
-            output.load(resp);
-            return Status::Ok;
-        } else {
-            ErrorResponse ret;
-            ret.code = ERROR_INTERNAL_ERROR;
-            ret.message = resp.reason;
-            output.load(ret);
-            return Status::Error;
-        }
+        ErrorResponse ret;
+        ret.code = ERROR_INTERNAL_ERROR;
+        ret.message = resp.reason;
+        output.load(ret);
+        return Status::Error;
     }
 }
 
 void registerSendRawTxRequest(graft::Router& router)
 {
-    Router::Handler3 h3(nullptr, sendRawTxHandler, nullptr);
+    Flow<SendRawTxFrame> sendRawTx;
+    sendRawTx.then(forwardRawTx)
+             .then(handleRawTxReply);
+    Router::Handler3 h3(nullptr, sendRawTx, nullptr);
     const char * path = "/cryptonode/sendrawtx";
     router.addRoute(path, METHOD_POST, h3);
     LOG_PRINT_L2("route " << path << " registered");
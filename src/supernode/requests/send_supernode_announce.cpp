@@ -30,7 +30,9 @@
 #include "supernode/requests/send_raw_tx.h"
 #include "supernode/requestdefines.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 #include "rta/supernode.h"
+#include "lib/graft/handler_api.h"
 
 #include <misc_log_ex.h>
 #include <boost/shared_ptr.hpp>
@@ -60,9 +62,8 @@ Status handleSupernodeAnnounce(const Router::vars_t& vars, const graft::Input& i
     LOG_PRINT_L1(PATH << " called with payload: " << input.data());
     // TODO: implement DOS protection, ignore too frequent requests
 
-    boost::shared_ptr<FullSupernodeList> fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST,
-                                                              boost::shared_ptr<FullSupernodeList>());
-    SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, SupernodePtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
 
     if (!fsl) {
@@ -98,8 +99,8 @@ Status handleSupernodeAnnounce(const Router::vars_t& vars, const graft::Input& i
             return Status::Error; // we don't care about reply here, already replied to the client
         }
     } else {
-        std::string cryptonode_rpc_address = ctx.global["cryptonode_rpc_address"];
-        bool testnet = ctx.global["testnet"];
+        const std::string& cryptonode_rpc_address = ctx.services().get<services::CryptonodeRpcAddress>();
+        bool testnet = ctx.services().get<services::Testnet>();
 
         Supernode * s  = Supernode::createFromAnnounce(announce,
                                                        cryptonode_rpc_address,
@@ -152,6 +153,51 @@ void registerSendSupernodeAnnounceRequest(graft::Router &router)
     LOG_PRINT_L0("route " << PATH << " registered");
 }
 
+namespace {
+
+/*!
+ * \brief prepareAnnounce - refreshes the supernode and puts its announce to the output
+ * \return                - Forward if the announce is ready to be sent to cryptonode
+ */
+Status prepareAnnounce(graft::Context& ctx, graft::Output& output)
+{
+    const graft::SupernodePtr& supernode = ctx.services().get<services::Supernode>();
+
+    if (!supernode.get()) {
+        LOG_ERROR("supernode is not set in global context");
+        return graft::Status::Error;
+    }
+
+    MDEBUG("about to refresh supernode: " << supernode->idKeyAsString());
+
+    if (!supernode->refresh()) {
+        return errorCustomError(string("failed to refresh supernode: ") + supernode->idKeyAsString(),
+                                ERROR_INTERNAL_ERROR, output);
+    }
+
+    supernode->setLastUpdateTime(static_cast<int64_t>(std::time(nullptr)));
+
+    SendSupernodeAnnounceJsonRpcRequest req;
+    if (!supernode->prepareAnnounce(req.params)) {
+        return errorCustomError(string("failed to prepare announce: ") + supernode->idKeyAsString(),
+                                ERROR_INTERNAL_ERROR, output);
+    }
+
+
+    req.method = "send_supernode_announce";
+    req.id = 0;
+    output.load(req);
+
+    output.path = "/json_rpc/rta";
+    // DBG: without cryptonode
+    // output.path = "/dapi/v2.0/send_supernode_announce";
+    MDEBUG("sending announce for id: " << supernode->idKeyAsString());
+    MDEBUG(output.data());
+    return graft::Status::Forward;
+}
+
+}
+
 Status sendAnnounce(const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx,
         graft::Output& output)
 {
@@ -164,41 +210,7 @@ Status sendAnnounce(const graft::Router::vars_t& vars, const graft::Input& input
             return graft::Status::Ok;
         case graft::Status::Ok:
         case graft::Status::None:
-            graft::SupernodePtr supernode;
-
-            supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, graft::SupernodePtr(nullptr));
-
-            if (!supernode.get()) {
-                LOG_ERROR("supernode is not set in global context");
-                return graft::Status::Error;
-            }
-
-            MDEBUG("about to refresh supernode: " << supernode->idKeyAsString());
-
-            if (!supernode->refresh()) {
-                return errorCustomError(string("failed to refresh supernode: ") + supernode->idKeyAsString(),
-                                        ERROR_INTERNAL_ERROR, output);
-            }
-
-            supernode->setLastUpdateTime(static_cast<int64_t>(std::time(nullptr)));
-
-            SendSupernodeAnnounceJsonRpcRequest req;
-            if (!supernode->prepareAnnounce(req.params)) {
-                return errorCustomError(string("failed to prepare announce: ") + supernode->idKeyAsString(),
-                                        ERROR_INTERNAL_ERROR, output);
-            }
-
-
-            req.method = "send_supernode_announce";
-            req.id = 0;
-            output.load(req);
-
-            output.path = "/json_rpc/rta";
-            // DBG: without cryptonode
-            // output.path = "/dapi/v2.0/send_supernode_announce";
-            MDEBUG("sending announce for id: " << supernode->idKeyAsString());
-            MDEBUG(output.data());
-            return graft::Status::Forward;
+            return prepareAnnounce(ctx, output);
         }
     }
     catch(const std::exception &e)
@@ -212,5 +224,31 @@ Status sendAnnounce(const graft::Router::vars_t& vars, const graft::Input& input
     return Status::Ok;
 };
 
+Status sendAnnounceAsync(const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx,
+        graft::Output& output)
+{
+    try {
+        Status status = prepareAnnounce(ctx, output);
+        if (status != graft::Status::Forward)
+            return status;
+
+        ctx.handlerAPI()->sendUpstreamAsync(output, [](const graft::Input& input, const std::string& err)
+        {
+            if (!err.empty()) {
+                LOG_ERROR("Failed to send announce: " << err);
+            }
+        });
+    }
+    catch(const std::exception &e)
+    {
+        LOG_ERROR("Exception thrown: " << e.what());
+    }
+    catch(...)
+    {
+        LOG_ERROR("Unknown exception thrown");
+    }
+    return Status::Ok;
+}
+
 }
 
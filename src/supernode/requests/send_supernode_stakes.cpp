@@ -29,6 +29,7 @@
 #include "supernode/requests/send_supernode_stakes.h"
 #include "supernode/requestdefines.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 #include "rta/supernode.h"
 
 #include <misc_log_ex.h>
@@ -54,8 +55,8 @@ Status supernodeStakesHandler
 {
     LOG_PRINT_L1(PATH << " called with payload: " << input.data());
 
-    boost::shared_ptr<FullSupernodeList> fsl = ctx.global.get("fsl", boost::shared_ptr<FullSupernodeList>());
-    SupernodePtr supernode = ctx.global.get("supernode", SupernodePtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
+    const SupernodePtr& supernode = ctx.services().get<services::Supernode>();
 
     if (!fsl.get()) {
         LOG_ERROR("Internal error. Supernode list object missing");
@@ -96,8 +97,8 @@ Status supernodeStakesHandler
         dst_stakes.emplace_back(std::move(dst_stake));
     }
 
-    std::string cryptonode_rpc_address = ctx.global["cryptonode_rpc_address"];
-    bool testnet = ctx.global["testnet"];
+    const std::string& cryptonode_rpc_address = ctx.services().get<services::CryptonodeRpcAddress>();
+    bool testnet = ctx.services().get<services::Testnet>();
 
     fsl->updateStakes(req.params.block_height, dst_stakes, cryptonode_rpc_address, testnet);
 
@@ -2,22 +2,17 @@
 #include "supernode/requests/send_transfer.h"
 #include "supernode/requests/send_raw_tx.h"
 #include "supernode/requestdefines.h"
+#include "lib/graft/flow.h"
+#include "lib/graft/fan_out.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "supernode.sendtransferrequest"
 
 namespace graft::supernode::request {
 
-static const std::string scLastSendTxIndex("SendTransfer_txindex");
-static const std::string scTxList("SendTransfer_txs");
+struct SendTransferFrame : FlowFrame { };
 
-enum class SendTransferHandlerState : int
-{
-    ClientRequest = 0,
-    TxStatusReply
-};
-
-Status handleClientSendRequest(const Router::vars_t& vars, const graft::Input& input,
+Status handleClientSendRequest(SendTransferFrame& frame, const Router::vars_t& vars, const graft::Input& input,
                                graft::Context& ctx, graft::Output& output)
 {
 
@@ -54,34 +49,33 @@ Status handleClientSendRequest(const Router::vars_t& vars, const graft::Input& i
                << ", tx_id: " <<  epee::string_tools::pod_to_hex(tx_hash));
     }
 
-    ctx.local[scLastSendTxIndex] = 1;
-    ctx.local[scTxList] = req.Transactions;
-
-    // call cryptonode
-    SendRawTxRequest request;
-    request.tx_as_hex = req.Transactions[0];
-    output.load(request);
-    output.path = "/sendrawtransaction";
+    // call cryptonode, the transactions are sent concurrently
+    FanOut& fanOut = ctx.fanOut();
+    for (const std::string& tx_hex : req.Transactions)
+    {
+        SendRawTxRequest request;
+        request.tx_as_hex = tx_hex;
+        Output out;
+        out.load(request);
+        out.path = "/sendrawtransaction";
+        fanOut.add(std::move(out));
+    }
     return Status::Forward;
 }
 
-// handles response from cryptonode/rta/multicast call with tx auth request
-Status handleTxStatusReply(const Router::vars_t& vars, const graft::Input& input,
+// handles the responses from cryptonode, it is called when all the transactions are answered
+Status handleTxStatusReply(SendTransferFrame& frame, const Router::vars_t& vars, const graft::Input& input,
                            graft::Context& ctx, graft::Output& output)
 {
     // check cryptonode reply
     MDEBUG(__FUNCTION__ << " begin");
-    std::vector<std::string> txs = ctx.local[scTxList];
-    unsigned int tx_index = ctx.local[scLastSendTxIndex];
-    if (tx_index < txs.size())
+    const FanOut& fanOut = ctx.fanOut();
+    for (size_t i = 0; i < fanOut.size(); ++i)
     {
-        // call cryptonode
-        SendRawTxRequest request;
-        request.tx_as_hex = txs[tx_index];
-        output.load(request);
-        output.path = "/sendrawtransaction";
-        ctx.local[scLastSendTxIndex] = tx_index + 1;
-        return Status::Forward;
+        if (fanOut.status(i) != Status::Ok)
+        {
+            return errorInternalError("failed to send transaction " + std::to_string(i) + ": " + fanOut.error(i), output);
+        }
     }
     SendTransferResponse out;
     out.Result = STATUS_OK;
@@ -89,38 +83,13 @@ Status handleTxStatusReply(const Router::vars_t& vars, const graft::Input& input
     return Status::Ok;
 }
 
-/*!
- * \brief sendTransferHandler - handles "/walletapi/v2.0/send_transfer" request
- * \param vars
- * \param input
- * \param ctx
- * \param output
- * \return
- */
-Status sendTransferHandler(const Router::vars_t& vars, const graft::Input& input,
-                           graft::Context& ctx, graft::Output& output)
-{
-    SendTransferHandlerState state = ctx.local.hasKey(__FUNCTION__)
-            ? ctx.local[__FUNCTION__] : SendTransferHandlerState::ClientRequest;
-    // state machine to perform two calls to cryptonode and return result to the client
-    switch (state) {
-    // client requested "/send_transfer"
-    case SendTransferHandlerState::ClientRequest:
-        ctx.local[__FUNCTION__] = SendTransferHandlerState::TxStatusReply;
-        // "handleClientSendRequest" returns Forward;
-        return handleClientSendRequest(vars, input, ctx, output);
-    case SendTransferHandlerState::TxStatusReply:
-        // check status if transaction sending and answer to client
-        return handleTxStatusReply(vars, input, ctx, output);
-     default:
-        LOG_ERROR("Internal error: unhandled state");
-        abort();
-    };
-}
-
 void registerSendTransferRequest(Router &router)
 {
-    Router::Handler3 clientHandler(nullptr, sendTransferHandler, nullptr);
+    // the transactions are sent to cryptonode in parallel and the result is returned to the client
+    Flow<SendTransferFrame> sendTransfer;
+    sendTransfer.then(handleClientSendRequest)
+                .then(handleTxStatusReply);
+    Router::Handler3 clientHandler(nullptr, sendTransfer, nullptr);
     router.addRoute("/send_transfer", METHOD_POST, clientHandler);
 }
 
@@ -139,7 +139,7 @@ void GraftServer::addGenericCallbackRoute()
             output.body = "Cannot find callback UUID";
             return Status::Error;
         }
-        std::string id = vars.find("id")->second;
+        std::string id(vars.find("id")->second);
         boost::uuids::string_generator sg;
         boost::uuids::uuid uuid = sg(id);
         ctx.setNextTaskId(uuid);
@@ -183,7 +183,7 @@ void GraftServer::serve()
     LOG_PRINT_L0("Starting server on: [http] " << getCopts().http_address << ", [coap] " << getCopts().coap_address
                  << ", version: " << GRAFT_SUPERNODE_VERSION_FULL);
 
-    m_connectionBase->getLooper().serve();
+    m_connectionBase->serve();
 }
 
 GraftServer::RunRes GraftServer::run()
@@ -523,10 +523,18 @@ bool GraftServer::initConfigOption(int argc, const char** argv, ConfigOpts& conf
     configOpts.http_address = server_conf.get<std::string>("http-address");
     configOpts.coap_address = server_conf.get<std::string>("coap-address");
     configOpts.timer_poll_interval_ms = server_conf.get<int>("timer-poll-interval-ms");
+    configOpts.io_threads = server_conf.get<int>("io-threads", 1);
+    configOpts.io_backend = server_conf.get<std::string>("io-backend", "select");
+    if(configOpts.io_backend != "select" && configOpts.io_backend != "epoll")
+    {
+        throw graft::exit_error("Invalid io-backend '" + configOpts.io_backend + "', 'select' or 'epoll' expected");
+    }
     configOpts.http_connection_timeout = server_conf.get<double>("http-connection-timeout");
+    configOpts.http_keep_alive_max_requests = server_conf.get<int>("http-keep-alive-max-requests", 100);
     configOpts.workers_count = server_conf.get<int>("workers-count");
     configOpts.worker_queue_len = server_conf.get<int>("worker-queue-len");
     configOpts.workers_expelling_interval_ms = server_conf.get<int>("workers-expelling-interval-ms", 1000);
+    configOpts.workers_compensation_max = server_conf.get<int>("workers-compensation-max", -1);
     configOpts.upstream_request_timeout = server_conf.get<double>("upstream-request-timeout");
     configOpts.lru_timeout_ms = server_conf.get<int>("lru-timeout-ms");
     configOpts.common.data_dir = server_conf.get<std::string>("data-dir");
@@ -568,6 +576,7 @@ bool GraftServer::initConfigOption(int argc, const char** argv, ConfigOpts& conf
 
     const boost::property_tree::ptree& cryptonode_conf = config.get_child("cryptonode");
     configOpts.cryptonode_rpc_address = cryptonode_conf.get<std::string>("rpc-address");
+    configOpts.cryptonode_max_connections = cryptonode_conf.get<int>("max-connections", 16);
 
     const boost::property_tree::ptree& log_conf = config.get_child("logging");
     boost::optional<int> log_trunc_to_size  = log_conf.get_optional<int>("trunc-to-size");
@@ -609,12 +618,15 @@ void GraftServer::addGlobalCtxCleaner()
 {
     auto cleaner = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
     {
-        graft::Context::GlobalFriend::cleanup(ctx.global);
+        size_t expired = graft::Context::GlobalFriend::cleanup(ctx.global);
+        if(expired) ctx.handlerAPI()->runtimeSysInfo().count_global_ctx_expired(expired);
         return graft::Status::Ok;
     };
+    //the cleanup does nothing until a deadline is reached, so it runs often enough to call onExpired in time
+    int interval_ms = std::min(m_connectionBase->getCopts().lru_timeout_ms, 1000);
     m_connectionBase->getLooper().addPeriodicTask(
                 graft::Router::Handler3(nullptr, cleaner, nullptr),
-                std::chrono::milliseconds(m_connectionBase->getCopts().lru_timeout_ms)
+                std::chrono::milliseconds(interval_ms)
                 );
 }
 
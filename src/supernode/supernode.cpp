@@ -3,10 +3,14 @@
 #include "lib/graft/requests.h"
 #include "supernode/requests.h"
 #include "lib/graft/sys_info.h"
+#include "lib/graft/handler_api.h"
 #include "supernode/requestdefines.h"
 #include "supernode/requests/send_supernode_announce.h"
+#include "supernode/requests/send_supernode_stakes.h"
+#include "supernode/requests/blockchain_based_list.h"
 #include "rta/supernode.h"
 #include "rta/fullsupernodelist.h"
+#include "supernode/services.h"
 #include "lib/graft/graft_exception.h"
 
 #include <boost/property_tree/ini_parser.hpp>
@@ -101,7 +105,16 @@ void Supernode::prepareSupernode()
                 m_configEx.cryptonode_rpc_address, m_configEx.common.testnet);
     fsl->add(supernode);
 
-    //put fsl into global context
+    //register the services for the handlers
+    ServiceRegistry& registry = getLooper().getGcm().services();
+    registry.set<services::Supernode>(supernode);
+    registry.set<services::FullSupernodeList>(fsl);
+    registry.set<services::Testnet>(m_configEx.common.testnet);
+    registry.set<services::WatchonlyWalletsPath>(m_configEx.watchonly_wallets_path);
+    registry.set<services::CryptonodeRpcAddress>(m_configEx.cryptonode_rpc_address);
+    registry.set<services::PaymentStates>(std::make_shared<PaymentStateStore>());
+
+    //kept in the global context for the graftlets built against the previous interface
     Context ctx(getLooper().getGcm());
     ctx.global[CONTEXT_KEY_SUPERNODE] = supernode;
     ctx.global[CONTEXT_KEY_FULLSUPERNODELIST] = fsl;
@@ -131,7 +144,7 @@ void Supernode::startSupernodePeriodicTasks()
     if (m_configEx.stake_wallet_refresh_interval_ms > 0) {
         size_t initial_interval_ms = 1000;
         getLooper().addPeriodicTask(
-                    graft::Router::Handler3(nullptr, graft::supernode::request::sendAnnounce, nullptr),
+                    graft::Router::Handler3(nullptr, graft::supernode::request::sendAnnounceAsync, nullptr),
                     std::chrono::milliseconds(m_configEx.stake_wallet_refresh_interval_ms),
                     std::chrono::milliseconds(initial_interval_ms),
                     m_configEx.stake_wallet_refresh_interval_random_factor
@@ -142,16 +155,59 @@ void Supernode::startSupernodePeriodicTasks()
 
     auto handler = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
     {
-        graft::SupernodePtr supernode = ctx.global.get(CONTEXT_KEY_SUPERNODE, graft::SupernodePtr(nullptr));
+        const graft::SupernodePtr& supernode = ctx.services().get<graft::services::Supernode>();
 
         if (!supernode.get()) {
             LOG_ERROR("supernode is not set in global context");
             return graft::Status::Error;
         }
 
-        if (FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr()))
+        const FullSupernodeListPtr& fsl = ctx.services().get<graft::services::FullSupernodeList>();
+
+        if (!fsl) {
+            return graft::Status::Ok;
+        }
+
+        // cryptonode answers to the requests by sending the stakes and the lists to the network address of the supernode,
+        // so the answers themselves are not used; the requests do not wait for cryptonode
+
+        auto onSent = [](const char* method)
+        {
+            return [method](const graft::Input& input, const std::string& err)
+            {
+                if (!err.empty()) {
+                    LOG_ERROR("/json_rpc/rta/" << method << " error: " << err);
+                }
+            };
+        };
+
+        if (fsl->needStakes())
         {
-            fsl->synchronizeWithCryptonode(supernode->networkAddress().c_str(), supernode->idKeyAsString().c_str());
+            graft::supernode::request::GetSupernodeStakesJsonRpcRequest req;
+            req.method = "send_supernode_stakes";
+            req.params.network_address = supernode->networkAddress();
+            req.params.supernode_public_id = supernode->idKeyAsString();
+
+            graft::Output out;
+            out.load(req);
+            out.path = "/json_rpc/rta";
+            ctx.handlerAPI()->sendUpstreamAsync(out, onSent("send_supernode_stakes"));
+        }
+
+        uint64_t last_received_block_height = 0;
+
+        if (fsl->needBlockchainBasedList(last_received_block_height))
+        {
+            graft::supernode::request::GetBlockchainBasedListJsonRpcRequest req;
+            req.method = "send_supernode_blockchain_based_list";
+            req.params.network_address = supernode->networkAddress();
+            req.params.supernode_public_id = supernode->idKeyAsString();
+            req.params.last_received_block_height = last_received_block_height;
+
+            graft::Output out;
+            out.load(req);
+            out.path = "/json_rpc/rta";
+            ctx.handlerAPI()->sendUpstreamAsync(out, onSent("send_supernode_blockchain_based_list"));
         }
 
         return graft::Status::Ok;
@@ -163,6 +219,24 @@ void Supernode::startSupernodePeriodicTasks()
                 graft::Router::Handler3(nullptr, handler, nullptr),
                 std::chrono::milliseconds(CRYPTONODE_SYNCHRONIZATION_PERIOD_MS)
                 );
+
+    // remove expired payments
+
+    auto cleaner = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        if (const std::shared_ptr<PaymentStateStore>& payments = ctx.services().get<graft::services::PaymentStates>())
+        {
+            payments->cleanup();
+        }
+        return graft::Status::Ok;
+    };
+
+    static const size_t PAYMENT_STATES_CLEANUP_PERIOD_MS = 1000;
+
+    getConnectionBase().getLooper().addPeriodicTask(
+                graft::Router::Handler3(nullptr, cleaner, nullptr),
+                std::chrono::milliseconds(PAYMENT_STATES_CLEANUP_PERIOD_MS)
+                );
 }
 
 void Supernode::setHttpRouters(ConnectionManager& httpcm)
@@ -222,9 +296,9 @@ void Supernode::loadStakeWallets()
 {
 
     Context ctx(getLooper().getGcm());
-    std::string watchonly_wallets_path = ctx.global.get("watchonly_wallets_path", std::string());
+    const std::string& watchonly_wallets_path = ctx.services().get<services::WatchonlyWalletsPath>();
 
-    FullSupernodeListPtr fsl = ctx.global.get(CONTEXT_KEY_FULLSUPERNODELIST, FullSupernodeListPtr());
+    const FullSupernodeListPtr& fsl = ctx.services().get<services::FullSupernodeList>();
     size_t found_wallets = 0;
     MDEBUG("loading supernodes wallets from: " << watchonly_wallets_path);
     size_t loaded_wallets = fsl->loadFromDirThreaded(watchonly_wallets_path, found_wallets);
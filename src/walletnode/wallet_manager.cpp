@@ -233,7 +233,10 @@ void WalletManager::runAsyncForWallet
 
       wallet->wallet.load_cache(cache_file_name);
 
-      wallet->wallet.refresh();
+      {
+        tp::BlockingRegion blocking;
+        wallet->wallet.refresh();
+      }
 
       WebHookCallback callback(callback_url.c_str());
 
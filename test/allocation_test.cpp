@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "lib/graft/task.h"
+#include "lib/graft/context.h"
+#include "fixture.h"
+
+#include <cstdlib>
+#include <new>
+
+//The global operator new of this executable counts the heap allocations of the current thread,
+//that is why these tests are not a part of supernode_test.
+
+namespace
+{
+
+//heap allocations made by the current thread while counting is on
+thread_local bool t_counting = false;
+thread_local size_t t_allocations = 0;
+
+void* countedAlloc(size_t size, size_t align)
+{
+    if(t_counting) ++t_allocations;
+    void* p = (align <= alignof(std::max_align_t))? std::malloc(size ? size : 1)
+                                                  : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+template<typename F>
+size_t countAllocations(F f)
+{
+    t_allocations = 0;
+    t_counting = true;
+    f();
+    t_counting = false;
+    return t_allocations;
+}
+
+} //namespace
+
+//the array and nothrow forms call these ones
+void* operator new(size_t size) { return countedAlloc(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t al) { return countedAlloc(size, size_t(al)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+TEST_F(GraftServerTestBase, allocationsPerRequest)
+{
+    MainServer mainServer;
+    graft::Router::Handler3 h3;
+    size_t allocations = 0;
+    //it is called by the IO thread, the pool of the looper is current
+    auto pre_action = [&](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        mg_connection client{};
+        client.mgr = mainServer.getLooper().getMgMgr();
+        //the task of a client request, its context entries and the job of the thread pool
+        auto request = [&]
+        {
+            graft::BaseTaskPtr bt = graft::BaseTask::Create<graft::ClientTask>(nullptr, &client, graft::Router::JobParams({graft::Input(), graft::Router::vars_t(), &h3}));
+            graft::Context::Local& local = bt->getCtx().local;
+            local["status"] = 1;
+            local["amount"] = uint64_t(100);
+            local["payment_id"] = 2;
+            graft::GJPtr gj(bt, nullptr, &bt->getManager());
+            bt->finalize();
+        };
+        request(); //the first request carves the blocks from a chunk
+        allocations = countAllocations(request);
+        return graft::Status::Ok;
+    };
+    mainServer.m_router.addRoute("/request", METHOD_GET, {pre_action, nullptr, nullptr});
+    mainServer.run();
+
+    Client client;
+    client.serve("http://localhost:9084/request");
+    EXPECT_EQ(200, client.get_resp_code());
+    mainServer.stop_and_wait_for();
+
+    EXPECT_EQ(0u, allocations);
+}
+
+TEST(SlabPool, longLivingLocal)
+{
+    //a periodic task keeps its context as long as the server, the memory of the replaced values,
+    //removed entries and old tables is reused
+    graft::Context::Local local;
+    auto cycle = [&local]
+    {
+        for(int i = 0; i < 20; ++i)
+        {
+            std::string key = "key" + std::to_string(i);
+            local[key] = i;
+            local[key] = std::string("value");
+            local[key] = uint64_t(i);
+        }
+        for(int i = 0; i < 20; ++i) local.remove("key" + std::to_string(i));
+        local["status"] = 1;
+        local.remove("status");
+    };
+    cycle(); //the first cycles carve the blocks from the arena
+    cycle();
+
+    size_t allocations = countAllocations([&cycle]{ for(int i = 0; i < 1000; ++i) cycle(); });
+    EXPECT_EQ(0u, allocations);
+}
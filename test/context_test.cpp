@@ -0,0 +1,432 @@
+#include <gtest/gtest.h>
+#include "lib/graft/context.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Counted
+{
+    explicit Counted(int& alive) : m_alive(&alive) { ++*m_alive; }
+    Counted(Counted&& other) noexcept : m_alive(other.m_alive) { ++*m_alive; }
+    ~Counted() { --*m_alive; }
+    int* m_alive;
+};
+
+enum class HandlerState
+{
+    ClientRequest = 0,
+    MulticastReply,
+    StatusReply,
+};
+
+//the size of SaleData and PayRequest
+struct RequestData
+{
+    std::string Address;
+    uint64_t BlockNumber = 0;
+    uint64_t Amount = 0;
+    std::string PaymentID;
+};
+
+//the previous storage of the local context
+struct MapLocal
+{
+    struct Proxy
+    {
+        template<typename T>
+        Proxy& operator =(T&& v) { m_map[m_key] = std::forward<T>(v); return *this; }
+        template<typename T>
+        operator T& () const { return std::any_cast<T&>(m_map[m_key]); }
+        std::map<std::string, std::any>& m_map;
+        const std::string& m_key;
+    };
+    Proxy operator[](const std::string& key) { return Proxy{m_map, key}; }
+    bool hasKey(const std::string& key) { return m_map.find(key) != m_map.end(); }
+    std::map<std::string, std::any> m_map;
+};
+
+} //namespace
+
+TEST(Context, localTypes)
+{
+    graft::GlobalContextMap m;
+    graft::Context ctx(m);
+
+    ctx.local["payment_id"] = std::string("0123456789abcdef0123456789abcdef");
+    ctx.local["state"] = HandlerState::MulticastReply;
+    ctx.local["amount"] = uint64_t(100);
+
+    std::string payment_id = ctx.local["payment_id"];
+    HandlerState state = ctx.local["state"];
+    uint64_t amount = ctx.local["amount"];
+    EXPECT_EQ("0123456789abcdef0123456789abcdef", payment_id);
+    EXPECT_EQ(HandlerState::MulticastReply, state);
+    EXPECT_EQ(100u, amount);
+
+    //in place update and the reference to the stored value
+    std::string& ref = ctx.local["payment_id"];
+    ref += "0";
+    std::string s = ctx.local[std::string("payment_id")];
+    EXPECT_EQ(33u, s.size());
+
+    //the type of the value changes
+    ctx.local["amount"] = std::string("100");
+    std::string sa = ctx.local["amount"];
+    EXPECT_EQ("100", sa);
+    EXPECT_THROW(static_cast<uint64_t>(ctx.local["amount"]), std::bad_any_cast);
+    EXPECT_THROW(static_cast<int>(ctx.local["missing"]), std::bad_any_cast);
+
+    const graft::Context::Local::Key key("state");
+    EXPECT_TRUE(ctx.local.hasKey(key));
+    ctx.local.remove(key);
+    EXPECT_FALSE(ctx.local.hasKey("state"));
+    ctx.local[key] = HandlerState::StatusReply;
+    HandlerState state2 = ctx.local["state"];
+    EXPECT_EQ(HandlerState::StatusReply, state2);
+}
+
+TEST(Context, localGrowthAndDestruction)
+{
+    int alive = 0;
+    {
+        graft::GlobalContextMap m;
+        graft::Context ctx(m);
+        for(int i = 0; i < 100; ++i)
+        {
+            ctx.local["key" + std::to_string(i)] = Counted(alive);
+            ctx.local["long key that does not fit into the small string buffer " + std::to_string(i)] = i;
+        }
+        EXPECT_EQ(100, alive);
+        for(int i = 0; i < 100; i += 2)
+        {
+            ctx.local.remove("key" + std::to_string(i));
+        }
+        EXPECT_EQ(50, alive);
+        for(int i = 0; i < 100; ++i)
+        {
+            EXPECT_EQ(i % 2 == 1, ctx.local.hasKey("key" + std::to_string(i)));
+            int v = ctx.local["long key that does not fit into the small string buffer " + std::to_string(i)];
+            EXPECT_EQ(i, v);
+        }
+    }
+    EXPECT_EQ(0, alive);
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST(Context, DISABLED_localSalePayBenchmark)
+{
+    //the accesses of the local context by the handlers of /sale and /pay during the life of their tasks
+    const char* saleHandler = "saleClientHandler";
+    const char* payHandler = "payClientHandler";
+    RequestData data{"F4TD8JVFx2xWLeL3qwSmxLWVcPbmfUM1PanF2VPnQ7Ep2LjQCVncxqH3EZ3XCCuqQci5xi5GCYR7KRoytradoJg71DdfXpz", 12345, 100, "0123456789abcdef0123456789abcdef"};
+
+    auto saleAndPay = [&](auto& local)
+    {
+        size_t sum = 0;
+        for(int state = 0; state < 3; ++state)
+        {
+            HandlerState s = local.hasKey(saleHandler) ? local[saleHandler] : HandlerState::ClientRequest;
+            local[saleHandler] = HandlerState(int(s) + 1);
+            if(state == 0)
+            {
+                local["sale_data"] = data;
+                local["payment_id"] = data.PaymentID;
+            }
+            std::string payment_id = local["payment_id"];
+            sum += payment_id.size();
+        }
+        RequestData sale = local["sale_data"];
+        sum += sale.Amount;
+        for(int state = 0; state < 4; ++state)
+        {
+            HandlerState s = local.hasKey(payHandler) ? local[payHandler] : HandlerState::ClientRequest;
+            local[payHandler] = HandlerState((int(s) + 1) % 3);
+            if(state == 0) local["PayRequestBody"] = data;
+            std::string payment_id = local["payment_id"];
+            sum += payment_id.size();
+        }
+        return sum;
+    };
+
+    const int N = 200000;
+    auto run = [&](auto make, const char* name)
+    {
+        size_t sum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; ++i)
+        {
+            auto local = make();
+            sum += saleAndPay(*local);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        EXPECT_EQ(N * (7 * data.PaymentID.size() + data.Amount), sum);
+        std::cout << name << ": " << std::chrono::duration<double, std::nano>(t1 - t0).count() / N
+                  << " ns per sale and pay" << std::endl;
+    };
+    run([]{ return std::make_unique<MapLocal>(); }, "std::map<std::string, std::any>");
+    run([]{ return std::make_unique<graft::Context::Local>(); }, "Context::Local");
+}
+
+TEST(Context, globalMapGrowth)
+{
+    graft::GlobalContextMap m;
+    const int th_count = 4, N = 5000;
+    auto key = [](int t, int i) { return std::to_string(i) + ":" + std::to_string(t) + ":status"; };
+
+    std::vector<std::thread> ths;
+    for(int t = 0; t < th_count; ++t)
+    {
+        ths.emplace_back([&m, &key, t]
+        {
+            for(int i = 0; i < N; ++i) m.addOrUpdate(key(t, i), i);
+            for(int i = 0; i < N; i += 2) m.remove(key(t, i));
+            for(int i = 1; i < N; i += 2) m.apply(key(t, i), [](std::any& v) { ++std::any_cast<int&>(v); return true; });
+        });
+    }
+    for(auto& th : ths) th.join();
+
+    for(int t = 0; t < th_count; ++t)
+    {
+        for(int i = 0; i < N; ++i)
+        {
+            EXPECT_EQ(i % 2 == 1, m.hasKey(key(t, i)));
+            if(i % 2 == 1)
+            {
+                EXPECT_EQ(i + 1, std::any_cast<int>(m.valueFor(key(t, i))));
+            }
+        }
+    }
+}
+
+TEST(Context, globalAddOrApply)
+{
+    //the entries are created by the first update and updated atomically
+    graft::TSHashtable<std::string, std::vector<int>> m;
+    const int th_count = 4, N = 1000;
+    std::vector<std::thread> ths;
+    for(int t = 0; t < th_count; ++t)
+    {
+        ths.emplace_back([&m, t]
+        {
+            for(int i = 0; i < N; ++i) m.addOrApply(std::to_string(i % 10), [t](std::vector<int>& v) { v.push_back(t); });
+        });
+    }
+    for(auto& th : ths) th.join();
+
+    for(int i = 0; i < 10; ++i)
+    {
+        size_t size = 0;
+        EXPECT_TRUE(m.read(std::to_string(i), [&size](const std::vector<int>& v) { size = v.size(); }));
+        EXPECT_EQ(size_t(th_count * N / 10), size);
+    }
+    EXPECT_FALSE(m.read("10", [](const std::vector<int>&) { }));
+}
+
+TEST(Context, globalExpiryIndex)
+{
+    graft::GlobalContextMap m;
+    graft::Context ctx(m);
+
+    int expired = 0;
+    auto onExpired = [&expired](std::pair<std::string, std::any>&) { ++expired; };
+    for(int i = 0; i < 100; ++i)
+    {
+        ctx.global.set(std::to_string(i), i, std::chrono::seconds(1), onExpired);
+    }
+    ctx.global["no ttl"] = 1;
+    ctx.global.remove("10");
+    EXPECT_EQ(0u, graft::Context::GlobalFriend::cleanup(ctx.global));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    //an access prolongs the ttl
+    for(int i = 0; i < 10; ++i) EXPECT_TRUE(ctx.global.hasKey(std::to_string(i)));
+    EXPECT_EQ(89u, graft::Context::GlobalFriend::cleanup(ctx.global));
+    EXPECT_EQ(89, expired);
+    EXPECT_TRUE(ctx.global.hasKey("0"));
+    EXPECT_FALSE(ctx.global.hasKey("50"));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_EQ(10u, graft::Context::GlobalFriend::cleanup(ctx.global));
+    EXPECT_EQ(99, expired);
+    EXPECT_TRUE(ctx.global.hasKey("no ttl"));
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST(Context, DISABLED_globalMapBenchmark)
+{
+    //the payment keys, 80% reads and 20% writes from the threads of a pool
+    const int th_count = std::max(2u, std::thread::hardware_concurrency());
+    const int ops = 200000;
+    for(int keys : {1000, 100000, 1000000})
+    {
+        graft::GlobalContextMap m;
+        for(int i = 0; i < keys; ++i) m.addOrUpdate(std::to_string(i) + ":status", i);
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> ths;
+        std::atomic<size_t> found{0};
+        for(int t = 0; t < th_count; ++t)
+        {
+            ths.emplace_back([&m, &found, keys, ops, t]
+            {
+                uint32_t rnd = 2463534242u + t;
+                size_t cnt = 0;
+                for(int i = 0; i < ops; ++i)
+                {
+                    rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+                    std::string key = std::to_string(rnd % keys) + ":status";
+                    if(rnd % 5 == 0) m.addOrUpdate(key, int(i));
+                    else cnt += m.valueFor(key).has_value();
+                }
+                found += cnt;
+            });
+        }
+        for(auto& th : ths) th.join();
+        auto t1 = std::chrono::steady_clock::now();
+        EXPECT_LT(0u, found.load());
+        std::cout << keys << " keys, " << th_count << " threads: "
+                  << std::chrono::duration<double, std::nano>(t1 - t0).count() / (size_t(ops) * th_count)
+                  << " ns per operation" << std::endl;
+    }
+}
+
+TEST(Context, globalSharedValues)
+{
+    graft::GlobalContextMap m;
+    graft::Context ctx(m);
+
+    EXPECT_EQ(nullptr, ctx.global.getShared<RequestData>("sale"));
+
+    auto data = std::make_shared<RequestData>(RequestData{"address", 1, 100, "payment"});
+    ctx.global.setShared("sale", data, std::chrono::seconds(1));
+    std::shared_ptr<const RequestData> p1 = ctx.global.getShared<RequestData>("sale");
+    std::shared_ptr<const RequestData> p2 = ctx.global.getShared<RequestData>("sale");
+    //the readers share the stored value
+    EXPECT_EQ(data.get(), p1.get());
+    EXPECT_EQ(p1.get(), p2.get());
+    EXPECT_EQ(100u, p1->Amount);
+
+    //the value outlives the entry
+    ctx.global.setShared("sale", std::make_shared<RequestData>(RequestData{"address", 2, 200, "payment"}));
+    EXPECT_EQ(100u, p1->Amount);
+    EXPECT_EQ(200u, ctx.global.getShared<RequestData>("sale")->Amount);
+    ctx.global.remove("sale");
+    EXPECT_EQ(nullptr, ctx.global.getShared<RequestData>("sale"));
+    EXPECT_EQ("payment", p2->PaymentID);
+
+    //get does not require the key
+    EXPECT_EQ(5, ctx.global.get("missing", 5));
+    ctx.global["int"] = 7;
+    EXPECT_EQ(7, ctx.global.get("int", 5));
+    EXPECT_THROW(ctx.global.getShared<int>("int"), std::bad_any_cast);
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST(Context, DISABLED_globalSharedBenchmark)
+{
+    //a sale details response with the auth sample
+    struct SaleDetails
+    {
+        RequestData data;
+        std::vector<RequestData> authSample;
+    };
+    SaleDetails details;
+    details.data = RequestData{"F4TD8JVFx2xWLeL3qwSmxLWVcPbmfUM1PanF2VPnQ7Ep2LjQCVncxqH3EZ3XCCuqQci5xi5GCYR7KRoytradoJg71DdfXpz", 12345, 100, "0123456789abcdef0123456789abcdef"};
+    details.authSample.assign(8, details.data);
+
+    graft::GlobalContextMap m;
+    graft::Context ctx(m);
+    ctx.global.set("copy", details, std::chrono::seconds(0));
+    ctx.global.setShared("shared", std::make_shared<SaleDetails>(details));
+
+    const int N = 200000;
+    auto run = [&](auto read, const char* name)
+    {
+        size_t sum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; ++i) sum += read();
+        auto t1 = std::chrono::steady_clock::now();
+        EXPECT_EQ(N * details.authSample.size(), sum);
+        std::cout << name << ": " << std::chrono::duration<double, std::nano>(t1 - t0).count() / N
+                  << " ns per read" << std::endl;
+    };
+    run([&]{ return ctx.global.get("copy", SaleDetails()).authSample.size(); }, "get");
+    run([&]{ return ctx.global.getShared<SaleDetails>("shared")->authSample.size(); }, "getShared");
+}
+
+namespace
+{
+using ListKey = graft::ServiceKey<std::shared_ptr<std::vector<int>>, graft::services::AppIndex + 0>;
+using NameKey = graft::ServiceKey<std::string, graft::services::AppIndex + 1>;
+} //namespace
+
+TEST(Context, services)
+{
+    graft::GlobalContextMap m;
+    graft::Context ctx(m);
+
+    //not registered services are default values
+    EXPECT_EQ(nullptr, ctx.services().find<ListKey>());
+    EXPECT_EQ(nullptr, ctx.services().get<ListKey>());
+    EXPECT_EQ("", ctx.services().get<graft::services::CryptonodeRpcAddress>());
+    EXPECT_FALSE(ctx.services().get<graft::services::Testnet>());
+
+    auto list = std::make_shared<std::vector<int>>(3, 1);
+    m.services().set<ListKey>(list);
+    m.services().set<graft::services::Testnet>(true);
+    m.services().set<NameKey>("first");
+
+    EXPECT_EQ(list, ctx.services().get<ListKey>());
+    EXPECT_TRUE(ctx.services().get<graft::services::Testnet>());
+
+    //the reference to the replaced service stays valid
+    const std::string& name = ctx.services().get<NameKey>();
+    m.services().set<NameKey>("second");
+    EXPECT_EQ("first", name);
+    EXPECT_EQ("second", ctx.services().get<NameKey>());
+
+    //the services are read concurrently
+    std::vector<std::thread> ths;
+    std::atomic<size_t> sum{0};
+    for(int t = 0; t < 4; ++t)
+    {
+        ths.emplace_back([&ctx, &sum]
+        {
+            for(int i = 0; i < 1000; ++i) sum += ctx.services().get<ListKey>()->size();
+        });
+    }
+    for(auto& th : ths) th.join();
+    EXPECT_EQ(4 * 1000 * 3u, sum.load());
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST(Context, DISABLED_servicesBenchmark)
+{
+    //the lookups of the supernode list at the beginning of the handlers
+    graft::GlobalContextMap m;
+    graft::Context ctx(m);
+    auto list = std::make_shared<std::vector<int>>(3, 1);
+    ctx.global["fsl"] = list;
+    m.services().set<ListKey>(list);
+
+    const int N = 1000000;
+    auto run = [&](auto read, const char* name)
+    {
+        size_t sum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; ++i) sum += read();
+        auto t1 = std::chrono::steady_clock::now();
+        EXPECT_EQ(3u * N, sum);
+        std::cout << name << ": " << std::chrono::duration<double, std::nano>(t1 - t0).count() / N
+                  << " ns per lookup" << std::endl;
+    };
+    run([&]{ return ctx.global.get("fsl", std::shared_ptr<std::vector<int>>())->size(); }, "global context");
+    run([&]{ return ctx.services().get<ListKey>()->size(); }, "service registry");
+}
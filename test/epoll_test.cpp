@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "supernode/requests.h"
+#include "fixture.h"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#ifdef GN_ENABLE_EPOLL
+
+TEST_F(GraftServerTestBase, epollBackend)
+{
+    auto action = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        output.body = input.data();
+        return graft::Status::Ok;
+    };
+
+    TempCryptoNodeServer crypton;
+    crypton.on_http = crypton.http_echo;
+    crypton.run();
+
+    MainServer mainServer;
+    mainServer.m_copts.io_backend = "epoll";
+    mainServer.m_copts.io_threads = 2;
+    mainServer.m_router.addRoute("/echo",METHOD_POST,{nullptr,action,nullptr});
+    graft::supernode::request::registerForwardRequests(mainServer.m_router);
+    mainServer.run();
+
+    for(int i = 0; i < 10; ++i)
+    {
+        std::string post_data = "data " + std::to_string(i);
+        Client client;
+        client.serve("http://localhost:9084/echo", "", post_data);
+        EXPECT_EQ(false, client.get_closed());
+        EXPECT_EQ(200, client.get_resp_code());
+        EXPECT_EQ(post_data, client.get_body());
+    }
+    {//upstream through epoll backend
+        std::string post_data = "some data";
+        Client client;
+        client.serve("http://localhost:9084/json_rpc", "", post_data);
+        EXPECT_EQ(false, client.get_closed());
+        EXPECT_EQ(200, client.get_resp_code());
+        EXPECT_EQ(post_data, client.get_body());
+    }
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+}
+
+namespace
+{
+
+//measures mg_mgr_poll iteration cost with given number of idle connections
+double pollIterationUs(bool epoll, int connections, int iterations = 1000)
+{
+    mg_mgr mgr;
+    mg_mgr_init(&mgr, nullptr, nullptr);
+    if(epoll) mg::mg_mgr_use_epoll_x(&mgr, nullptr);
+
+    mg_connection* lc = mg_bind(&mgr, "127.0.0.1:9089", graft::static_empty_ev_handler);
+    EXPECT_NE(nullptr, lc);
+
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9089);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    std::vector<int> socks;
+    for(int i = 0; i < connections; ++i)
+    {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_LE(0, sock);
+        EXPECT_EQ(0, connect(sock, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)));
+        socks.push_back(sock);
+        if(i % 64 == 0) mg_mgr_poll(&mgr, 0);
+    }
+    //accept all
+    for(int i = 0; i < 100; ++i) mg_mgr_poll(&mgr, 1);
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < iterations; ++i)
+    {
+        mg_mgr_poll(&mgr, 0);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    for(int sock : socks) close(sock);
+    mg_mgr_free(&mgr);
+
+    return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(end - begin).count() / iterations;
+}
+
+bool enoughDescriptors(int connections)
+{
+    rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) != 0) return false;
+    rlim_t required = 2*connections + 64;
+    if(rl.rlim_cur < required)
+    {
+        rl.rlim_cur = std::min(required, rl.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    return required <= rl.rlim_cur;
+}
+
+} //namespace
+
+//run it using --gtest_also_run_disabled_tests
+TEST(Epoll, DISABLED_pollIterationBenchmark)
+{
+    for(int connections : {100, 1000, 10000})
+    {
+        if(!enoughDescriptors(connections))
+        {
+            std::cout << connections << " connections: not enough file descriptors, skipped\n";
+            continue;
+        }
+        double epoll_us = pollIterationUs(true, connections);
+        std::cout << connections << " connections: epoll " << epoll_us << " us/iteration";
+        //select cannot handle descriptors above FD_SETSIZE
+        if(2*connections + 64 < FD_SETSIZE)
+        {
+            double select_us = pollIterationUs(false, connections);
+            std::cout << ", select " << select_us << " us/iteration";
+        }
+        std::cout << std::endl;
+    }
+}
+
+#endif //GN_ENABLE_EPOLL
@@ -5,6 +5,8 @@
 #include "lib/graft/inout.h"
 #include "lib/graft/handler_api.h"
 #include "lib/graft/expiring_list.h"
+#include "lib/graft/fan_out.h"
+#include "lib/graft/flow.h"
 #include "supernode/requests.h"
 #include "supernode/requests/sale.h"
 #include "supernode/requests/sale_status.h"
@@ -13,12 +15,21 @@
 #include "supernode/requests/pay.h"
 #include "supernode/requests/pay_status.h"
 #include "supernode/requests/reject_pay.h"
+#include "supernode/requests/send_raw_tx.h"
+#include "supernode/requests/send_transfer.h"
 #include "supernode/requestdefines.h"
 #include "fixture.h"
 
 #include <misc_log_ex.h>
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <future>
+#include <set>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
 
 GRAFT_DEFINE_IO_STRUCT(Payment,
       (uint64, amount),
@@ -80,6 +91,51 @@ TEST(InOut, common)
     EXPECT_EQ(s_out, s);
 }
 
+TEST(InOut, sharedMessage)
+{
+    using namespace graft;
+
+    std::string req = "POST /root/r1 HTTP/1.1\r\nContent-Length: 25\r\nX-Test: 1\r\n\r\n{\"s\":\"a large body here\"}";
+    http_message hm;
+    int len = mg_parse_http(req.c_str(), req.size(), &hm, 1);
+    ASSERT_LT(0, len);
+    hm.message.len = len + hm.body.len;
+
+    char* buf = new char[hm.message.len];
+    memcpy(buf, hm.message.p, hm.message.len);
+    std::shared_ptr<const char> message(buf, std::default_delete<const char[]>());
+
+    Input in(hm, "127.0.0.1", message);
+    //the body is not copied
+    EXPECT_EQ(buf + (hm.body.p - hm.message.p), in.body_view().data());
+    EXPECT_EQ(buf + (hm.body.p - hm.message.p), in.body.view().data());
+    EXPECT_EQ("{\"s\":\"a large body here\"}", in.data());
+    EXPECT_EQ("POST", in.method);
+    EXPECT_EQ("/root/r1", in.uri);
+    ASSERT_EQ(2u, in.headers.size());
+    EXPECT_EQ("X-Test", in.headers[1].first);
+
+    GRAFT_DEFINE_IO_STRUCT(S, (std::string, s));
+    S s = in.get<S>();
+    EXPECT_EQ("a large body here", s.s);
+
+    //copies share the message
+    Input copy = in;
+    message.reset();
+    in.reset();
+    EXPECT_EQ(buf + (hm.body.p - hm.message.p), copy.body_view().data());
+    EXPECT_EQ("a large body here", copy.get<S>().s);
+
+    //the body is copied on the access as std::string
+    const std::string& body = copy.body;
+    EXPECT_EQ("{\"s\":\"a large body here\"}", body);
+    EXPECT_EQ(body.data(), copy.body_view().data());
+
+    Output out; out.body = "out";
+    copy.assign(out);
+    EXPECT_EQ("out", copy.data());
+}
+
 namespace graft { namespace serializer {
 
 template<typename T>
@@ -435,7 +491,7 @@ TEST(Context, expiration)
     }
 
     std::this_thread::sleep_for(std::chrono::milliseconds(1200));
-    graft::Context::GlobalFriend::cleanup(ctx.global, true);
+    graft::Context::GlobalFriend::cleanup(ctx.global);
     EXPECT_EQ(res, cmp_res);
 }
 
@@ -886,6 +942,266 @@ TEST_F(GraftServerTestBase, Again)
     EXPECT_EQ(step,5);
 }
 
+TEST_F(GraftServerTestBase, preActionResults)
+{//the results of pre_action that skip worker_action
+    std::atomic<int> worker_calls{0}, post_calls{0};
+    auto pre_action = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        std::string body = input.data();
+        if(ctx.local.getLastStatus() == graft::Status::Forward)
+        {//the answer of the cryptonode
+            EXPECT_EQ(body, "forward");
+            output.body = "forwarded";
+            return graft::Status::Ok;
+        }
+        output.body = body;
+        if(body == "error") return graft::Status::Error;
+        if(body == "drop") return graft::Status::Drop;
+        if(body == "forward") return graft::Status::Forward;
+        return graft::Status::Ok;
+    };
+    auto action = [&worker_calls](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        ++worker_calls;
+        output.body = input.data();
+        return graft::Status::Ok;
+    };
+    auto post_action = [&post_calls](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        ++post_calls;
+        output.body = input.data();
+        return graft::Status::Ok;
+    };
+
+    TempCryptoNodeServer crypton;
+    crypton.on_http = crypton.http_echo;
+    crypton.run();
+    MainServer mainServer;
+    mainServer.m_router.addRoute("/pre", METHOD_POST, {pre_action, action, post_action});
+    mainServer.run();
+
+    auto serve = [](const std::string& post_data, int code, const std::string& body)
+    {
+        Client client;
+        client.serve("http://localhost:9084/pre", "", post_data);
+        EXPECT_EQ(false, client.get_closed());
+        EXPECT_EQ(code, client.get_resp_code());
+        EXPECT_EQ(body, client.get_body());
+    };
+
+    serve("error", 500, "error");
+    serve("drop", 400, "Job done Drop.");
+    EXPECT_EQ(0, worker_calls);
+    EXPECT_EQ(0, post_calls);
+
+    serve("ok", 200, "ok");
+    EXPECT_EQ(1, worker_calls);
+    EXPECT_EQ(1, post_calls);
+
+    //post_action is called before forwarding, the answer goes through all the actions
+    serve("forward", 200, "forwarded");
+    EXPECT_EQ(2, worker_calls);
+    EXPECT_EQ(3, post_calls);
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST_F(GraftServerTestBase, DISABLED_executeBenchmark)
+{
+    const int runs = 1000000;
+    MainServer mainServer;
+    graft::Looper* looper = nullptr;
+
+    bool stop = false;
+    auto noop = [&stop](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        return stop? graft::Status::Stop : graft::Status::Ok;
+    };
+    //a periodic task with the no-op handler is executed directly in the IO thread, without the connection and the timer
+    auto bench = [&](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        graft::BaseTaskPtr bt = graft::BaseTask::Create<graft::PeriodicTask>(*looper, graft::Router::Handler3(noop, nullptr, nullptr), std::chrono::hours(1));
+        auto begin = std::chrono::steady_clock::now();
+        for(int i = 0; i < runs; ++i)
+        {
+            looper->onTimer(bt);
+            looper->getTimers().cancel(bt->getTimer());
+        }
+        auto end = std::chrono::steady_clock::now();
+        stop = true;
+        looper->onTimer(bt);
+        output.body = std::to_string(std::chrono::duration<double, std::nano>(end - begin).count() / runs);
+        return graft::Status::Ok;
+    };
+    mainServer.m_router.addRoute("/execute", METHOD_GET, {bench, nullptr, nullptr});
+    mainServer.run();
+    looper = &mainServer.getLooper();
+
+    Client client;
+    client.serve("http://localhost:9084/execute", "", "", 60000);
+    EXPECT_EQ(200, client.get_resp_code());
+    std::cout << "Execute of a no-op handler: " << client.get_body() << " ns" << std::endl;
+
+    mainServer.stop_and_wait_for();
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST_F(GraftServerTestBase, DISABLED_priorityLanesBenchmark)
+{
+    //a flood of slow bulk jobs in the workers and short RTA jobs, see forwardLanes for the forwards;
+    //the same RTA handler is registered in the high lane and in the lane of the flood
+    auto spin = [](int us)
+    {
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+        while(std::chrono::steady_clock::now() < until);
+    };
+    auto rta = [spin](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        spin(100);
+        output.body = "rta";
+        return graft::Status::Ok;
+    };
+    auto bulk = [spin](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        spin(2000);
+        output.body = "bulk";
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_copts.workers_count = 2;
+    mainServer.m_copts.worker_queue_len = 64;
+    mainServer.m_copts.http_connection_timeout = 10;
+    mainServer.m_router.addRoute("/rta", METHOD_POST, {nullptr, rta, nullptr}, graft::Priority::High);
+    mainServer.m_router.addRoute("/rta_fifo", METHOD_POST, {nullptr, rta, nullptr}, graft::Priority::Bulk);
+    mainServer.m_router.addRoute("/bulk", METHOD_POST, {nullptr, bulk, nullptr}, graft::Priority::Bulk);
+    mainServer.run();
+
+    //returns sorted latencies of the requests in milliseconds
+    auto measure = [](const std::string& url, int count)
+    {
+        std::vector<double> res;
+        for(int i = 0; i < count; ++i)
+        {
+            Client client;
+            auto begin = std::chrono::steady_clock::now();
+            client.serve(url, "", "vote", 30000);
+            auto end = std::chrono::steady_clock::now();
+            EXPECT_EQ(200, client.get_resp_code());
+            res.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    };
+    auto print = [](const char* name, const std::vector<double>& v)
+    {
+        std::cout << name << ": median " << v[v.size()/2] << " ms, p99 " << v[v.size()*99/100]
+                  << " ms, max " << v.back() << " ms" << std::endl;
+    };
+
+    print("rta idle", measure("http://localhost:9084/rta", 500));
+
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> flood;
+    for(int t = 0; t < 16; ++t)
+    {
+        flood.emplace_back([&stop]()
+        {
+            while(!stop)
+            {
+                Client client;
+                client.serve("http://localhost:9084/bulk", "", "getblocks", 30000);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    print("rta during bulk flood", measure("http://localhost:9084/rta", 500));
+    print("rta in the bulk lane during bulk flood", measure("http://localhost:9084/rta_fifo", 100));
+    stop = true;
+    for(auto& th : flood) th.join();
+
+    mainServer.stop_and_wait_for();
+}
+
+TEST_F(GraftServerTestBase, forwardLanes)
+{
+    //a flood of bulk forwards to a slow cryptonode with limited connections, like a wallet resync, and RTA forwards;
+    //the forwards wait for a connection in the lanes of their routes
+    auto forward = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        output.body = input.body;
+        if(ctx.local.getLastStatus() == graft::Status::Forward) return graft::Status::Ok;
+        return graft::Status::Forward;
+    };
+
+    TempCryptoNodeServer crypton;
+    crypton.on_http = [] (const http_message *hm, int& status_code, std::string& headers, std::string& data) -> bool
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return TempCryptoNodeServer::http_echo(hm, status_code, headers, data);
+    };
+    crypton.run();
+
+    MainServer mainServer;
+    mainServer.m_copts.http_connection_timeout = 30;
+    mainServer.m_copts.upstream_request_timeout = 30;
+    mainServer.m_copts.cryptonode_max_connections = 4;
+    mainServer.m_router.addRoute("/rta", METHOD_POST, {forward, nullptr, nullptr}, graft::Priority::High);
+    mainServer.m_router.addRoute("/rta_fifo", METHOD_POST, {forward, nullptr, nullptr}, graft::Priority::Bulk);
+    mainServer.m_router.addRoute("/bulk", METHOD_POST, {forward, nullptr, nullptr}, graft::Priority::Bulk);
+    mainServer.run();
+
+    //returns sorted latencies of the requests in milliseconds
+    auto measure = [](const std::string& url, int count)
+    {
+        std::vector<double> res;
+        for(int i = 0; i < count; ++i)
+        {
+            Client client;
+            auto begin = std::chrono::steady_clock::now();
+            client.serve(url, "", "vote", 30000);
+            auto end = std::chrono::steady_clock::now();
+            EXPECT_EQ(200, client.get_resp_code());
+            res.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    };
+    auto p99 = [](const std::vector<double>& v) { return v[v.size()*99/100]; };
+    auto median = [](const std::vector<double>& v) { return v[v.size()/2]; };
+
+    std::vector<double> idle = measure("http://localhost:9084/rta", 200);
+
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> flood;
+    for(int t = 0; t < 32; ++t)
+    {
+        flood.emplace_back([&stop]()
+        {
+            while(!stop)
+            {
+                Client client;
+                client.serve("http://localhost:9084/bulk", "", "getblocks", 30000);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::vector<double> high = measure("http://localhost:9084/rta", 200);
+    std::vector<double> fifo = measure("http://localhost:9084/rta_fifo", 50);
+    stop = true;
+    for(auto& th : flood) th.join();
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+
+    //a forward of the high lane waits only for one of the busy connections, the one of the bulk lane waits for the
+    //whole flood ahead of it
+    EXPECT_LT(p99(high), median(fifo));
+    EXPECT_LT(p99(high), p99(idle) + 25);
+}
+
 TEST_F(GraftServerCommonTest, cryptonTimeout)
 {//GET -> threadPool -> CryptoNode -> timeout
     graft::Context ctx(mainServer.getGcm());
@@ -1095,7 +1411,7 @@ TEST_F(GraftServerPostponeTest, common)
     {
         output.body = input.data();
         assert(vars.count("id") == 1);
-        std::string id = vars.find("id")->second;
+        std::string id(vars.find("id")->second);
         boost::uuids::string_generator sg;
         boost::uuids::uuid uuid = sg(id);
 
@@ -1213,6 +1529,503 @@ TEST_F(GraftServerTestBase, forward)
     crypton.stop_and_wait_for();
 }
 
+TEST_F(GraftServerTestBase, flow)
+{//the locals are kept in the frame between the hops to the cryptonode
+    struct EchoFrame : graft::FlowFrame
+    {
+        std::string collected;
+        int hops = 0;
+    };
+
+    graft::Flow<EchoFrame> flow;
+    flow.then([](EchoFrame& frame, const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        EXPECT_EQ(ctx.local.getLastStatus(), graft::Status::None);
+        output.body = input.data();
+        return graft::Status::Forward;
+    })
+    .then([](EchoFrame& frame, const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        EXPECT_EQ(ctx.local.getLastStatus(), graft::Status::Forward);
+        frame.collected += input.data();
+        if(++frame.hops < 3)
+        {
+            output.body = input.data() + "+";
+            frame.repeat();
+            return graft::Status::Forward;
+        }
+        output.body = frame.collected;
+        return graft::Status::Ok;
+    });
+
+    TempCryptoNodeServer crypton;
+    crypton.on_http = crypton.http_echo;
+    crypton.run();
+    MainServer mainServer;
+    mainServer.m_router.addRoute("/flow", METHOD_POST, {nullptr, flow, nullptr});
+    mainServer.run();
+
+    Client client;
+    client.serve("http://localhost:9084/flow", "", "a");
+    EXPECT_EQ(false, client.get_closed());
+    EXPECT_EQ(200, client.get_resp_code());
+    EXPECT_EQ("aa+a++", client.get_body());
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+}
+
+TEST_F(GraftServerTestBase, fanOut)
+{//the requests are sent concurrently, the handler is called once with the answers in the order of the requests
+    TempCryptoNodeServer crypton;
+    crypton.on_http = [] (const http_message *hm, int& status_code, std::string& headers, std::string& data) -> bool
+    {
+        data = std::string(hm->body.p, hm->body.len);
+        //no answer, the connection is closed by timeout of the server
+        if(data == "ignore") return false;
+        headers = "Content-Type: application/json\r\nConnection: close";
+        return true;
+    };
+    crypton.run();
+
+    int calls = 0;
+    auto action = [&calls](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        ++calls;
+        graft::FanOut& fanOut = ctx.fanOut();
+        if(ctx.local.getLastStatus() == graft::Status::None)
+        {
+            for(const char* s : {"a", "b", "c"})
+            {
+                graft::Output out;
+                out.body = s;
+                fanOut.add(std::move(out));
+            }
+            if(input.data() == "timeout")
+            {
+                graft::Output out;
+                out.body = "ignore";
+                fanOut.add(std::move(out));
+                fanOut.setTimeout(std::chrono::milliseconds(200));
+            }
+            return graft::Status::Forward;
+        }
+        EXPECT_EQ(ctx.local.getLastStatus(), graft::Status::Forward);
+        for(size_t i = 0; i < fanOut.size(); ++i)
+        {
+            output.body += (fanOut.status(i) == graft::Status::Ok)? fanOut.input(i).data() : "-";
+        }
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_router.addRoute("/fanout", METHOD_POST, {nullptr, action, nullptr});
+    mainServer.run();
+
+    {
+        Client client;
+        client.serve("http://localhost:9084/fanout", "", "all");
+        EXPECT_EQ(200, client.get_resp_code());
+        EXPECT_EQ("abc", client.get_body());
+        EXPECT_EQ(2, calls);
+    }
+    {
+        calls = 0;
+        auto begin = std::chrono::steady_clock::now();
+        Client client;
+        client.serve("http://localhost:9084/fanout", "", "timeout");
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+        EXPECT_EQ(200, client.get_resp_code());
+        EXPECT_EQ("abc-", client.get_body());
+        EXPECT_EQ(2, calls);
+        EXPECT_LT(ms, 900);
+    }
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+}
+
+//Simulates cryptonode that answers none of the requests until the expected number of them is received.
+//A client that sends its requests one after another gets no answer and fails by the upstream timeout.
+class HoldingCryptoNodeServer
+{
+public:
+    size_t expected = 0;
+    std::string answer;
+    //the requests that were held at once, the uris of all the requests
+    std::atomic<size_t> held{0};
+    std::vector<std::string> uris;
+
+    void run()
+    {
+        ready = false;
+        stop = false;
+        th = std::thread([this]
+        {
+            mg_mgr mgr;
+            mg_mgr_init(&mgr, this, 0);
+            mg_connection* nc = mg_bind(&mgr, "1234", ev_handler);
+            mg_set_protocol_http_websocket(nc);
+            ready = true;
+            while(!stop) mg_mgr_poll(&mgr, 100);
+            mg_mgr_free(&mgr);
+        });
+        while(!ready) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    void stop_and_wait_for()
+    {
+        stop = true;
+        th.join();
+    }
+private:
+    static void ev_handler(mg_connection* client, int ev, void* ev_data)
+    {
+        HoldingCryptoNodeServer* This = static_cast<HoldingCryptoNodeServer*>(client->mgr->user_data);
+        switch(ev)
+        {
+        case MG_EV_HTTP_REQUEST:
+        {
+            http_message* hm = static_cast<http_message*>(ev_data);
+            This->uris.emplace_back(hm->uri.p, hm->uri.len);
+            This->pending.push_back(client);
+            if(This->pending.size() < This->expected) break;
+            This->held = This->pending.size();
+            for(mg_connection* nc : This->pending)
+            {
+                mg_send_head(nc, 200, This->answer.size(), "Content-Type: application/json\r\nConnection: close");
+                mg_send(nc, This->answer.c_str(), This->answer.size());
+                nc->flags |= MG_F_SEND_AND_CLOSE;
+            }
+            This->pending.clear();
+        } break;
+        case MG_EV_CLOSE:
+        {
+            auto& pending = This->pending;
+            pending.erase(std::remove(pending.begin(), pending.end(), client), pending.end());
+        } break;
+        default:
+            break;
+        }
+    }
+
+    std::thread th;
+    std::atomic_bool ready;
+    std::atomic_bool stop;
+    std::vector<mg_connection*> pending;
+};
+
+TEST_F(GraftServerTestBase, sendTransferConcurrent)
+{//all the transactions of send_transfer are sent to cryptonode before any of them is answered
+    const size_t N = 4;
+    HoldingCryptoNodeServer crypton;
+    crypton.expected = N;
+    crypton.answer = "{\"status\":\"OK\"}";
+    crypton.run();
+
+    //the handler of the route, its calls are counted
+    graft::Router::Handler3 h3;
+    {
+        graft::Router router;
+        graft::supernode::request::registerSendTransferRequest(router);
+        graft::Router::Root root;
+        root.addRouter(router);
+        ASSERT_TRUE(root.arm());
+        graft::Router::JobParams params;
+        ASSERT_TRUE(root.match("/send_transfer", METHOD_POST, params));
+        h3 = *params.h3;
+    }
+    std::atomic<int> calls{0};
+    graft::Router::Handler worker_action = h3.worker_action;
+    h3.worker_action = [&calls, worker_action](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        ++calls;
+        return worker_action(vars, input, ctx, output);
+    };
+
+    graft::supernode::request::SendTransferRequest req;
+    for(size_t i = 0; i < N; ++i)
+    {
+        cryptonote::transaction tx;
+        tx.version = 1;
+        tx.unlock_time = i;
+        graft::supernode::request::SendRawTxRequest raw;
+        ASSERT_TRUE(graft::supernode::request::createSendRawTxRequest(tx, raw));
+        req.Transactions.push_back(raw.tx_as_hex);
+    }
+    graft::Output body;
+    body.load(req);
+
+    MainServer mainServer;
+    mainServer.m_copts.upstream_request_timeout = 5;
+    mainServer.m_copts.http_connection_timeout = 5;
+    mainServer.m_router.addRoute("/send_transfer", METHOD_POST, h3);
+    mainServer.run();
+
+    auto begin = std::chrono::steady_clock::now();
+    Client client;
+    client.serve("http://localhost:9084/send_transfer", "Content-Type: application/json\r\n", body.body);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+
+    EXPECT_EQ(200, client.get_resp_code());
+    graft::supernode::request::SendTransferResponse res;
+    graft::Input in; in.load(client.get_body());
+    ASSERT_TRUE(in.get(res));
+    EXPECT_EQ(STATUS_OK, res.Result);
+    EXPECT_EQ(N, crypton.held.load());
+    EXPECT_EQ(std::vector<std::string>(N, "/sendrawtransaction"), crypton.uris);
+    //the handler is called for the request and resumed once for all the answers
+    EXPECT_EQ(2, calls);
+    EXPECT_LT(ms, 2000);
+}
+
+TEST_F(GraftServerTestBase, ioThreads)
+{
+    auto action = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        output.body = input.data();
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_copts.io_threads = 4;
+    mainServer.m_router.addRoute("/echo",METHOD_POST,{nullptr,action,nullptr});
+    mainServer.run();
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([t]()
+        {
+            for(int i = 0; i < 10; ++i)
+            {
+                std::string post_data = "data " + std::to_string(t) + " " + std::to_string(i);
+                Client client;
+                client.serve("http://localhost:9084/echo", "", post_data);
+                EXPECT_EQ(false, client.get_closed());
+                EXPECT_EQ(200, client.get_resp_code());
+                EXPECT_EQ(post_data, client.get_body());
+            }
+        });
+    }
+    for(auto& th : threads) th.join();
+
+    mainServer.stop_and_wait_for();
+}
+
+TEST_F(GraftServerTestBase, ioThreadsHandlerAPI)
+{//the periodic tasks and the async upstream requests from the IO actions of all the loopers
+    TempCryptoNodeServer crypton;
+    crypton.on_http = crypton.http_echo;
+    crypton.run();
+
+    std::atomic<int> timer_count{0}, upstream_count{0}, upstream_errors{0};
+    std::mutex mutex;
+    std::set<std::thread::id> io_threads;
+    auto timer_action = [&timer_count](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        ++timer_count;
+        return graft::Status::Stop;
+    };
+    auto io_action = [&](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            io_threads.insert(std::this_thread::get_id());
+        }
+        ctx.handlerAPI()->addPeriodicTask(timer_action, std::chrono::milliseconds(10));
+        graft::Output out; out.body = input.data();
+        ctx.handlerAPI()->sendUpstreamAsync(out, [&](const graft::Input& input, const std::string& err)
+        {
+            if(err.empty()) ++upstream_count;
+            else ++upstream_errors;
+        });
+        output.body = input.data();
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_copts.io_threads = 4;
+    mainServer.m_router.addRoute("/pre", METHOD_POST, {io_action, nullptr, nullptr});
+    mainServer.m_router.addRoute("/post", METHOD_POST, {nullptr, nullptr, io_action});
+    mainServer.run();
+
+    const int requests = 16;
+    for(int i = 0; i < requests; ++i)
+    {
+        Client client;
+        client.serve(std::string("http://localhost:9084/") + (i % 2? "post" : "pre"), "", "data " + std::to_string(i));
+        EXPECT_EQ(200, client.get_resp_code());
+    }
+    for(int i = 0; i < 500 && (timer_count < requests || upstream_count + upstream_errors < requests); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+
+    //SO_REUSEPORT spreads the connections over the loopers
+    EXPECT_LT(1u, io_threads.size());
+    EXPECT_LE(requests, timer_count);
+    EXPECT_EQ(requests, upstream_count);
+    EXPECT_EQ(0, upstream_errors);
+}
+
+TEST_F(GraftServerTestBase, keepAlivePipelining)
+{
+    auto action = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        std::string body = input.data();
+        //the first request is processed longer than the second
+        if(body == "first") std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        output.body = body;
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_copts.http_connection_timeout = 5;
+    mainServer.m_router.addRoute("/echo",METHOD_POST,{nullptr,action,nullptr});
+    mainServer.run();
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_LE(0, sock);
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9084);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, connect(sock, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)));
+
+    auto request = [](const std::string& body, bool close = false)
+    {
+        return "POST /echo HTTP/1.1\r\nHost: localhost\r\n" + std::string(close? "Connection: close\r\n" : "")
+                + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    };
+    auto read_all = [sock]()
+    {
+        std::string res;
+        char buf[1024];
+        for(;;)
+        {
+            ssize_t n = recv(sock, buf, sizeof(buf), 0);
+            if(n <= 0) break;
+            res.append(buf, n);
+        }
+        return res;
+    };
+
+    //two pipelined requests and the third one closes the connection
+    std::string reqs = request("first") + request("second") + request("third", true);
+    ASSERT_EQ(ssize_t(reqs.size()), send(sock, reqs.c_str(), reqs.size(), 0));
+    std::string res = read_all();
+    close(sock);
+
+    size_t p1 = res.find("first"), p2 = res.find("second"), p3 = res.find("third");
+    EXPECT_NE(std::string::npos, p1);
+    EXPECT_NE(std::string::npos, p2);
+    EXPECT_NE(std::string::npos, p3);
+    EXPECT_LT(p1, p2);
+    EXPECT_LT(p2, p3);
+    EXPECT_NE(std::string::npos, res.find("Connection: keep-alive"));
+    EXPECT_NE(std::string::npos, res.find("Connection: close"));
+
+    mainServer.stop_and_wait_for();
+}
+
+TEST_F(GraftServerTestBase, unknownMethodPipelined)
+{
+    auto action = [](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        output.body = "first";
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_copts.http_connection_timeout = 5;
+    mainServer.m_router.addRoute("/echo",METHOD_POST,{nullptr,action,nullptr});
+    mainServer.run();
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_LE(0, sock);
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9084);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, connect(sock, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)));
+
+    //the request with the unknown method is answered after the first one and closes the connection,
+    //the request after it is not answered
+    std::string reqs = "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n"
+                       "BREW /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n"
+                       "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n";
+    ASSERT_EQ(ssize_t(reqs.size()), send(sock, reqs.c_str(), reqs.size(), 0));
+    std::string res;
+    char buf[1024];
+    for(ssize_t n; 0 < (n = recv(sock, buf, sizeof(buf), 0)); ) res.append(buf, n);
+    close(sock);
+
+    size_t p1 = res.find("first"), p2 = res.find(" 501 ");
+    EXPECT_NE(std::string::npos, p1);
+    EXPECT_NE(std::string::npos, p2);
+    EXPECT_LT(p1, p2);
+    EXPECT_EQ(std::string::npos, res.find("first", p1 + 1));
+
+    mainServer.stop_and_wait_for();
+}
+
+TEST_F(GraftServerTestBase, largeResponse)
+{
+    //the response does not fit into the socket buffer, the rest is sent from the send buffer of the connection
+    const std::string large(4*1024*1024, 'x');
+    auto action = [&large](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        output.body = (input.data() == "large")? large : input.data();
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_router.addRoute("/echo",METHOD_POST,{nullptr,action,nullptr});
+    mainServer.run();
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_LE(0, sock);
+    sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9084);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, connect(sock, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)));
+
+    std::string reqs = "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nlarge"
+            "POST /echo HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Length: 5\r\n\r\nsmall";
+    ASSERT_EQ(ssize_t(reqs.size()), send(sock, reqs.c_str(), reqs.size(), 0));
+    std::string res;
+    char buf[64*1024];
+    for(;;)
+    {
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if(n <= 0) break;
+        res.append(buf, n);
+    }
+    close(sock);
+
+    size_t p1 = res.find("Content-Length: " + std::to_string(large.size()) + "\r\n");
+    ASSERT_NE(std::string::npos, p1);
+    size_t b1 = res.find("\r\n\r\n", p1);
+    ASSERT_NE(std::string::npos, b1);
+    b1 += 4;
+    EXPECT_EQ(large, res.substr(b1, large.size()));
+    size_t p2 = res.find("HTTP/1.1 200", b1 + large.size());
+    EXPECT_EQ(b1 + large.size(), p2);
+    EXPECT_EQ("small", res.substr(res.size() - 5));
+
+    mainServer.stop_and_wait_for();
+}
+
 GRAFT_DEFINE_IO_STRUCT(GetVersionResp,
                        (std::string, status),
                        (uint32_t, version)
@@ -1362,6 +2175,31 @@ TEST_F(GraftServerTestBase, addPeriodicTask)
     mainServer.stop_and_wait_for();
 }
 
+TEST_F(GraftServerTestBase, timerAccuracy)
+{
+    //timers should not wait for timer_poll_interval_ms
+    std::atomic<int> timer_count(0);
+    auto timer_action = [&timer_count](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        ++timer_count;
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_copts.timer_poll_interval_ms = 1000;
+    mainServer.run();
+
+    auto begin = std::chrono::steady_clock::now();
+    mainServer.getLooper().addPeriodicTask(timer_action, std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    int count = timer_count;
+    int expected = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count() / 10;
+    mainServer.stop_and_wait_for();
+
+    EXPECT_LE(expected/2, count);
+    EXPECT_LE(count, expected + 1);
+}
+
 TEST_F(GraftServerBlockingTest, common)
 {
     TempCryptoN crypton;
@@ -1420,3 +2258,67 @@ TEST_F(GraftServerBlockingTest, common)
     mainServer.stop_and_wait_for();
     crypton.stop_and_wait_for();
 }
+
+TEST_F(GraftServerBlockingTest, async)
+{
+    TempCryptoN crypton;
+    crypton.answer = "crypton answer";
+    crypton.run();
+
+    //from pre_action, from worker_action, with error
+    std::promise<std::string> results[3];
+    auto send = [](graft::Context& ctx, std::promise<std::string>& result)
+    {
+        Sstr ss; ss.s = "my string";
+        graft::Output out; out.load(ss);
+        ctx.handlerAPI()->sendUpstreamAsync(out, [&result](const graft::Input& input, const std::string& err)
+        {
+            result.set_value(err.empty()? input.data() : "error " + err);
+        });
+    };
+    auto pre_action = [&](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        send(ctx, results[0]);
+        return graft::Status::Ok;
+    };
+    auto action = [&](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        send(ctx, results[1]);
+        return graft::Status::Ok;
+    };
+    auto action_err = [&](const graft::Router::vars_t& vars, const graft::Input& input, graft::Context& ctx, graft::Output& output)->graft::Status
+    {
+        send(ctx, results[2]);
+        return graft::Status::Ok;
+    };
+
+    MainServer mainServer;
+    mainServer.m_router.addRoute("/json_async", METHOD_POST|METHOD_GET,
+                               graft::Router::Handler3(pre_action, action, nullptr));
+    mainServer.m_router.addRoute("/json_async_err", METHOD_POST|METHOD_GET,
+                               graft::Router::Handler3(nullptr, action_err, nullptr));
+    mainServer.run();
+
+    std::string post_data = "some data";
+    Client client;
+    //the response does not wait for the upstream
+    client.serve("http://localhost:9084/json_async", "", post_data);
+    EXPECT_EQ(false, client.get_closed());
+    EXPECT_EQ(200, client.get_resp_code());
+    for(int i = 0; i < 2; ++i)
+    {
+        std::future<std::string> future = results[i].get_future();
+        ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(5)));
+        EXPECT_EQ(crypton.answer, future.get());
+    }
+
+    crypton.ignore = true;
+    client.serve("http://localhost:9084/json_async_err", "", post_data);
+    EXPECT_EQ(200, client.get_resp_code());
+    std::future<std::string> future = results[2].get_future();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(5)));
+    EXPECT_EQ(0, future.get().find("error "));
+
+    mainServer.stop_and_wait_for();
+    crypton.stop_and_wait_for();
+}
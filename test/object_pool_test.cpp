@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+#include "lib/graft/object_pool.h"
+
+#include <thread>
+
+TEST(SlabPool, reuse)
+{
+    graft::SlabPool* pool = graft::SlabPool::create();
+    graft::SlabPool::setCurrent(pool);
+
+    void* p1 = graft::SlabPool::allocate(100);
+    graft::SlabPool::deallocate(p1);
+    void* p2 = graft::SlabPool::allocate(120);
+    EXPECT_EQ(p1, p2);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p2) % graft::SlabPool::Alignment);
+
+    //freed by another thread, it is reused after the free list of the class is empty
+    std::thread([p2]{ graft::SlabPool::deallocate(p2); }).join();
+    void* p3 = graft::SlabPool::allocate(100);
+    EXPECT_EQ(p2, p3);
+
+    //the pool lives until the last block is freed
+    void* big = graft::SlabPool::allocate(graft::SlabPool::MaxSize + 1);
+    graft::SlabPool::setCurrent(nullptr);
+    void* heap = graft::SlabPool::allocate(10);
+    pool->close();
+    graft::SlabPool::deallocate(big);
+    graft::SlabPool::deallocate(heap);
+    std::thread([p3]{ graft::SlabPool::deallocate(p3); }).join();
+}
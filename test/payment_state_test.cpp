@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "supernode/payment_state.h"
+
+#include <chrono>
+#include <thread>
+
+using graft::PaymentState;
+using graft::PaymentStateStore;
+using graft::RTAStatus;
+
+TEST(PaymentStateStore, bindAndLookupByTx)
+{
+    PaymentStateStore payments;
+    EXPECT_TRUE(payments.paymentIdByTx("tx1").empty());
+
+    payments.bindTx("tx1", "pay1", [](PaymentState& state) { state.txAmount = 10; });
+    EXPECT_EQ("pay1", payments.paymentIdByTx("tx1"));
+    uint64_t amount = 0;
+    std::string tx_id;
+    EXPECT_TRUE(payments.read("pay1", [&](const PaymentState& state) { amount = state.txAmount; tx_id = state.txId; }));
+    EXPECT_EQ(10u, amount);
+    EXPECT_EQ("tx1", tx_id);
+
+    //rebinding the payment drops the old tx
+    payments.bindTx("tx2", "pay1");
+    EXPECT_TRUE(payments.paymentIdByTx("tx1").empty());
+    EXPECT_EQ("pay1", payments.paymentIdByTx("tx2"));
+
+    //the tx bound to another payment does not belong to the first one anymore
+    payments.bindTx("tx2", "pay2");
+    EXPECT_EQ("pay2", payments.paymentIdByTx("tx2"));
+    payments.remove("pay1");
+    EXPECT_EQ("pay2", payments.paymentIdByTx("tx2"));
+    payments.remove("pay2");
+    EXPECT_TRUE(payments.paymentIdByTx("tx2").empty());
+}
+
+TEST(PaymentStateStore, expiry)
+{
+    PaymentStateStore payments(std::chrono::seconds(1));
+    payments.bindTx("tx1", "pay1");
+    payments.bindTx("tx2", "pay2");
+    payments.setStatus("pay3", static_cast<int>(RTAStatus::InProgress));
+    EXPECT_EQ(0u, payments.cleanup());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    //a lookup by tx is an access to the payment, it prolongs the ttl
+    EXPECT_EQ("pay1", payments.paymentIdByTx("tx1"));
+    EXPECT_EQ(2u, payments.cleanup());
+    EXPECT_TRUE(payments.paymentIdByTx("tx2").empty());
+    EXPECT_EQ(static_cast<int>(RTAStatus::None), payments.status("pay3"));
+
+    //the binding expires together with the record
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_EQ(1u, payments.cleanup());
+    EXPECT_TRUE(payments.paymentIdByTx("tx1").empty());
+    EXPECT_FALSE(payments.read("pay1", [](const PaymentState&) { }));
+}
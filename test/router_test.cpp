@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "lib/graft/router.h"
+#include "lib/graft/requests.h"
+#include "lib/graft/sys_info_request.h"
+#include "supernode/requests.h"
+
+#include <chrono>
+#include <iostream>
+
+using graft::Router;
+using graft::Status;
+
+namespace
+{
+
+Router::Handler3 named(const std::string& name)
+{
+    auto action = [](const Router::vars_t&, const graft::Input&, graft::Context&, graft::Output&)->Status { return Status::Ok; };
+    return Router::Handler3(nullptr, action, nullptr, std::string(name));
+}
+
+} //namespace
+
+TEST(Router, staticAndPatternedRoutes)
+{
+    Router r("/dapi/v2.0");
+    r.addRoute("/sale_status", METHOD_POST, named("sale_status"));
+    r.addRoute("/sale", METHOD_POST, named("sale post"));
+    r.addRoute("/sale", METHOD_GET, named("sale get"));
+    r.addRoute("/callback/{id:[0-9a-f]+}", METHOD_POST, named("callback"));
+    r.addRoute("/a/{x}/b/{y}", METHOD_GET, named("ab"));
+
+    Router::Root root;
+    root.addRouter(r);
+    EXPECT_TRUE(root.arm());
+
+    Router::JobParams p;
+    EXPECT_TRUE(root.match("/dapi/v2.0/sale_status", METHOD_POST, p));
+    EXPECT_EQ("sale_status", p.h3->name);
+    EXPECT_TRUE(p.vars.empty());
+
+    EXPECT_TRUE(root.match("/dapi/v2.0/sale", METHOD_GET, p));
+    EXPECT_EQ("sale get", p.h3->name);
+    EXPECT_TRUE(root.match("/dapi/v2.0/sale", METHOD_POST, p));
+    EXPECT_EQ("sale post", p.h3->name);
+    EXPECT_FALSE(root.match("/dapi/v2.0/sale_status", METHOD_GET, p));
+    EXPECT_FALSE(root.match("/dapi/v2.0/sale_statu", METHOD_POST, p));
+
+    Router::JobParams p1;
+    EXPECT_TRUE(root.match("/dapi/v2.0/callback/12ab", METHOD_POST, p1));
+    EXPECT_EQ("callback", p1.h3->name);
+    ASSERT_EQ(1u, p1.vars.count("id"));
+    EXPECT_EQ("12ab", p1.vars.find("id")->second);
+
+    Router::JobParams p2;
+    EXPECT_TRUE(root.match("/dapi/v2.0/a/1/b/22", METHOD_GET, p2));
+    EXPECT_EQ("ab", p2.h3->name);
+    EXPECT_EQ(2u, p2.vars.size());
+    EXPECT_EQ("1", p2.vars.find("x")->second);
+    EXPECT_EQ("22", p2.vars.find("y")->second);
+    EXPECT_TRUE(p2.vars.find("z") == p2.vars.end());
+}
+
+TEST(Router, staticShadowedByPattern)
+{
+    //an endpoint without variables that a patterned route also matches is resolved by r3,
+    //the precedence of the routes does not depend on the static table
+    Router r;
+    r.addRoute("/item/{id}", METHOD_GET, named("item"));
+    r.addRoute("/item/all", METHOD_POST, named("all"));
+    r.addRoute("/items", METHOD_GET, named("items"));
+
+    Router::Root root;
+    root.addRouter(r);
+    EXPECT_TRUE(root.arm());
+
+    Router::JobParams p;
+    EXPECT_TRUE(root.match("/item/all", METHOD_GET, p));
+    EXPECT_EQ("item", p.h3->name);
+    ASSERT_EQ(1u, p.vars.count("id"));
+    EXPECT_EQ("all", p.vars.find("id")->second);
+
+    Router::JobParams p1;
+    EXPECT_TRUE(root.match("/items", METHOD_GET, p1));
+    EXPECT_EQ("items", p1.h3->name);
+    EXPECT_TRUE(p1.vars.empty());
+}
+
+TEST(Router, routeVars)
+{
+    Router::vars_t vars;
+    const char* keys[] = {"k3", "k1", "k2", "k1", "k5", "k0"};
+    for(int i = 0; i < 6; ++i)
+    {
+        vars.emplace(keys[i], std::string(20, 'a' + i));
+    }
+    EXPECT_EQ(6u, vars.size());
+
+    //ordered by keys, the equal keys in the order of insertion
+    std::vector<std::string> order;
+    for(auto& kv : vars) order.emplace_back(std::string(kv.first) + ":" + kv.second[0]);
+    std::vector<std::string> expected = {"k0:f", "k1:b", "k1:d", "k2:c", "k3:a", "k5:e"};
+    EXPECT_EQ(expected, order);
+
+    auto range = vars.equal_range("k1");
+    EXPECT_EQ(2u, vars.count("k1"));
+    EXPECT_EQ(std::string(20, 'b'), range.first->second);
+    EXPECT_TRUE(++range.first != range.second);
+    EXPECT_TRUE(++range.first == range.second);
+    range = vars.equal_range("k4");
+    EXPECT_TRUE(range.first == range.second);
+
+    //the views refer to the object they are taken from
+    Router::vars_t moved = std::move(vars);
+    Router::vars_t copied = moved;
+    moved.clear();
+    EXPECT_EQ(std::string(20, 'e'), copied.find("k5")->second);
+    EXPECT_TRUE(vars.empty());
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST(Router, DISABLED_matchBenchmark)
+{
+    //the route table of the supernode
+    using namespace graft::supernode::request;
+    Router dapi_router("/dapi/v2.0");
+    registerRTARequests(dapi_router);
+    Router walletapi_router("/walletapi");
+    registerWalletApiRequests(walletapi_router);
+    Router forward_router;
+    registerForwardRequests(forward_router);
+    Router health_router;
+    graft::request::registerHealthcheckRequests(health_router);
+    Router debug_router;
+    registerDebugRequests(debug_router);
+
+    Router::Root root;
+    root.addRouter(dapi_router);
+    root.addRouter(walletapi_router);
+    root.addRouter(forward_router);
+    root.addRouter(health_router);
+    root.addRouter(debug_router);
+    EXPECT_TRUE(root.arm());
+
+    std::pair<std::string, int> staticTargets[] = {
+        {"/dapi/v2.0/sale_status", METHOD_POST},
+        {"/dapi/v2.0/cryptonode/authorize_rta_tx_request", METHOD_POST},
+        {"/dapi/v2.0/cryptonode/authorize_rta_tx_response", METHOD_POST},
+        {"/dapi/v2.0/sale", METHOD_POST},
+        {"/dapi/v2.0/pay", METHOD_POST},
+        {"/dapi/v2.0/send_supernode_announce", METHOD_POST},
+        {"/health", METHOD_GET},
+    };
+    std::pair<std::string, int> patternedTargets[] = {
+        {"/dapi/v2.0/cryptonode/callback/sale_details/0123abcd-0000-1111-2222-333344445555", METHOD_POST},
+        {"/walletapi/wallet_balance", METHOD_POST},
+        {"/json_rpc", METHOD_POST},
+        {"/debug/supernode_list/1", METHOD_GET},
+    };
+
+    auto run = [&root](auto& targets, const char* name)
+    {
+        const int N = 200000;
+        size_t matched = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; ++i)
+        {
+            for(auto& t : targets)
+            {
+                Router::JobParams params;
+                matched += root.match(t.first, t.second, params);
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        size_t cnt = N * std::size(targets);
+        EXPECT_EQ(cnt, matched);
+        std::cout << name << " routes: " << std::chrono::duration<double, std::nano>(t1 - t0).count() / cnt
+                  << " ns per match" << std::endl;
+    };
+    run(staticTargets, "static");
+    run(patternedTargets, "patterned");
+}
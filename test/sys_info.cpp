@@ -46,6 +46,9 @@ TEST(SysInfo, counter_initial_state)
     EXPECT_EQ(sic.upstrm_http_req_bytes_raw_cnt(), 0);
     EXPECT_EQ(sic.upstrm_http_resp_bytes_raw_cnt(), 0);
 
+    EXPECT_EQ(sic.global_ctx_expired_cnt(), 0);
+    EXPECT_EQ(sic.global_ctx_expired_per_sec(), 0);
+
     EXPECT_EQ(sic.system_uptime_sec(), 0);
 }
 
@@ -141,6 +144,12 @@ TEST(SysInfo, counters_in_action)
     EXPECT_EQ(sic.upstrm_http_resp_bytes_raw_cnt(), 2);
     sic.count_upstrm_http_resp_bytes_raw(8);
     EXPECT_EQ(sic.upstrm_http_resp_bytes_raw_cnt(), 10);
+
+    sic.count_global_ctx_expired(3);
+    sic.count_global_ctx_expired(2);
+    EXPECT_EQ(sic.global_ctx_expired_cnt(), 5);
+    //the rate is known when the first window ends
+    EXPECT_EQ(sic.global_ctx_expired_per_sec(), 0);
 }
 
 namespace detail
@@ -150,6 +159,7 @@ class HandlerAPIImpl : public graft::HandlerAPI
 {
 public:
     virtual void sendUpstreamBlocking(Output& output, Input& input, std::string& err) override { }
+    virtual void sendUpstreamAsync(const Output& output, UpstreamCallback callback) override { }
     virtual bool addPeriodicTask(const Router::Handler& h_worker,
                                  std::chrono::milliseconds interval_ms,
                                  std::chrono::milliseconds initial_interval_ms = std::chrono::milliseconds::max(),
@@ -162,11 +172,16 @@ public:
     {
         return m_co;
     }
+    virtual graft::ServiceRegistry& services() override
+    {
+        return m_services;
+    }
 
     HandlerAPIImpl(SysInfoCounter& sic, ConfigOpts& co) : m_sic(sic), m_co(co) { }
 private:
     SysInfoCounter& m_sic;
     ConfigOpts& m_co;
+    graft::ServiceRegistry m_services;
 };
 
 } //namespace detail
@@ -199,8 +214,12 @@ TEST(SysInfo, response_content_initial_and_after_handler)
     Router::JobParams jp;
     const int meth_id = METHOD_GET;
     EXPECT_TRUE(router.match(req_path, meth_id, jp));
+    //the handlers of the route are shared, not copied
+    Router::JobParams jp1;
+    EXPECT_TRUE(router.match(req_path, meth_id, jp1));
+    EXPECT_EQ(jp.h3, jp1.h3);
 
-    jp.h3.worker_action(vars, inp, ctx, otp); // call the target handler
+    jp.h3->worker_action(vars, inp, ctx, otp); // call the target handler
     Response resp = Response::fromJson(otp.body);
 
     EXPECT_TRUE(resp.version.empty());
@@ -242,6 +261,9 @@ TEST(SysInfo, response_content_initial_and_after_handler)
     EXPECT_EQ(resp.running_info.upstrm_http_req_bytes_raw, 0);
     EXPECT_EQ(resp.running_info.upstrm_http_resp_bytes_raw, 0);
 
+    EXPECT_EQ(resp.running_info.global_ctx_expired, 0);
+    EXPECT_EQ(resp.running_info.global_ctx_expired_per_sec, 0);
+
     sic.count_http_request_total();
     sic.count_http_request_routed();
     sic.count_http_request_unrouted();
@@ -261,7 +283,7 @@ TEST(SysInfo, response_content_initial_and_after_handler)
     sic.count_upstrm_http_req_bytes_raw(1);
     sic.count_upstrm_http_resp_bytes_raw(1);
 
-    jp.h3.worker_action(vars, inp, ctx, otp); // call the target handler
+    jp.h3->worker_action(vars, inp, ctx, otp); // call the target handler
     resp = Response::fromJson(otp.body);
 
     EXPECT_EQ(resp.running_info.http_request_total, 1);
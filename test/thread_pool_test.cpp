@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include <functional>
-#include "lib/graft/thread_pool/thread_pool.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "lib/graft/thread_pool.h"
 
 namespace detail
 {
@@ -101,3 +104,417 @@ TEST(ThreadPool, expelling)
     }
     EXPECT_EQ(s, fast_per_slow * (slow_cnt+1) * slow_cnt /2 );
 }
+
+TEST(ThreadPool, parking)
+{
+    //all workers park between the jobs, no job should be lost
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(4);
+    th_op.setQueueSize(16);
+    th_op.setExpellingIntervalMs(1000);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 32>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    std::atomic<int> done = 0;
+    for(int i = 0; i < 1000; ++i)
+    {
+        thPool.post([&done]{ ++done; });
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while(done != i + 1 && std::chrono::steady_clock::now() < until)
+        {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(i + 1, done);
+        if(i % 100 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+TEST(ThreadPool, stealing)
+{
+    //three of four workers are blocked, the last one should run the jobs of all queues
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(4);
+    th_op.setQueueSize(64);
+    th_op.setExpellingIntervalMs(10000);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 32>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    std::atomic<int> blocked = 0;
+    std::atomic<bool> release = false;
+    for(int i = 0; i < 3; ++i)
+    {
+        thPool.post([&]
+        {
+            ++blocked;
+            while(!release) std::this_thread::yield();
+        });
+    }
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(blocked != 3 && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    ASSERT_EQ(3, blocked);
+
+    std::atomic<int> done = 0;
+    for(int i = 0; i < 100; ++i)
+    {
+        thPool.post([&done]{ ++done; });
+    }
+    until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(done != 100 && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    EXPECT_EQ(100, done);
+    release = true;
+}
+
+TEST(ThreadPool, taskDeque)
+{
+    using Task = tp::FixedFunction<void(), 32>;
+    tp::TaskDeque<Task> deque(4);
+    int sum = 0;
+    for(int i = 1; i <= 4; ++i)
+    {
+        EXPECT_TRUE(deque.push([&sum, i]{ sum += i; }));
+    }
+    EXPECT_FALSE(deque.canPush());
+    //the owner pops the newest, a stealer takes the oldest
+    Task task;
+    EXPECT_TRUE(deque.pop(task)); task();
+    EXPECT_EQ(4, sum);
+    EXPECT_TRUE(deque.steal(task)); task();
+    EXPECT_EQ(5, sum);
+    //the cells are reused
+    EXPECT_TRUE(deque.push([&sum]{ sum += 10; }));
+    EXPECT_TRUE(deque.push([&sum]{ sum += 20; }));
+    EXPECT_FALSE(deque.canPush());
+    while(deque.pop(task)) task();
+    EXPECT_EQ(40, sum);
+
+    //the owner pushes and pops while others steal, each task runs once
+    tp::TaskDeque<Task> shared(64);
+    const int count = 20000;
+    std::atomic<int> done = 0;
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> stealers;
+    for(int t = 0; t < 3; ++t)
+    {
+        stealers.emplace_back([&]
+        {
+            Task task;
+            while(!stop)
+            {
+                if(shared.steal(task)) task();
+                else std::this_thread::yield();
+            }
+        });
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        while(!shared.push([&done]{ ++done; })) std::this_thread::yield();
+        if(i % 3 == 0 && shared.pop(task)) task();
+        if(i % 64 == 0) std::this_thread::yield();
+    }
+    while(shared.pop(task)) task();
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(done != count && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    stop = true;
+    for(auto& th : stealers) th.join();
+    EXPECT_EQ(count, done);
+}
+
+TEST(ThreadPool, compensation)
+{
+    //all workers are blocked in marked regions, the compensation workers run the other jobs and retire after that
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(4);
+    th_op.setQueueSize(64);
+    th_op.setExpellingIntervalMs(50);
+    th_op.setMaxCompensationThreads(2);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 32>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    const uint64_t active0 = thPool.getActiveWorkersCount();
+    const uint64_t expelled0 = thPool.getExpelledWorkersCount();
+    const uint64_t compensated0 = thPool.getCompensatedCount();
+
+    std::atomic<int> blocked = 0;
+    std::atomic<bool> release = false;
+    for(int i = 0; i < 4; ++i)
+    {
+        thPool.post([&]
+        {
+            tp::BlockingRegion region;
+            tp::BlockingRegion nested;
+            ++blocked;
+            while(!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }, true);
+    }
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(blocked != 4 && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    ASSERT_EQ(4, blocked);
+    EXPECT_EQ(4, thPool.getBlockedWorkersCount());
+
+    //the compensation workers are started for the slots of the blocked workers that get tasks
+    std::atomic<int> done = 0;
+    for(int i = 0; i < 100; ++i)
+    {
+        thPool.post([&done]{ ++done; }, true);
+    }
+    until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(done != 100 && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    EXPECT_EQ(100, done);
+    EXPECT_EQ(2, thPool.getCompensatingWorkersCount());
+    EXPECT_EQ(compensated0 + 2, thPool.getCompensatedCount());
+    EXPECT_EQ(active0 + 2, thPool.getActiveWorkersCount());
+
+    //the workers in blocking regions are not expelled
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    thPool.expelWorkers();
+    EXPECT_EQ(expelled0, thPool.getExpelledWorkersCount());
+
+    release = true;
+    until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while((thPool.getBlockedWorkersCount() != 0 || thPool.getCompensatingWorkersCount() != 0
+           || thPool.getActiveWorkersCount() != active0)
+          && std::chrono::steady_clock::now() < until)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(0, thPool.getCompensatingWorkersCount());
+    EXPECT_EQ(0, thPool.getBlockedWorkersCount());
+    EXPECT_EQ(active0, thPool.getActiveWorkersCount());
+
+    //no compensation out of the workers
+    {
+        tp::BlockingRegion region;
+        EXPECT_EQ(0, thPool.getBlockedWorkersCount());
+    }
+}
+
+TEST(ThreadPool, compensationSpares)
+{
+    //the blocked workers are compensated only when their slots get tasks, the retired compensation worker is reused
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(2);
+    th_op.setQueueSize(64);
+    th_op.setMaxCompensationThreads(1);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 32>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    const uint64_t active0 = thPool.getActiveWorkersCount();
+    const uint64_t compensated0 = thPool.getCompensatedCount();
+
+    auto waitFor = [](auto pred)
+    {
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while(!pred() && std::chrono::steady_clock::now() < until) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return pred();
+    };
+
+    std::atomic<int> blocked = 0;
+    std::atomic<bool> release = false;
+    for(int round = 0; round < 3; ++round)
+    {
+        //the workers park, so each blocking job is taken by the worker of the slot it is posted to
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = false;
+        for(int i = 0; i < 2; ++i)
+        {
+            thPool.post([&]
+            {
+                {
+                    tp::BlockingRegion region;
+                    ++blocked;
+                    while(!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                --blocked;
+            });
+            ASSERT_TRUE(waitFor([&]{ return blocked == i + 1; }));
+        }
+        EXPECT_EQ(0, thPool.getCompensatingWorkersCount());
+
+        std::atomic<bool> done = false;
+        thPool.post([&done]{ done = true; });
+        EXPECT_TRUE(waitFor([&]{ return bool(done); }));
+        EXPECT_EQ(1, thPool.getCompensatingWorkersCount());
+        //the thread is started once, then the spare is woken
+        EXPECT_EQ(compensated0 + 1, thPool.getCompensatedCount());
+        EXPECT_EQ(0, thPool.getSpareWorkersCount());
+
+        release = true;
+        ASSERT_TRUE(waitFor([&]{ return blocked == 0; }));
+        EXPECT_TRUE(waitFor([&]{ return thPool.getCompensatingWorkersCount() == 0 && thPool.getActiveWorkersCount() == active0; }));
+        EXPECT_TRUE(waitFor([&]{ return thPool.getSpareWorkersCount() == 1; }));
+    }
+}
+
+TEST(ThreadPool, lanes)
+{
+    //the turns of a round are interleaved in the proportion of the weights, an empty lane gives its turn away
+    tp::LaneScheduler scheduler(tp::LaneWeights{{4, 2, 1}});
+    std::vector<int> turns(tp::LaneCount, 0);
+    for(int i = 0; i < 7; ++i) ++turns[scheduler.next()];
+    EXPECT_EQ(std::vector<int>({4, 2, 1}), turns);
+    size_t taken = tp::LaneCount;
+    EXPECT_TRUE(scheduler.pick([&taken](size_t lane){ taken = lane; return lane == tp::BulkLane; }));
+    EXPECT_EQ(tp::BulkLane, taken);
+
+    //the jobs of the high lane overtake the bulk jobs posted before them; one worker stays blocked,
+    //the other one runs the jobs of both queues
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(2);
+    th_op.setQueueSize(256);
+    th_op.setExpellingIntervalMs(10000);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 32>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    std::atomic<int> started = 0;
+    std::atomic<int> release = 0;
+    for(int i = 0; i < 2; ++i)
+    {
+        thPool.post([&, i]
+        {
+            ++started;
+            while(release <= i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(started != 2 && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    ASSERT_EQ(2, started);
+
+    const int bulk = 200, high = 20;
+    std::atomic<int> order = 0;
+    std::atomic<int> lastHigh = 0;
+    std::atomic<int> done = 0;
+    for(int i = 0; i < bulk; ++i)
+    {
+        thPool.post([&]{ ++order; ++done; }, true, tp::BulkLane);
+    }
+    for(int i = 0; i < high; ++i)
+    {
+        thPool.post([&]
+        {
+            int n = ++order;
+            int last = lastHigh;
+            while(last < n && !lastHigh.compare_exchange_weak(last, n));
+            ++done;
+        }, true, tp::HighLane);
+    }
+    release = 1;
+    until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(done != bulk + high && std::chrono::steady_clock::now() < until) std::this_thread::yield();
+    release = 2;
+    ASSERT_EQ(bulk + high, done);
+    //a worker takes a high job of another worker before it starts a bulk job
+    EXPECT_EQ(high, lastHigh);
+}
+
+TEST(ThreadPool, resultChannels)
+{
+    //the results of all workers come to the consumer, one notification per drained batch
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(4);
+    th_op.setQueueSize(256);
+    th_op.setExpellingIntervalMs(10000);
+    const int N = 1000;
+    //the channels should outlive the workers
+    graft::ResultChannels<int> results(th_op.threadCount(), 1024);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 32>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    std::atomic<int> notifications = 0;
+    for(int i = 0; i < N; ++i)
+    {
+        thPool.post([&results, &notifications, i]
+        {
+            if(results.push(int(i))) ++notifications;
+        }, true);
+    }
+
+    std::vector<int> got;
+    int drains = 0;
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(got.size() < size_t(N) && std::chrono::steady_clock::now() < until)
+    {
+        //the consumer drains only when notified
+        if(notifications <= drains)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ++drains;
+        results.drain([&got](int& v){ got.push_back(v); });
+    }
+    ASSERT_EQ(size_t(N), got.size());
+    EXPECT_LE(notifications, N);
+    std::sort(got.begin(), got.end());
+    for(int i = 0; i < N; ++i) EXPECT_EQ(i, got[i]);
+}
+
+namespace
+{
+
+//returns sorted latencies between posting of a job and its start in microseconds
+//every longEvery-th job of a producer takes longUs instead of jobUs
+template<typename ThPool>
+std::vector<double> dispatchLatencies(ThPool& thPool, int producers, int jobsPerProducer, int jobUs, int pauseUs,
+                                      int longEvery = 0, int longUs = 0)
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<double> res(producers * jobsPerProducer);
+    std::atomic<int> done = 0;
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]()
+        {
+            for(int i = 0; i < jobsPerProducer; ++i)
+            {
+                double* slot = &res[p * jobsPerProducer + i];
+                int us = (longEvery && i % longEvery == 0)? longUs : jobUs;
+                clock::time_point posted = clock::now();
+                for(;;)
+                {
+                    bool ok = thPool.tryPost([slot, posted, us, &done]
+                    {
+                        *slot = std::chrono::duration<double, std::micro>(clock::now() - posted).count();
+                        auto until = clock::now() + std::chrono::microseconds(us);
+                        while(clock::now() < until);
+                        ++done;
+                    });
+                    if(ok) break;
+                    std::this_thread::yield();
+                    posted = clock::now();
+                }
+                if(pauseUs) std::this_thread::sleep_for(std::chrono::microseconds(pauseUs));
+            }
+        });
+    }
+    for(auto& th : threads) th.join();
+    while(done != producers * jobsPerProducer) std::this_thread::yield();
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+} //namespace
+
+//run it using --gtest_also_run_disabled_tests
+TEST(ThreadPool, DISABLED_dispatchLatencyBenchmark)
+{
+    tp::ThreadPoolOptions th_op;
+    th_op.setThreadCount(detail::next_pow2(std::thread::hardware_concurrency()));
+    th_op.setQueueSize(1024);
+    th_op.setExpellingIntervalMs(1000);
+    using ThPool = tp::ThreadPoolImpl<tp::FixedFunction<void(), 64>, tp::MPMCBoundedQueue>;
+    ThPool thPool(th_op);
+
+    auto print = [](const char* name, const std::vector<double>& v)
+    {
+        std::cout << name << ": median " << v[v.size()/2] << " us, p99 " << v[v.size()*99/100]
+                  << " us, max " << v.back() << " us" << std::endl;
+    };
+    //the pool is idle when a job comes
+    print("idle", dispatchLatencies(thPool, 1, 1000, 10, 2000));
+    //all workers are busy
+    print("saturated", dispatchLatencies(thPool, 4, 20000, 50, 0));
+    //jobs are posted round-robin, so the long jobs pile up in the same queue
+    size_t n = th_op.threadCount();
+    print("skewed", dispatchLatencies(thPool, 1, 4000, 5, 20, n, 2000));
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "lib/graft/timer.h"
+
+#include <queue>
+#include <random>
+#include <iostream>
+
+namespace
+{
+
+using ms = std::chrono::milliseconds;
+using time_point = graft::TimingWheel::time_point;
+
+} //namespace
+
+TEST(TimingWheel, order)
+{
+    graft::TimingWheel tw;
+    time_point now = std::chrono::steady_clock::now();
+
+    std::vector<int> fired;
+    for(int t : {300, 5, 70000, 1, 256, 255, 17000000, 65536})
+    {
+        tw.add(ms(t), [&fired, t]{ fired.push_back(t); }, now);
+    }
+    EXPECT_EQ(8u, tw.size());
+
+    //go through time by 1 ms and check that each timer fires exactly at its time
+    std::vector<int> expected = {1, 5, 255, 256, 300, 65536, 70000, 17000000};
+    size_t next = 0;
+    for(int t = 0; t <= 17000000; ++t)
+    {
+        size_t cnt = tw.eval(now + ms(t));
+        if(next < expected.size() && t == expected[next])
+        {
+            EXPECT_EQ(1u, cnt);
+            ++next;
+        }
+        else
+        {
+            EXPECT_EQ(0u, cnt);
+        }
+        if(next == expected.size()) break;
+        if(cnt == 0)
+        {//jump to the next possible event
+            ms left = tw.nextTimeout(now + ms(t));
+            EXPECT_LT(ms(0), left);
+            EXPECT_LE(ms(t) + left, ms(expected[next]));
+            t += left.count() - 1;
+        }
+    }
+    EXPECT_EQ(expected, fired);
+    EXPECT_EQ(0u, tw.size());
+    EXPECT_EQ(ms::max(), tw.nextTimeout(now));
+}
+
+TEST(TimingWheel, cancel)
+{
+    graft::TimingWheel tw;
+    time_point now = std::chrono::steady_clock::now();
+
+    int cnt = 0;
+    graft::TimingWheel::Handle h1 = tw.add(ms(10), [&cnt]{ ++cnt; }, now);
+    graft::TimingWheel::Handle h2 = tw.add(ms(100000), [&cnt]{ ++cnt; }, now);
+    graft::TimingWheel::Handle h3 = tw.add(ms(20), [&cnt]{ ++cnt; }, now);
+    EXPECT_TRUE(tw.pending(h1));
+    tw.cancel(h1);
+    EXPECT_FALSE(tw.pending(h1));
+    tw.cancel(h2);
+    EXPECT_EQ(1u, tw.size());
+    EXPECT_EQ(ms(20), tw.nextTimeout(now));
+
+    //the node of h1 is reused, the old handle should not affect the new timer
+    graft::TimingWheel::Handle old = h3;
+    EXPECT_EQ(1u, tw.eval(now + ms(20)));
+    EXPECT_FALSE(tw.pending(old));
+    graft::TimingWheel::Handle h4 = tw.add(ms(10), [&cnt]{ ++cnt; }, now + ms(20));
+    tw.cancel(old);
+    EXPECT_TRUE(tw.pending(h4));
+    EXPECT_EQ(1u, tw.eval(now + ms(100000)));
+    EXPECT_EQ(2, cnt);
+}
+
+TEST(TimingWheel, rearmFromCallback)
+{
+    graft::TimingWheel tw;
+    time_point now = std::chrono::steady_clock::now();
+
+    int cnt = 0;
+    std::function<void()> periodic = [&]
+    {
+        ++cnt;
+        tw.add(ms(7), periodic, now + ms(7*cnt));
+    };
+    tw.add(ms(7), periodic, now);
+    for(int t = 0; t <= 7000; ++t) tw.eval(now + ms(t));
+    EXPECT_EQ(1000, cnt);
+    EXPECT_EQ(1u, tw.size());
+}
+
+//run it using --gtest_also_run_disabled_tests
+TEST(TimingWheel, DISABLED_benchmark)
+{
+    const int N = 100000;
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> dist(1, 600000);
+    std::vector<int> timeouts(N);
+    for(int& t : timeouts) t = dist(gen);
+
+    time_point now = std::chrono::steady_clock::now();
+    auto us = [](auto d){ return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(d).count(); };
+
+    {
+        graft::TimingWheel tw;
+        std::vector<graft::TimingWheel::Handle> handles(N);
+        int fired = 0;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; ++i) handles[i] = tw.add(ms(timeouts[i]), [&fired]{ ++fired; }, now);
+        auto t1 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; i += 2) tw.cancel(handles[i]);
+        auto t2 = std::chrono::steady_clock::now();
+        for(int t = 0; t <= 600000; t += 10) tw.eval(now + ms(t));
+        auto t3 = std::chrono::steady_clock::now();
+        EXPECT_EQ(N/2, fired);
+
+        std::cout << "timing wheel, " << N << " timers: add " << us(t1 - t0)/N << " us, cancel "
+                  << us(t2 - t1)/(N/2) << " us, expire " << us(t3 - t2)/(N/2) << " us per timer" << std::endl;
+    }
+    {//the way timers were kept before, it cannot cancel, cancelled entries linger until expiration
+        using item = std::pair<std::chrono::steady_clock::time_point, std::function<void()>>;
+        auto cmp = [](const item& a, const item& b){ return a.first > b.first; };
+        std::priority_queue<item, std::vector<item>, decltype(cmp)> pq(cmp);
+        int fired = 0;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < N; ++i) pq.emplace(now + ms(timeouts[i]), [&fired]{ ++fired; });
+        auto t1 = std::chrono::steady_clock::now();
+        for(int t = 0; t <= 600000; t += 10)
+        {
+            while(!pq.empty() && pq.top().first <= now + ms(t))
+            {
+                pq.top().second();
+                pq.pop();
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        EXPECT_EQ(N, fired);
+
+        std::cout << "priority queue, " << N << " timers: add " << us(t1 - t0)/N << " us, expire "
+                  << us(t2 - t1)/N << " us per timer" << std::endl;
+    }
+}